@@ -13,9 +13,10 @@ if not exist "%vswhere%" (
 echo.
 echo Cleaning old build files...
 if exist resource.res del resource.res
-if exist media_sorter.obj del media_sorter.obj
-if exist sorter.obj del sorter.obj
+if exist *.obj del *.obj
 if exist "Media Sorter XXL.exe" del "Media Sorter XXL.exe"
+if exist media_sorter_bench.exe del media_sorter_bench.exe
+if exist media-sorter-cli.exe del media-sorter-cli.exe
 
 for /f "usebackq tokens=*" %%i in (`"%vswhere%" -latest -products * -requires Microsoft.VisualStudio.Component.VC.Tools.x86.x64 -property installationPath`) do (
     set "VSInstallDir=%%i"
@@ -46,7 +47,7 @@ rc.exe /nologo resource.rc
 
 echo.
 echo Compiling Sorter...
-cl.exe /nologo /O2 /EHsc /std:c++17 /DUNICODE /D_UNICODE /utf-8 media_sorter.cpp resource.res /link /SUBSYSTEM:WINDOWS /OUT:"Media Sorter XXL.exe"
+cl.exe /nologo /O2 /EHsc /std:c++17 /DUNICODE /D_UNICODE /utf-8 media_sorter.cpp engine\*.cpp resource.res /link /SUBSYSTEM:WINDOWS /OUT:"Media Sorter XXL.exe"
 
 if %errorlevel% neq 0 (
     echo Compilation Failed!
@@ -54,6 +55,24 @@ if %errorlevel% neq 0 (
     exit /b %errorlevel%
 )
 
+echo.
+echo Compiling Command Line Tools...
+cl.exe /nologo /O2 /EHsc /std:c++17 /DUNICODE /D_UNICODE /utf-8 media_sorter_cli.cpp engine\*.cpp /link /SUBSYSTEM:CONSOLE /OUT:"media-sorter-cli.exe"
+
+if %errorlevel% neq 0 (
+    echo CLI Compilation Failed!
+    pause
+    exit /b %errorlevel%
+)
+
+cl.exe /nologo /O2 /EHsc /std:c++17 /DUNICODE /D_UNICODE /utf-8 media_sorter_bench.cpp engine\*.cpp /link /SUBSYSTEM:CONSOLE /OUT:"media_sorter_bench.exe"
+
+if %errorlevel% neq 0 (
+    echo Benchmark Compilation Failed!
+    pause
+    exit /b %errorlevel%
+)
+
 echo.
 echo Compilation Success! "Media Sorter XXL.exe" created.
 echo.
@@ -0,0 +1,497 @@
+// bmff_reader.cpp
+#include "bmff_reader.h"
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+namespace bmff {
+
+static constexpr uint32_t FourCC(const char (&s)[5]) {
+    return ((uint32_t)(uint8_t)s[0] << 24) | ((uint32_t)(uint8_t)s[1] << 16) | ((uint32_t)(uint8_t)s[2] << 8) | (uint8_t)s[3];
+}
+
+static const uint32_t BOX_FTYP = FourCC("ftyp");
+static const uint32_t BOX_MOOV = FourCC("moov");
+static const uint32_t BOX_MVHD = FourCC("mvhd");
+static const uint32_t BOX_UDTA = FourCC("udta");
+static const uint32_t BOX_META = FourCC("meta");
+static const uint32_t BOX_HDLR = FourCC("hdlr");
+static const uint32_t BOX_KEYS = FourCC("keys");
+static const uint32_t BOX_ILST = FourCC("ilst");
+static const uint32_t BOX_DATA = FourCC("data");
+static const uint32_t BOX_XYZ = FourCC("\xA9xyz");
+static const uint32_t BOX_IINF = FourCC("iinf");
+static const uint32_t BOX_INFE = FourCC("infe");
+static const uint32_t BOX_ILOC = FourCC("iloc");
+static const uint32_t BOX_IDAT = FourCC("idat");
+static const uint32_t BOX_UUID = FourCC("uuid");
+static const uint32_t BOX_CMT2 = FourCC("CMT2");
+static const uint32_t BOX_CMT4 = FourCC("CMT4");
+static const uint32_t ITEM_EXIF = FourCC("Exif");
+
+// Usertype of the uuid box in which Canon CR3 keeps its metadata
+static const uint8_t CANON_UUID[16] = {
+    0x85, 0xC0, 0xB6, 0x87, 0x82, 0x0F, 0x11, 0xE0, 0x81, 0x11, 0xF4, 0xCE, 0x46, 0x2B, 0x6A, 0x48
+};
+
+// Seconds from 1904-01-01 (the MP4 epoch) to 1970-01-01
+static const uint64_t UNIX_EPOCH = 2082844800ULL;
+// Sanity limits for hostile files
+static const int MAX_BOXES = 100000;
+static const size_t MAX_PAYLOAD = 1024 * 1024;
+static const size_t MAX_EXIF = 256 * 1024;
+
+static uint32_t BE32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t BE64(const uint8_t* p) {
+    return ((uint64_t)BE32(p) << 32) | BE32(p + 4);
+}
+
+namespace {
+
+// The file as the head already read plus, beyond it, the stream.
+class Reader {
+public:
+    Reader(const uint8_t* head, size_t headSize, std::istream* stream, uint64_t size)
+        : m_head(head), m_headSize(headSize), m_stream(stream), m_size(size) {}
+
+    uint64_t Size() const { return m_size; }
+    uint64_t BytesRead() const { return m_bytesRead; }
+
+    bool Read(uint64_t offset, void* out, size_t size) {
+        if (offset > m_size || size > m_size - offset) return false;
+        if (offset + size <= m_headSize) {
+            memcpy(out, m_head + offset, size);
+            return true;
+        }
+        if (!m_stream) return false;
+        m_stream->clear();
+        m_stream->seekg((std::streamoff)offset);
+        m_stream->read((char*)out, (std::streamsize)size);
+        m_bytesRead += (uint64_t)m_stream->gcount();
+        return (size_t)m_stream->gcount() == size;
+    }
+
+private:
+    const uint8_t* m_head;
+    size_t m_headSize;
+    std::istream* m_stream;
+    uint64_t m_size;
+    uint64_t m_bytesRead = 0;
+};
+
+struct Box {
+    uint32_t type = 0;
+    uint64_t payload = 0;       // Offset of the contents
+    uint64_t end = 0;
+};
+
+struct Found {
+    bool haveMvhd = false;
+    uint64_t created = 0;       // mvhd, seconds since 1904 (UTC)
+    std::string xyz;            // udta/(c)xyz
+    std::vector<std::string> keys;      // Apple metadata keys, 1-based in ilst
+    std::vector<std::pair<uint32_t, std::string>> items;   // Key index, UTF-8 value
+    ExifInfo exif;              // HEIF Exif item or CR3 CMT boxes
+    int boxes = 0;
+};
+
+// Where a HEIF item's data is: extents in the file (construction method 0)
+// or in the meta box's idat (method 1)
+struct ItemLocation {
+    bool found = false;
+    int construction = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> extents;     // Offset, length
+};
+
+// Bounds-checked big-endian reads from a box payload
+class Cursor {
+public:
+    explicit Cursor(const std::vector<uint8_t>& data) : m_data(data) {}
+
+    bool Ok() const { return m_ok; }
+
+    uint64_t Next(size_t bytes) {
+        if (bytes > m_data.size() - m_pos) { m_ok = false; m_pos = m_data.size(); return 0; }
+        uint64_t v = 0;
+        for (size_t i = 0; i < bytes; ++i) v = (v << 8) | m_data[m_pos++];
+        return v;
+    }
+
+    void Skip(size_t bytes) {
+        if (bytes > m_data.size() - m_pos) { m_ok = false; m_pos = m_data.size(); }
+        else m_pos += bytes;
+    }
+
+private:
+    const std::vector<uint8_t>& m_data;
+    size_t m_pos = 0;
+    bool m_ok = true;
+};
+
+} // namespace
+
+static bool ReadBox(Reader& reader, uint64_t offset, uint64_t end, Box& box) {
+    uint8_t header[16];
+    if (offset >= end || end - offset < 8 || !reader.Read(offset, header, 8)) return false;
+    uint64_t size = BE32(header);
+    uint64_t headerSize = 8;
+    if (size == 1) {
+        if (end - offset < 16 || !reader.Read(offset + 8, header + 8, 8)) return false;
+        size = BE64(header + 8);
+        headerSize = 16;
+    } else if (size == 0) {
+        size = end - offset;    // Up to the end of the file
+    }
+    if (size < headerSize || size > end - offset) return false;
+    box.type = BE32(header + 4);
+    box.payload = offset + headerSize;
+    box.end = offset + size;
+    return true;
+}
+
+static bool ReadPayload(Reader& reader, const Box& box, size_t maxSize, std::vector<uint8_t>& data) {
+    uint64_t size = box.end - box.payload;
+    if (size > maxSize) return false;
+    data.resize((size_t)size);
+    return reader.Read(box.payload, data.data(), data.size());
+}
+
+// keys: version/flags, count, then (size, namespace, name) per key
+static void ParseKeys(const std::vector<uint8_t>& data, Found& found) {
+    found.keys.clear();
+    if (data.size() < 8) return;
+    uint32_t count = BE32(data.data() + 4);
+    size_t pos = 8;
+    for (uint32_t i = 0; i < count && pos + 8 <= data.size(); ++i) {
+        uint32_t size = BE32(data.data() + pos);
+        if (size < 8 || size > data.size() - pos) break;
+        found.keys.emplace_back((const char*)data.data() + pos + 8, size - 8);
+        pos += size;
+    }
+}
+
+// ilst: one box per value, typed by its 1-based key index, holding a data
+// box (type indicator, locale, value). Only UTF-8 values are kept.
+static void ParseItems(Reader& reader, const Box& ilst, Found& found) {
+    Box item;
+    for (uint64_t pos = ilst.payload; ReadBox(reader, pos, ilst.end, item) && ++found.boxes < MAX_BOXES; pos = item.end) {
+        Box data;
+        std::vector<uint8_t> value;
+        for (uint64_t inner = item.payload; ReadBox(reader, inner, item.end, data); inner = data.end) {
+            if (data.type != BOX_DATA) continue;
+            if (ReadPayload(reader, data, 4096, value) && value.size() >= 8 && BE32(value.data()) == 1) {
+                found.items.emplace_back(item.type, std::string((const char*)value.data() + 8, value.size() - 8));
+            }
+            break;
+        }
+    }
+}
+
+// --- HEIF / CR3 ---
+
+// iinf: version/flags, entry count, then infe boxes. Item types only exist
+// from infe version 2 on, which is all HEIF allows.
+static bool FindExifItem(Reader& reader, const Box& iinf, Found& found, uint32_t& itemId) {
+    uint8_t header[4];
+    if (iinf.end - iinf.payload < 4 || !reader.Read(iinf.payload, header, 4)) return false;
+    Box infe;
+    std::vector<uint8_t> data;
+    uint64_t pos = iinf.payload + 4 + (header[0] == 0 ? 2 : 4);
+    for (; ReadBox(reader, pos, iinf.end, infe) && ++found.boxes < MAX_BOXES; pos = infe.end) {
+        if (infe.type != BOX_INFE || !ReadPayload(reader, infe, 4096, data)) continue;
+        Cursor c(data);
+        int version = (int)c.Next(1);
+        c.Skip(3);
+        if (version < 2) continue;
+        uint32_t id = (uint32_t)c.Next(version == 2 ? 2 : 4);
+        c.Skip(2);                              // Protection index
+        uint32_t type = (uint32_t)c.Next(4);
+        if (c.Ok() && type == ITEM_EXIF) {
+            itemId = id;
+            return true;
+        }
+    }
+    return false;
+}
+
+// iloc versions 0-2: field sizes up front, then per item its construction
+// method (1 and 2 only), base offset and extents
+static ItemLocation LocateItem(const std::vector<uint8_t>& data, uint32_t itemId) {
+    ItemLocation location;
+    Cursor c(data);
+    int version = (int)c.Next(1);
+    c.Skip(3);
+    uint8_t sizes = (uint8_t)c.Next(1);
+    uint8_t moreSizes = (uint8_t)c.Next(1);
+    size_t offsetSize = sizes >> 4, lengthSize = sizes & 15;
+    size_t baseOffsetSize = moreSizes >> 4, indexSize = version >= 1 ? moreSizes & 15 : 0;
+    if (version > 2) return location;
+    uint32_t count = (uint32_t)c.Next(version < 2 ? 2 : 4);
+    for (uint32_t i = 0; i < count && c.Ok(); ++i) {
+        uint32_t id = (uint32_t)c.Next(version < 2 ? 2 : 4);
+        int construction = version >= 1 ? (int)(c.Next(2) & 15) : 0;
+        c.Skip(2);                              // Data reference index
+        uint64_t base = c.Next(baseOffsetSize);
+        uint32_t extents = (uint32_t)c.Next(2);
+        ItemLocation item;
+        item.construction = construction;
+        for (uint32_t e = 0; e < extents && c.Ok(); ++e) {
+            c.Skip(indexSize);
+            uint64_t offset = c.Next(offsetSize);
+            uint64_t length = c.Next(lengthSize);
+            item.extents.emplace_back(base + offset, length);
+        }
+        if (c.Ok() && id == itemId) {
+            item.found = true;
+            return item;
+        }
+    }
+    return location;
+}
+
+// The Exif item: a 4-byte offset to the TIFF header, then the block
+static void ReadExifItem(Reader& reader, const ItemLocation& location, uint64_t idatStart, uint64_t idatEnd, Found& found) {
+    if (location.construction > 1) return;
+    std::vector<uint8_t> data;
+    for (const auto& extent : location.extents) {
+        uint64_t offset = extent.first, length = extent.second;
+        if (location.construction == 1) {
+            uint64_t idatSize = idatEnd - idatStart;
+            if (offset > idatSize) return;
+            if (length == 0) length = idatSize - offset;
+            if (length > idatSize - offset) return;
+            offset += idatStart;
+        } else if (length == 0) {
+            if (offset > reader.Size()) return;
+            length = reader.Size() - offset;
+        }
+        if (length > MAX_EXIF - data.size()) return;
+        size_t have = data.size();
+        data.resize(have + (size_t)length);
+        if (!reader.Read(offset, data.data() + have, (size_t)length)) return;
+    }
+    if (data.size() < 4) return;
+    uint64_t start = 4 + (uint64_t)BE32(data.data());
+    if (start > data.size()) return;
+    // Some writers point at the "Exif\0\0" prefix rather than past it
+    if (data.size() - start >= 6 && memcmp(data.data() + start, "Exif\0\0", 6) == 0) start += 6;
+    exif::ParseTiff(data.data() + start, data.size() - (size_t)start, found.exif);
+}
+
+// Top-level meta of a HEIF image (full box): finds the Exif item in iinf
+// and where iloc says it is. The image items themselves are never read.
+static void ParseHeifMeta(Reader& reader, const Box& meta, Found& found) {
+    Box box;
+    bool haveExif = false;
+    uint32_t exifId = 0;
+    std::vector<uint8_t> iloc;
+    uint64_t idatStart = 0, idatEnd = 0;
+    for (uint64_t pos = meta.payload + 4; ReadBox(reader, pos, meta.end, box) && ++found.boxes < MAX_BOXES; pos = box.end) {
+        if (box.type == BOX_IINF) haveExif = FindExifItem(reader, box, found, exifId);
+        else if (box.type == BOX_ILOC) ReadPayload(reader, box, MAX_PAYLOAD, iloc);
+        else if (box.type == BOX_IDAT) { idatStart = box.payload; idatEnd = box.end; }
+    }
+    if (!haveExif || iloc.empty()) return;
+    ItemLocation location = LocateItem(iloc, exifId);
+    if (location.found) ReadExifItem(reader, location, idatStart, idatEnd, found);
+}
+
+// Canon's uuid box in a CR3 moov: CMT1-CMT4 are each a TIFF block, CMT2
+// holding the EXIF IFD and CMT4 the GPS IFD
+static void ParseCanonBox(Reader& reader, const Box& uuid, Found& found) {
+    uint8_t usertype[16];
+    if (uuid.end - uuid.payload < 16 || !reader.Read(uuid.payload, usertype, 16)) return;
+    if (memcmp(usertype, CANON_UUID, 16) != 0) return;
+    Box box;
+    std::vector<uint8_t> data;
+    for (uint64_t pos = uuid.payload + 16; ReadBox(reader, pos, uuid.end, box) && ++found.boxes < MAX_BOXES; pos = box.end) {
+        if (box.type != BOX_CMT2 && box.type != BOX_CMT4) continue;
+        if (ReadPayload(reader, box, MAX_EXIF, data)) {
+            exif::ParseTiff(data.data(), data.size(), found.exif, box.type == BOX_CMT2 ? exif::TiffRoot::Exif : exif::TiffRoot::Gps);
+        }
+    }
+}
+
+static void WalkContainer(Reader& reader, uint64_t start, uint64_t end, int depth, Found& found) {
+    Box box;
+    std::vector<uint8_t> data;
+    for (uint64_t pos = start; ReadBox(reader, pos, end, box) && ++found.boxes < MAX_BOXES; pos = box.end) {
+        if (box.type == BOX_MVHD) {
+            uint8_t mvhd[12];
+            if (box.end - box.payload >= sizeof(mvhd) && reader.Read(box.payload, mvhd, sizeof(mvhd))) {
+                found.created = mvhd[0] == 1 ? BE64(mvhd + 4) : BE32(mvhd + 4);
+                found.haveMvhd = true;
+            }
+        } else if (box.type == BOX_XYZ) {
+            // Pascal-style string: length, language, text
+            if (ReadPayload(reader, box, 1024, data) && data.size() >= 4) {
+                size_t length = ((size_t)data[0] << 8) | data[1];
+                if (length <= data.size() - 4) found.xyz.assign((const char*)data.data() + 4, length);
+            }
+        } else if (box.type == BOX_KEYS) {
+            if (ReadPayload(reader, box, MAX_PAYLOAD, data)) ParseKeys(data, found);
+        } else if (box.type == BOX_ILST) {
+            ParseItems(reader, box, found);
+        } else if (box.type == BOX_UUID && depth == 0) {
+            ParseCanonBox(reader, box, found);
+        } else if ((box.type == BOX_UDTA || box.type == BOX_META) && depth < 4) {
+            uint64_t inner = box.payload;
+            if (box.type == BOX_META) {
+                // ISO meta is a full box (version/flags first), QuickTime's isn't
+                uint8_t peek[8];
+                if (box.end - box.payload >= 8 && reader.Read(box.payload, peek, 8) && BE32(peek + 4) != BOX_HDLR) inner += 4;
+            }
+            WalkContainer(reader, inner, box.end, depth + 1, found);
+        }
+    }
+}
+
+// ISO 6709 "+DD.DDDD+DDD.DDDD[+AAA.AAA]/", degrees optionally written as
+// DDMM.MM or DDMMSS.SS (told apart by the digits before the point).
+static bool ParseIso6709(const std::string& text, double& lat, double& lon) {
+    const char* p = text.c_str();
+    double values[2];
+    for (int i = 0; i < 2; ++i) {
+        if (*p != '+' && *p != '-') return false;
+        const char* start = p;
+        int digits = 0;
+        for (++p; *p >= '0' && *p <= '9'; ++p) digits++;
+        if (*p == '.') {
+            for (++p; *p >= '0' && *p <= '9'; ++p) {}
+        }
+        double v = std::strtod(std::string(start, p).c_str(), nullptr);
+        double a = v < 0 ? -v : v;
+        int degreeDigits = i == 0 ? 2 : 3;
+        if (digits == degreeDigits + 2) {
+            int d = (int)(a / 100);
+            a = d + (a - d * 100) / 60.0;
+        } else if (digits == degreeDigits + 4) {
+            int d = (int)(a / 10000);
+            int m = (int)((a - d * 10000) / 100);
+            a = d + m / 60.0 + (a - d * 10000 - m * 100) / 3600.0;
+        } else if (digits != degreeDigits && digits != degreeDigits - 1) {
+            return false;
+        }
+        values[i] = v < 0 ? -a : a;
+    }
+    lat = values[0];
+    lon = values[1];
+    // Some phones write zeros when they had no fix
+    if (lat == 0.0 && lon == 0.0) return false;
+    return lat >= -90.0 && lat <= 90.0 && lon >= -180.0 && lon <= 180.0;
+}
+
+// "YYYY-MM-DDTHH:MM:SS[+hhmm]", local time
+static bool ParseIsoDate(const std::string& text, ExifInfo& out) {
+    if (text.size() < 19) return false;
+    std::string exifStyle = text.substr(0, 19);
+    exifStyle[4] = exifStyle[7] = ':';
+    exifStyle[10] = ' ';
+    return exif::ParseExifDate(exifStyle.c_str(), exifStyle.size(), out);
+}
+
+static bool SetFromMp4Time(uint64_t created, ExifInfo& out) {
+    // Zero (not set) and values from before 1970 are not real dates
+    if (created <= UNIX_EPOCH) return false;
+    int64_t seconds = (int64_t)(created - UNIX_EPOCH);
+    int64_t days = seconds / 86400;
+    int64_t rest = seconds % 86400;
+
+    // Civil date from days since 1970-01-01 (proleptic Gregorian)
+    days += 719468;
+    int64_t era = days / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    int day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    int month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    out.year = (int)(yoe + era * 400 + (month <= 2 ? 1 : 0));
+    out.month = month;
+    out.day = day;
+    out.hour = (int)(rest / 3600);
+    out.minute = (int)(rest / 60 % 60);
+    out.second = (int)(rest % 60);
+    out.hasDate = true;
+    return true;
+}
+
+static bool Parse(Reader& reader, ExifInfo& out) {
+    Found found;
+    Box box;
+    bool haveMoov = false, haveMeta = false;
+    for (uint64_t pos = 0; ReadBox(reader, pos, reader.Size(), box) && ++found.boxes < MAX_BOXES; pos = box.end) {
+        if (box.type == BOX_META) {
+            // HEIF: image metadata ahead of mdat
+            ParseHeifMeta(reader, box, found);
+            haveMeta = true;
+            if (found.exif.hasDate) break;
+        } else if (box.type == BOX_MOOV) {
+            WalkContainer(reader, box.payload, box.end, 0, found);
+            haveMoov = true;
+            break;
+        }
+    }
+    if (!haveMoov && !haveMeta) return false;
+
+    std::string appleDate, appleLocation;
+    for (const auto& item : found.items) {
+        if (item.first == 0 || item.first > found.keys.size()) continue;
+        const std::string& key = found.keys[item.first - 1];
+        if (key == "com.apple.quicktime.creationdate") appleDate = item.second;
+        else if (key == "com.apple.quicktime.location.ISO6709") appleLocation = item.second;
+    }
+
+    // EXIF first (HEIF, CR3): it has the camera's local time and the same
+    // GPS fix as a JPEG from the same camera would
+    if (found.exif.hasDate) {
+        out.year = found.exif.year; out.month = found.exif.month; out.day = found.exif.day;
+        out.hour = found.exif.hour; out.minute = found.exif.minute; out.second = found.exif.second;
+        out.hasDate = true;
+    } else if (!ParseIsoDate(appleDate, out) && found.haveMvhd) {
+        SetFromMp4Time(found.created, out);
+    }
+    double lat, lon;
+    if (found.exif.hasGps) {
+        out.latitude = found.exif.latitude;
+        out.longitude = found.exif.longitude;
+        out.hasGps = true;
+    } else if (ParseIso6709(appleLocation, lat, lon) || ParseIso6709(found.xyz, lat, lon)) {
+        out.latitude = lat;
+        out.longitude = lon;
+        out.hasGps = true;
+    }
+    return true;
+}
+
+bool LooksLikeBmff(const uint8_t* data, size_t size) {
+    if (size < 8) return false;
+    uint32_t boxSize = BE32(data);
+    if (boxSize != 0 && boxSize != 1 && boxSize < 8) return false;
+    // Old QuickTime files start with moov/mdat/wide/free instead of ftyp
+    switch (BE32(data + 4)) {
+    case BOX_FTYP: case BOX_MOOV:
+    case FourCC("mdat"): case FourCC("wide"): case FourCC("free"): case FourCC("skip"): case FourCC("pnot"):
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool ParseStream(const uint8_t* head, size_t headSize, std::istream& stream, uint64_t fileSize,
+                 ExifInfo& out, uint64_t* bytesRead) {
+    Reader reader(head, headSize, &stream, fileSize);
+    bool ok = Parse(reader, out);
+    if (bytesRead) *bytesRead = reader.BytesRead();
+    return ok;
+}
+
+bool ParseBuffer(const uint8_t* data, size_t size, ExifInfo& out) {
+    Reader reader(data, size, nullptr, size);
+    return Parse(reader, out);
+}
+
+} // namespace bmff
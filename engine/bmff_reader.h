@@ -0,0 +1,35 @@
+// bmff_reader.h
+// Creation time and location of MP4, MOV and 3GP videos (ISO base media
+// file format / QuickTime). Walks the box headers, seeking past everything
+// but moov, and inside moov only reads mvhd and the user data: udta/(c)xyz
+// (Android and most cameras) and the Apple metadata keys
+// com.apple.quicktime.creationdate and com.apple.quicktime.location.ISO6709.
+// Sample data (mdat) and the track tables are never read, so the cost is a
+// few small reads whatever the size of the clip, and wherever moov sits.
+//
+// The same walk covers the still formats built on ISO-BMFF: HEIC/HEIF,
+// whose top-level meta box locates the Exif item (iinf, iloc), and Canon
+// CR3, which keeps TIFF-structured EXIF and GPS blocks in a uuid box in moov.
+#pragma once
+
+#include "exif_reader.h"
+#include <istream>
+#include <cstdint>
+
+namespace bmff {
+
+// True if data (the start of a file) looks like ISO-BMFF or QuickTime.
+bool LooksLikeBmff(const uint8_t* data, size_t size);
+
+// Parses a file whose first headSize bytes are in head; the rest is read
+// from stream (positioned anywhere) as needed. Dates come from EXIF, the
+// Apple creation date (both local time) or else mvhd (UTC). False if there
+// is no readable moov or meta. bytesRead, if given, receives what was read beyond head.
+bool ParseStream(const uint8_t* head, size_t headSize, std::istream& stream, uint64_t fileSize,
+                 ExifInfo& out, uint64_t* bytesRead = nullptr);
+
+// Same when only the head is available (an archive member): works if moov
+// is inside it, i.e. for files written with moov up front.
+bool ParseBuffer(const uint8_t* data, size_t size, ExifInfo& out);
+
+} // namespace bmff
@@ -0,0 +1,194 @@
+// concurrency_controller.cpp
+#include "concurrency_controller.h"
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Throughput is compared over windows of at least this long
+static const double WINDOW_SECONDS = 0.25;
+// Changes smaller than this count as no change
+static const double RATE_TOLERANCE = 0.05;
+
+static const char* const STAGE_NAMES[WORK_STAGE_COUNT] = { "metadata", "copy" };
+
+const char* WorkStageName(WorkStage stage) {
+    return STAGE_NAMES[(int)stage];
+}
+
+// --- PERMIT ---
+
+AdaptiveLimit::Permit::Permit(AdaptiveLimit* limit) : m_limit(limit) {
+    if (limit) limit->Acquire();
+    m_start = std::chrono::steady_clock::now();
+}
+
+AdaptiveLimit::Permit::~Permit() {
+    Done(0);
+}
+
+void AdaptiveLimit::Permit::Done(uint64_t units) {
+    if (m_done || !m_limit) return;
+    m_done = true;
+    m_limit->Release(units, std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count());
+}
+
+// --- LIMIT ---
+
+AdaptiveLimit::AdaptiveLimit(int initial, int maximum, bool adaptive)
+    : m_max(std::max(1, maximum)), m_adaptive(adaptive) {
+    m_limit = adaptive ? std::min(std::max(1, initial), m_max) : m_max;
+    m_stats.low = m_stats.high = m_limit;
+    m_windowStart = std::chrono::steady_clock::now();
+}
+
+void AdaptiveLimit::Acquire() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_inUse >= m_limit) m_saturated = true;
+    m_cond.wait(lock, [this]() { return m_inUse < m_limit; });
+    m_inUse++;
+    if (m_inUse == m_limit) m_saturated = true;
+}
+
+void AdaptiveLimit::Release(uint64_t units, double seconds) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inUse--;
+        m_stats.operations++;
+        m_stats.units += units;
+        m_stats.busySeconds += seconds;
+        m_windowOps++;
+        m_windowUnits += units;
+        if (m_adaptive) Adjust(std::chrono::steady_clock::now());
+    }
+    m_cond.notify_all();
+}
+
+// Hill climbing on throughput: keep going while it improves, turn around
+// when it drops, and shed a worker when it stays flat (the extra ones only
+// queue up at the device). Growing only happens while the limit binds.
+void AdaptiveLimit::Adjust(std::chrono::steady_clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - m_windowStart).count();
+    if (elapsed < WINDOW_SECONDS || m_windowOps <= (uint64_t)m_limit) return;
+
+    double rate = m_windowUnits / elapsed;
+    int next = m_limit;
+    if (m_lastRate <= 0.0) {
+        m_direction = 1;
+        if (m_saturated) next++;
+    } else if (rate > m_lastRate * (1.0 + RATE_TOLERANCE)) {
+        if (m_direction < 0 || m_saturated) next += m_direction;
+    } else if (rate < m_lastRate * (1.0 - RATE_TOLERANCE)) {
+        m_direction = -m_direction;
+        if (m_direction < 0 || m_saturated) next += m_direction;
+    } else {
+        m_direction = -1;
+        next--;
+    }
+    m_limit = std::min(std::max(next, 1), m_max);
+    m_stats.low = std::min(m_stats.low, m_limit);
+    m_stats.high = std::max(m_stats.high, m_limit);
+
+    m_lastRate = rate;
+    m_windowStart = now;
+    m_windowOps = 0;
+    m_windowUnits = 0;
+    m_saturated = m_inUse >= m_limit;
+}
+
+AdaptiveLimit::Stats AdaptiveLimit::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.limit = m_limit;
+    return stats;
+}
+
+// --- CONTROLLER ---
+
+void ConcurrencyController::Configure(int maxWorkers, bool adaptive, int rotationalReaders) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxWorkers = std::max(1, maxWorkers);
+    m_adaptive = adaptive;
+    m_rotationalReaders = std::max(0, rotationalReaders);
+    m_limits.clear();
+    m_readers.clear();
+}
+
+AdaptiveLimit& ConcurrencyController::For(WorkStage stage, uint64_t device) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t disk = PhysicalDevice(device);
+    auto& limit = m_limits[std::make_pair((int)stage, disk)];
+    if (!limit) {
+        // Reads start wider than writes: most sources are read faster than
+        // the target is written
+        int initial = stage == WorkStage::Metadata ? 4 : 2;
+        limit.reset(new AdaptiveLimit(initial, m_maxWorkers, m_adaptive));
+    }
+    return *limit;
+}
+
+AdaptiveLimit* ConcurrencyController::Readers(uint64_t device) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_rotationalReaders == 0) return nullptr;
+    uint64_t disk = PhysicalDevice(device);
+    if (!m_rotational[disk]) return nullptr;
+    auto& limit = m_readers[disk];
+    if (!limit) limit.reset(new AdaptiveLimit(m_rotationalReaders, m_rotationalReaders, false));
+    return limit.get();
+}
+
+// Maps a filesystem's device to the whole disk through sysfs: a partition's
+// directory sits inside its disk's. Devices without a block device behind
+// them (tmpfs, NFS, overlay) stand for themselves.
+uint64_t ConcurrencyController::PhysicalDevice(uint64_t device) {
+    auto known = m_physical.find(device);
+    if (known != m_physical.end()) return known->second;
+
+    uint64_t disk = device;
+    std::string name;
+#ifdef __linux__
+    unsigned major = ::major((dev_t)device), minor = ::minor((dev_t)device);
+    name = std::to_string(major) + ":" + std::to_string(minor);
+    std::error_code ec;
+    fs::path node = fs::canonical("/sys/dev/block/" + name, ec);
+    if (!ec) {
+        if (fs::exists(node / "partition", ec)) node = node.parent_path();
+        std::ifstream devFile(node / "dev");
+        unsigned diskMajor = 0, diskMinor = 0;
+        char colon = 0;
+        if (devFile >> diskMajor >> colon >> diskMinor && colon == ':') {
+            disk = (uint64_t)makedev(diskMajor, diskMinor);
+            name = node.filename().string();
+            std::ifstream rotationalFile(node / "queue" / "rotational");
+            int rotational = 0;
+            m_rotational[disk] = (rotationalFile >> rotational) && rotational == 1;
+        }
+    }
+#else
+    name = device == 0 ? "default" : std::to_string(device);
+#endif
+    m_physical[device] = disk;
+    m_names.emplace(disk, name);
+    return disk;
+}
+
+std::vector<ConcurrencyController::Entry> ConcurrencyController::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Entry> entries;
+    for (const auto& limit : m_limits) {
+        Entry entry;
+        entry.stage = (WorkStage)limit.first.first;
+        auto name = m_names.find(limit.first.second);
+        entry.device = name != m_names.end() ? name->second : std::string();
+        auto rotational = m_rotational.find(limit.first.second);
+        entry.rotational = rotational != m_rotational.end() && rotational->second;
+        entry.stats = limit.second->GetStats();
+        entries.push_back(entry);
+    }
+    return entries;
+}
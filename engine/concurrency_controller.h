@@ -0,0 +1,122 @@
+// concurrency_controller.h
+// Run-time sizing of the work stages. Each stage (metadata reads, copies) has
+// its own limit per physical device on how many workers may be inside it at
+// once. A limit climbs while throughput improves and backs off once more
+// workers stop paying, so a USB 2 card reader settles at one or two readers
+// and an NVMe drive at many, and a slow target doesn't throttle the reads.
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+enum class WorkStage { Metadata, Copy };
+const int WORK_STAGE_COUNT = 2;
+
+const char* WorkStageName(WorkStage stage);
+
+class AdaptiveLimit {
+public:
+    struct Stats {
+        int limit = 0;              // At the end of the run
+        int low = 0;                // Range it moved in
+        int high = 0;
+        uint64_t operations = 0;
+        uint64_t units = 0;         // Files or bytes, see Release
+        double busySeconds = 0.0;   // Sum of the operations' durations
+    };
+
+    // Holds a slot for its lifetime; Done reports the work that was done.
+    class Permit {
+    public:
+        explicit Permit(AdaptiveLimit& limit) : Permit(&limit) {}
+        // A null limit holds nothing (no cap applies)
+        explicit Permit(AdaptiveLimit* limit);
+        ~Permit();
+        Permit(const Permit&) = delete;
+        Permit& operator=(const Permit&) = delete;
+
+        void Done(uint64_t units);
+
+    private:
+        AdaptiveLimit* m_limit;
+        std::chrono::steady_clock::time_point m_start;
+        bool m_done = false;
+    };
+
+    // A fixed limit never moves (an explicit --threads).
+    AdaptiveLimit(int initial, int maximum, bool adaptive);
+
+    // Blocks until fewer than limit workers are inside.
+    void Acquire();
+    // Frees the slot. units is the work done in any unit that scales with
+    // the device's throughput (files, bytes), seconds how long it took.
+    void Release(uint64_t units, double seconds);
+
+    Stats GetStats() const;
+
+private:
+    void Adjust(std::chrono::steady_clock::time_point now);
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    int m_limit;
+    int m_max;
+    bool m_adaptive;
+    int m_inUse = 0;
+    Stats m_stats;
+
+    // Current measurement window
+    std::chrono::steady_clock::time_point m_windowStart;
+    uint64_t m_windowUnits = 0;
+    uint64_t m_windowOps = 0;
+    bool m_saturated = false;   // All slots were taken at some point
+    double m_lastRate = 0.0;    // Units per second in the previous window
+    int m_direction = 1;
+};
+
+class ConcurrencyController {
+public:
+    struct Entry {
+        WorkStage stage;
+        std::string device;         // Kernel name (sda, nvme0n1), or major:minor
+        bool rotational = false;    // A spinning disk (Linux sysfs)
+        AdaptiveLimit::Stats stats;
+    };
+
+    // Forgets all limits. maxWorkers bounds every limit; without adaptive,
+    // each limit stays at maxWorkers, i.e. only the worker count applies.
+    // rotationalReaders > 0 caps the readers of each spinning disk, over
+    // both stages (see Readers).
+    void Configure(int maxWorkers, bool adaptive, int rotationalReaders = 0);
+
+    // The limit for a stage on the physical device holding the given
+    // filesystem device (st_dev). Partitions of one disk share it.
+    AdaptiveLimit& For(WorkStage stage, uint64_t device);
+
+    // The fixed cap on workers reading from the disk holding device, taken
+    // after the stage's limit; null where there is none (not a spinning
+    // disk, or no rotationalReaders).
+    AdaptiveLimit* Readers(uint64_t device);
+
+    std::vector<Entry> GetStats() const;
+
+private:
+    uint64_t PhysicalDevice(uint64_t device);
+
+    mutable std::mutex m_mutex;
+    int m_maxWorkers = 1;
+    bool m_adaptive = false;
+    int m_rotationalReaders = 0;
+    std::map<std::pair<int, uint64_t>, std::unique_ptr<AdaptiveLimit>> m_limits;
+    std::map<uint64_t, std::unique_ptr<AdaptiveLimit>> m_readers;  // Per spinning disk
+    std::map<uint64_t, uint64_t> m_physical;        // Filesystem device -> disk
+    std::map<uint64_t, std::string> m_names;        // Disk -> name
+    std::map<uint64_t, bool> m_rotational;          // Disk -> spinning
+};
@@ -0,0 +1,187 @@
+// content_hash.cpp
+#include "content_hash.h"
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+// --- XXH64 ---
+
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t Rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t Read64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+}
+
+static inline uint32_t Read32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = Rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+static inline uint64_t MergeRound(uint64_t acc, uint64_t val) {
+    acc ^= Round(0, val);
+    return acc * PRIME1 + PRIME4;
+}
+
+Xxh64::Xxh64(uint64_t seed) : m_seed(seed) {
+    m_v[0] = seed + PRIME1 + PRIME2;
+    m_v[1] = seed + PRIME2;
+    m_v[2] = seed;
+    m_v[3] = seed - PRIME1;
+}
+
+void Xxh64::Update(const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+    m_total += size;
+
+    if (m_buffered + size < 32) {
+        memcpy(m_buffer + m_buffered, p, size);
+        m_buffered += size;
+        return;
+    }
+    if (m_buffered > 0) {
+        size_t fill = 32 - m_buffered;
+        memcpy(m_buffer + m_buffered, p, fill);
+        for (int i = 0; i < 4; ++i) m_v[i] = Round(m_v[i], Read64(m_buffer + i * 8));
+        p += fill;
+        size -= fill;
+        m_buffered = 0;
+    }
+    while (size >= 32) {
+        m_v[0] = Round(m_v[0], Read64(p));
+        m_v[1] = Round(m_v[1], Read64(p + 8));
+        m_v[2] = Round(m_v[2], Read64(p + 16));
+        m_v[3] = Round(m_v[3], Read64(p + 24));
+        p += 32;
+        size -= 32;
+    }
+    memcpy(m_buffer, p, size);
+    m_buffered = size;
+}
+
+uint64_t Xxh64::Digest() const {
+    uint64_t h;
+    if (m_total >= 32) {
+        h = Rotl(m_v[0], 1) + Rotl(m_v[1], 7) + Rotl(m_v[2], 12) + Rotl(m_v[3], 18);
+        for (int i = 0; i < 4; ++i) h = MergeRound(h, m_v[i]);
+    } else {
+        h = m_seed + PRIME5;
+    }
+    h += m_total;
+
+    const uint8_t* p = m_buffer;
+    size_t left = m_buffered;
+    while (left >= 8) {
+        h ^= Round(0, Read64(p));
+        h = Rotl(h, 27) * PRIME1 + PRIME4;
+        p += 8;
+        left -= 8;
+    }
+    if (left >= 4) {
+        h ^= (uint64_t)Read32(p) * PRIME1;
+        h = Rotl(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+        left -= 4;
+    }
+    while (left > 0) {
+        h ^= (*p) * PRIME5;
+        h = Rotl(h, 11) * PRIME1;
+        p++;
+        left--;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t Xxh64::Hash(const void* data, size_t size, uint64_t seed) {
+    Xxh64 state(seed);
+    state.Update(data, size);
+    return state.Digest();
+}
+
+// --- FILE HASHES ---
+
+// The size is the seed, so files of different length never share a hash
+bool HashFileFull(SourceFile& file, uint64_t size, uint64_t& hash, uint64_t& bytesRead) {
+    if (!file.is_open()) return false;
+
+    Xxh64 state(size);
+    std::vector<char> buffer(1024 * 1024);
+    uint64_t total = 0;
+    while (total < size) {
+        size_t n = file.ReadAt(total, buffer.data(), (size_t)std::min<uint64_t>(buffer.size(), size - total));
+        if (n == 0) break;
+        state.Update(buffer.data(), n);
+        total += n;
+    }
+    bytesRead += total;
+    if (total != size) return false; // Changed underneath us
+    hash = state.Digest();
+    return true;
+}
+
+bool HashFilePartial(SourceFile& file, uint64_t size, uint64_t& hash, uint64_t& bytesRead) {
+    if (size <= 2 * PARTIAL_HASH_CHUNK) return HashFileFull(file, size, hash, bytesRead);
+
+    std::vector<char> buffer(2 * PARTIAL_HASH_CHUNK);
+    if (file.ReadAt(0, buffer.data(), PARTIAL_HASH_CHUNK) != PARTIAL_HASH_CHUNK) return false;
+    if (file.ReadAt(size - PARTIAL_HASH_CHUNK, buffer.data() + PARTIAL_HASH_CHUNK, PARTIAL_HASH_CHUNK) != PARTIAL_HASH_CHUNK) return false;
+
+    bytesRead += buffer.size();
+    hash = Xxh64::Hash(buffer.data(), buffer.size(), size);
+    return true;
+}
+
+bool HashFileFull(const fs::path& path, uint64_t size, uint64_t& hash, uint64_t& bytesRead) {
+    SourceFile file;
+    return file.Open(path) && HashFileFull(file, size, hash, bytesRead);
+}
+
+bool HashFilePartial(const fs::path& path, uint64_t size, uint64_t& hash, uint64_t& bytesRead) {
+    SourceFile file;
+    return file.Open(path) && HashFilePartial(file, size, hash, bytesRead);
+}
+
+bool FilesEqual(const fs::path& a, const fs::path& b, uint64_t& bytesRead) {
+    std::error_code ec;
+    uint64_t sizeA = fs::file_size(a, ec);
+    if (ec) return false;
+    uint64_t sizeB = fs::file_size(b, ec);
+    if (ec || sizeA != sizeB) return false;
+
+    std::ifstream inA(a, std::ios::binary);
+    std::ifstream inB(b, std::ios::binary);
+    if (!inA || !inB) return false;
+
+    std::vector<char> bufA(256 * 1024), bufB(256 * 1024);
+    while (true) {
+        inA.read(bufA.data(), (std::streamsize)bufA.size());
+        inB.read(bufB.data(), (std::streamsize)bufB.size());
+        std::streamsize nA = inA.gcount(), nB = inB.gcount();
+        bytesRead += (uint64_t)(nA + nB);
+        if (nA != nB || memcmp(bufA.data(), bufB.data(), (size_t)nA) != 0) return false;
+        if (nA == 0) return true;
+    }
+}
@@ -0,0 +1,40 @@
+// content_hash.h
+// XXH64 (xxHash, 64-bit variant) and the file hashes built on it. The partial
+// hash covers the size plus the first and last 64 KB, which is enough to tell
+// almost all equal-sized media files apart; the full hash reads everything.
+#pragma once
+
+#include "source_file.h"
+#include <filesystem>
+#include <cstdint>
+#include <cstddef>
+
+class Xxh64 {
+public:
+    explicit Xxh64(uint64_t seed = 0);
+    void Update(const void* data, size_t size);
+    uint64_t Digest() const;
+
+    static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0);
+
+private:
+    uint64_t m_v[4];
+    uint64_t m_seed;
+    uint64_t m_total = 0;
+    uint8_t m_buffer[32];
+    size_t m_buffered = 0;
+};
+
+const size_t PARTIAL_HASH_CHUNK = 64 * 1024;
+
+// Both return false if the file can't be read; bytesRead is added to.
+// For files up to 2 * PARTIAL_HASH_CHUNK the partial hash already covers the
+// whole file and equals the full hash.
+bool HashFilePartial(const std::filesystem::path& path, uint64_t size, uint64_t& hash, uint64_t& bytesRead);
+bool HashFileFull(const std::filesystem::path& path, uint64_t size, uint64_t& hash, uint64_t& bytesRead);
+// Same through a file that is open already
+bool HashFilePartial(SourceFile& file, uint64_t size, uint64_t& hash, uint64_t& bytesRead);
+bool HashFileFull(SourceFile& file, uint64_t size, uint64_t& hash, uint64_t& bytesRead);
+
+// Byte-for-byte comparison, stops at the first difference
+bool FilesEqual(const std::filesystem::path& a, const std::filesystem::path& b, uint64_t& bytesRead);
@@ -0,0 +1,205 @@
+// dedup_index.cpp
+#include "dedup_index.h"
+#include "content_hash.h"
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// Each pass decides under the shard lock what is still missing to settle the
+// question, computes it without the lock and writes the hashes back. New
+// entries may arrive meanwhile; the next pass picks them up. An entry still
+// in flight is waited for where it matters: a match only counts once it is
+// placed, and its source may vanish (a move) before Placed gives the new path.
+bool DedupIndex::Claim(const fs::path& file, uint64_t size, Ticket& ticket, fs::path& duplicateOf, SourceFile* source) {
+    Shard& shard = ShardFor(size);
+    const bool wholeInPartial = size <= 2 * PARTIAL_HASH_CHUNK;
+
+    Entry mine;
+    mine.path = file;
+    bool unreadable = false;
+
+    struct Job {
+        size_t index;
+        fs::path path;
+        bool ok;
+        uint64_t hash;
+    };
+
+    while (true) {
+        std::vector<Job> partialJobs, fullJobs;
+        bool needMyPartial = false, needMyFull = false;
+        {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            std::vector<Entry>& bucket = shard.bySize[size];
+
+            bool anyLive = false, waited = false;
+            for (size_t i = 0; i < bucket.size(); ++i) {
+                const Entry& e = bucket[i];
+                if (e.dead) continue;
+                anyLive = true;
+                if (!mine.hasPartial) break;
+
+                if (!e.hasPartial) {
+                    partialJobs.push_back({ i, e.path, false, 0 });
+                } else if (e.partial == mine.partial) {
+                    if (mine.hasFull && e.hasFull) {
+                        if (e.full != mine.full) continue;
+                        if (!e.placed) {
+                            WaitResolved(shard, lock, size, i);
+                            waited = true;
+                            break;
+                        }
+                        duplicateOf = e.path;
+                        return true;
+                    } else if (!mine.hasFull) {
+                        needMyFull = true;
+                    } else {
+                        fullJobs.push_back({ i, e.path, false, 0 });
+                    }
+                }
+            }
+            if (waited) continue;
+            if (anyLive && !mine.hasPartial && !unreadable) needMyPartial = true;
+
+            if (!needMyPartial && !needMyFull && partialJobs.empty() && fullJobs.empty()) {
+                ticket.size = size;
+                ticket.index = bucket.size();
+                bucket.push_back(std::move(mine));
+                return false;
+            }
+        }
+
+        uint64_t bytesRead = 0;
+        if (needMyPartial) {
+            bool ok = source ? HashFilePartial(*source, size, mine.partial, bytesRead)
+                             : HashFilePartial(file, size, mine.partial, bytesRead);
+            if (ok) {
+                mine.hasPartial = true;
+                if (wholeInPartial) {
+                    mine.full = mine.partial;
+                    mine.hasFull = true;
+                }
+            } else {
+                unreadable = true;
+            }
+        }
+        if (needMyFull && !unreadable && !mine.hasFull) {
+            m_fullHashes++;
+            bool ok = source ? HashFileFull(*source, size, mine.full, bytesRead)
+                             : HashFileFull(file, size, mine.full, bytesRead);
+            if (ok) mine.hasFull = true;
+            else unreadable = true;
+        }
+        for (auto& job : partialJobs) {
+            job.ok = HashFilePartial(job.path, size, job.hash, bytesRead);
+        }
+        for (auto& job : fullJobs) {
+            m_fullHashes++;
+            job.ok = HashFileFull(job.path, size, job.hash, bytesRead);
+        }
+        m_bytesHashed += bytesRead;
+
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        std::vector<Entry>& bucket = shard.bySize[size];
+        size_t inFlight = SIZE_MAX;
+        for (const auto& job : partialJobs) {
+            Entry& e = bucket[job.index];
+            if (!job.ok) { Unreadable(e, job.index, job.path, inFlight); continue; }
+            e.partial = job.hash;
+            e.hasPartial = true;
+            if (wholeInPartial) {
+                e.full = job.hash;
+                e.hasFull = true;
+            }
+        }
+        for (const auto& job : fullJobs) {
+            Entry& e = bucket[job.index];
+            if (!job.ok) { Unreadable(e, job.index, job.path, inFlight); continue; }
+            e.full = job.hash;
+            e.hasFull = true;
+        }
+        // Read again once it has settled, rather than hash a missing file in a loop
+        if (inFlight != SIZE_MAX) WaitResolved(shard, lock, size, inFlight);
+    }
+}
+
+// A placed copy that can't be read no longer matches anything. A path that
+// changed meanwhile is read again; an entry still in flight (its source
+// moved away, say) is read again once it has settled.
+void DedupIndex::Unreadable(Entry& e, size_t index, const fs::path& path, size_t& inFlight) {
+    if (e.dead || e.path != path) return;
+    if (e.placed) e.dead = true;
+    else inFlight = index;
+}
+
+void DedupIndex::WaitResolved(Shard& shard, std::unique_lock<std::mutex>& lock, uint64_t size, size_t index) {
+    shard.resolved.wait(lock, [&]() {
+        const Entry& e = shard.bySize[size][index];
+        return e.placed || e.dead;
+    });
+}
+
+void DedupIndex::Placed(const Ticket& ticket, const fs::path& placedAt) {
+    Shard& shard = ShardFor(ticket.size);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Entry& e = shard.bySize[ticket.size][ticket.index];
+        e.path = placedAt;
+        e.placed = true;
+    }
+    shard.resolved.notify_all();
+}
+
+void DedupIndex::Release(const Ticket& ticket) {
+    Shard& shard = ShardFor(ticket.size);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.bySize[ticket.size][ticket.index].dead = true;
+    }
+    shard.resolved.notify_all();
+}
+
+bool DedupIndex::PartialHash(const Ticket& ticket, uint64_t& hash, SourceFile* source) {
+    Shard& shard = ShardFor(ticket.size);
+    fs::path path;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const Entry& e = shard.bySize[ticket.size][ticket.index];
+        if (e.hasPartial) {
+            hash = e.partial;
+            return true;
+        }
+        path = e.path;
+    }
+
+    uint64_t bytesRead = 0;
+    bool ok = source ? HashFilePartial(*source, ticket.size, hash, bytesRead)
+                     : HashFilePartial(path, ticket.size, hash, bytesRead);
+    m_bytesHashed += bytesRead;
+    if (!ok) return false;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry& e = shard.bySize[ticket.size][ticket.index];
+    e.partial = hash;
+    e.hasPartial = true;
+    if (ticket.size <= 2 * PARTIAL_HASH_CHUNK) {
+        e.full = hash;
+        e.hasFull = true;
+    }
+    return true;
+}
+
+void DedupIndex::AddKnown(const fs::path& file, uint64_t size, uint64_t partialHash) {
+    Entry e;
+    e.path = file;
+    e.placed = true;
+    e.partial = partialHash;
+    e.hasPartial = true;
+    if (size <= 2 * PARTIAL_HASH_CHUNK) {
+        e.full = partialHash;
+        e.hasFull = true;
+    }
+    Shard& shard = ShardFor(size);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.bySize[size].push_back(std::move(e));
+}
@@ -0,0 +1,77 @@
+// dedup_index.h
+// Run-wide duplicate detection by content. Files are bucketed by size; only
+// when a size is seen twice are partial hashes (first/last 64 KB) computed,
+// and only when those collide too is the whole file hashed. Unique sizes
+// cost no reads at all. Buckets live in independently locked shards so
+// workers rarely contend, and no lock is held while hashing.
+#pragma once
+
+#include "source_file.h"
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+class DedupIndex {
+public:
+    struct Ticket {
+        uint64_t size = 0;
+        size_t index = 0;
+    };
+
+    // Adds the file, or returns true with duplicateOf set if identical
+    // content was already placed. Identical content that is claimed but not
+    // placed yet is waited for: if its placement fails, this file takes its
+    // place. Unreadable files are claimed as unique.
+    // source, if given, is the file open already: its hashes read from that.
+    bool Claim(const std::filesystem::path& file, uint64_t size, Ticket& ticket, std::filesystem::path& duplicateOf,
+               SourceFile* source = nullptr);
+
+    // After a claimed file has been placed: later comparisons read the placed
+    // copy (the source may be a temporary archive member). Every claim ends
+    // in Placed or Release.
+    void Placed(const Ticket& ticket, const std::filesystem::path& placedAt);
+    // The claimed file wasn't placed after all; it no longer matches anything.
+    void Release(const Ticket& ticket);
+
+    // Partial hash of a claimed file, computed now if no claim needed it yet
+    // (from source if given, else from where it was placed)
+    bool PartialHash(const Ticket& ticket, uint64_t& hash, SourceFile* source = nullptr);
+
+    // A file placed by an earlier run, with its partial hash already known
+    void AddKnown(const std::filesystem::path& file, uint64_t size, uint64_t partialHash);
+
+    uint64_t BytesHashed() const { return m_bytesHashed; }
+    uint64_t FullHashes() const { return m_fullHashes; }
+
+private:
+    struct Entry {
+        std::filesystem::path path;
+        uint64_t partial = 0;
+        uint64_t full = 0;
+        bool hasPartial = false;
+        bool hasFull = false;
+        bool placed = false;    // In the target; until then path is the source
+        bool dead = false;      // Released, or its placed copy couldn't be read
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::condition_variable resolved;   // An entry was placed or released
+        std::unordered_map<uint64_t, std::vector<Entry>> bySize;
+    };
+
+    static const int SHARD_COUNT = 64;
+
+    static void Unreadable(Entry& e, size_t index, const std::filesystem::path& path, size_t& inFlight);
+    static void WaitResolved(Shard& shard, std::unique_lock<std::mutex>& lock, uint64_t size, size_t index);
+
+    Shard& ShardFor(uint64_t size) { return m_shards[(size * 0x9E3779B97F4A7C15ULL) >> 58]; }
+
+    Shard m_shards[SHARD_COUNT];
+    std::atomic<uint64_t> m_bytesHashed{0};
+    std::atomic<uint64_t> m_fullHashes{0};
+};
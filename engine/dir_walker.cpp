@@ -0,0 +1,259 @@
+// dir_walker.cpp
+#include "dir_walker.h"
+#include <cerrno>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace fs = std::filesystem;
+
+DirWalker::DirWalker(int threads) : m_threadCount(threads < 1 ? 1 : threads) {
+    for (int i = 0; i < m_threadCount; ++i) {
+        m_deques.push_back(std::make_unique<WorkerDeque>());
+    }
+}
+
+DirWalker::Stats DirWalker::GetStats() const {
+    Stats stats;
+    stats.directories = m_dirsListed;
+    stats.files = m_files;
+    stats.statCalls = m_statCalls;
+    stats.errors = m_errors;
+    return stats;
+}
+
+void DirWalker::PushDir(int index, fs::path&& dir) {
+    m_pending++;
+    m_dirsFound++;
+    {
+        WorkerDeque& q = *m_deques[index];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.dirs.push_back(std::move(dir));
+    }
+    if (m_idleThreads > 0) m_idleCond.notify_one();
+}
+
+// Own work is taken newest-first (depth-first, keeps the dentry cache warm)...
+bool DirWalker::PopLocal(int index, fs::path& dir) {
+    WorkerDeque& q = *m_deques[index];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.dirs.empty()) return false;
+    dir = std::move(q.dirs.back());
+    q.dirs.pop_back();
+    return true;
+}
+
+// ...while thieves take the oldest entry, which is usually the biggest subtree.
+bool DirWalker::Steal(int index, fs::path& dir) {
+    for (int i = 1; i < m_threadCount; ++i) {
+        WorkerDeque& q = *m_deques[(index + i) % m_threadCount];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.dirs.empty()) continue;
+        dir = std::move(q.dirs.front());
+        q.dirs.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void DirWalker::WorkerLoop(int index) {
+    fs::path dir;
+    while (true) {
+        if (PopLocal(index, dir) || Steal(index, dir)) {
+            if (!(m_stopRequested && *m_stopRequested)) {
+                if (ListDirectory(index, dir)) m_dirsListed++;
+                else m_errors++;
+            }
+            if (--m_pending == 0) {
+                std::lock_guard<std::mutex> lock(m_idleMutex);
+                m_idleCond.notify_all();
+            }
+            continue;
+        }
+
+        if (m_pending == 0) break;
+
+        // Someone is still listing and may push more work
+        std::unique_lock<std::mutex> lock(m_idleMutex);
+        m_idleThreads++;
+        m_idleCond.wait_for(lock, std::chrono::milliseconds(2));
+        m_idleThreads--;
+    }
+}
+
+void DirWalker::Walk(const std::vector<fs::path>& roots, const FileCallback& onFile, const std::atomic<bool>* stopRequested) {
+    m_onFile = &onFile;
+    m_stopRequested = stopRequested;
+    m_pending = 0;
+    m_dirsListed = 0;
+    m_dirsFound = 0;
+    m_files = 0;
+    m_statCalls = 0;
+    m_errors = 0;
+
+    for (size_t i = 0; i < roots.size(); ++i) {
+        // Throws filesystem_error if the root is unreadable
+        fs::directory_iterator probe(roots[i]);
+        PushDir((int)(i % m_threadCount), fs::path(roots[i]));
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < m_threadCount; ++i) {
+        threads.emplace_back(&DirWalker::WorkerLoop, this, i);
+    }
+    WorkerLoop(0);
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+// --- PLATFORM LISTING ---
+
+#ifdef _WIN32
+
+bool DirWalker::ListDirectory(int index, const fs::path& dir) {
+    WIN32_FIND_DATAW data;
+    HANDLE hFind = FindFirstFileExW((dir / L"*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        return GetLastError() == ERROR_FILE_NOT_FOUND;
+    }
+
+    do {
+        const wchar_t* name = data.cFileName;
+        if (name[0] == L'.' && (name[1] == 0 || (name[1] == L'.' && name[2] == 0))) continue;
+
+        DWORD attrs = data.dwFileAttributes;
+        if (attrs & FILE_ATTRIBUTE_DIRECTORY) {
+            // Junctions and directory symlinks are not followed
+            if (!(attrs & FILE_ATTRIBUTE_REPARSE_POINT)) PushDir(index, dir / name);
+        } else if (!(attrs & FILE_ATTRIBUTE_DEVICE)) {
+            m_files++;
+            (*m_onFile)(dir / name, 0);
+        }
+    } while (FindNextFileW(hFind, &data));
+    bool complete = GetLastError() == ERROR_NO_MORE_FILES;
+
+    FindClose(hFind);
+    return complete;
+}
+
+#else
+
+// Resolves entries the listing couldn't type. Symlinks to files count as files
+// (as with directory_entry::is_regular_file); symlinks to directories are not
+// followed (as with recursive_directory_iterator).
+static bool ClassifyByStat(int dirFd, const char* name, bool isLink, bool& isDir, bool& isFile) {
+    struct stat st;
+    if (!isLink) {
+        if (fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) return false;
+        if (!S_ISLNK(st.st_mode)) {
+            isDir = S_ISDIR(st.st_mode);
+            isFile = S_ISREG(st.st_mode);
+            return true;
+        }
+    }
+    if (fstatat(dirFd, name, &st, 0) != 0) return false;
+    isDir = false;
+    isFile = S_ISREG(st.st_mode);
+    return true;
+}
+
+#ifdef __linux__
+
+struct LinuxDirent64 {
+    uint64_t ino;
+    int64_t off;
+    unsigned short reclen;
+    unsigned char type;
+    char name[1];
+};
+
+bool DirWalker::ListDirectory(int index, const fs::path& dir) {
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    alignas(8) char buffer[64 * 1024];
+    while (true) {
+        long n = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+        if (n < 0) {
+            // EIO from a failing card: what was listed stands, the rest is an error
+            close(fd);
+            return false;
+        }
+        if (n == 0) break;
+
+        for (long pos = 0; pos < n;) {
+            const LinuxDirent64* d = (const LinuxDirent64*)(buffer + pos);
+            pos += d->reclen;
+            const char* name = d->name;
+            if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) continue;
+
+            bool isDir = d->type == DT_DIR;
+            bool isFile = d->type == DT_REG;
+            if (d->type == DT_UNKNOWN || d->type == DT_LNK) {
+                m_statCalls++;
+                if (!ClassifyByStat(fd, name, d->type == DT_LNK, isDir, isFile)) continue;
+            }
+
+            if (isDir) {
+                PushDir(index, dir / name);
+            } else if (isFile) {
+                m_files++;
+                (*m_onFile)(dir / name, d->ino);
+            }
+        }
+    }
+
+    close(fd);
+    return true;
+}
+
+#else
+
+bool DirWalker::ListDirectory(int index, const fs::path& dir) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) return false;
+    int fd = dirfd(d);
+
+    // readdir returns null both at the end and on an error; only errno tells
+    errno = 0;
+    while (struct dirent* e = readdir(d)) {
+        const char* name = e->d_name;
+        if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) continue;
+
+        bool isDir = e->d_type == DT_DIR;
+        bool isFile = e->d_type == DT_REG;
+        if (e->d_type == DT_UNKNOWN || e->d_type == DT_LNK) {
+            m_statCalls++;
+            if (!ClassifyByStat(fd, name, e->d_type == DT_LNK, isDir, isFile)) continue;
+        }
+
+        if (isDir) {
+            PushDir(index, dir / name);
+        } else if (isFile) {
+            m_files++;
+            (*m_onFile)(dir / name, (uint64_t)e->d_ino);
+        }
+        errno = 0;
+    }
+    bool complete = errno == 0;
+
+    closedir(d);
+    return complete;
+}
+
+#endif
+#endif
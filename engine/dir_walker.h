@@ -0,0 +1,74 @@
+// dir_walker.h
+// Parallel recursive directory walker. Subdirectories are spread over a pool of
+// threads, each with its own deque; idle threads steal the oldest (largest)
+// pending directories from the others. Entry types come from the directory
+// listing itself (getdents64 d_type on Linux, FindFirstFileEx attributes on
+// Windows), so files are reported without a stat call per entry.
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+class DirWalker {
+public:
+    // Invoked concurrently from walker threads for every regular file, with
+    // its inode number from the listing (d_ino; 0 on Windows).
+    using FileCallback = std::function<void(std::filesystem::path&&, uint64_t inode)>;
+
+    struct Stats {
+        uint64_t directories = 0;   // Directories listed
+        uint64_t files = 0;         // Regular files reported
+        uint64_t statCalls = 0;     // Entries whose type had to be stat'ed
+        uint64_t errors = 0;        // Subdirectories that could not be opened or listed to the end
+    };
+
+    explicit DirWalker(int threads);
+
+    // Walks all roots and returns once every directory has been listed.
+    // Throws std::runtime_error if a root can't be opened; unreadable
+    // subdirectories are counted in Stats::errors and skipped, and so are
+    // listings cut short by a read error (after the files listed so far).
+    void Walk(const std::vector<std::filesystem::path>& roots, const FileCallback& onFile,
+              const std::atomic<bool>* stopRequested = nullptr);
+
+    Stats GetStats() const;
+
+    // Progress, safe to read while Walk runs
+    uint64_t DirectoriesListed() const { return m_dirsListed; }
+    uint64_t DirectoriesFound() const { return m_dirsFound; }
+
+private:
+    struct WorkerDeque {
+        std::mutex mutex;
+        std::deque<std::filesystem::path> dirs;
+    };
+
+    void WorkerLoop(int index);
+    bool PopLocal(int index, std::filesystem::path& dir);
+    bool Steal(int index, std::filesystem::path& dir);
+    void PushDir(int index, std::filesystem::path&& dir);
+    bool ListDirectory(int index, const std::filesystem::path& dir);
+
+    int m_threadCount;
+    std::vector<std::unique_ptr<WorkerDeque>> m_deques;
+    const FileCallback* m_onFile = nullptr;
+    const std::atomic<bool>* m_stopRequested = nullptr;
+
+    std::atomic<int64_t> m_pending{0};      // Directories queued or being listed
+    std::mutex m_idleMutex;
+    std::condition_variable m_idleCond;
+    std::atomic<int> m_idleThreads{0};
+
+    std::atomic<uint64_t> m_dirsListed{0};
+    std::atomic<uint64_t> m_dirsFound{0};
+    std::atomic<uint64_t> m_files{0};
+    std::atomic<uint64_t> m_statCalls{0};
+    std::atomic<uint64_t> m_errors{0};
+};
@@ -0,0 +1,117 @@
+// disk_order.cpp
+#include "disk_order.h"
+#include <algorithm>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#include <cerrno>
+#endif
+
+static const char* const ORDER_NAMES[DISK_ORDER_COUNT] = { "off", "inode", "extent" };
+
+const char* DiskOrderName(DiskOrder order) {
+    return ORDER_NAMES[(int)order];
+}
+
+bool ParseDiskOrder(const std::string& name, DiskOrder& order) {
+    for (int i = 0; i < DISK_ORDER_COUNT; ++i) {
+        if (name == ORDER_NAMES[i]) {
+            order = (DiskOrder)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef __linux__
+
+// No FIEMAP_FLAG_SYNC: flushing dirty pages to learn their place isn't worth it
+bool GetPhysicalOffset(const std::filesystem::path& path, uint64_t& offset, bool* unsupported) {
+    if (unsupported) *unsupported = false;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    // The header plus room for the one extent asked for
+    alignas(struct fiemap) unsigned char request[sizeof(struct fiemap) + sizeof(struct fiemap_extent)] = {};
+    struct fiemap* map = reinterpret_cast<struct fiemap*>(request);
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+    bool ok = ioctl(fd, FS_IOC_FIEMAP, map) == 0;
+    int err = errno;
+    close(fd);
+    if (!ok) {
+        if (unsupported) *unsupported = err == ENOTTY || err == EOPNOTSUPP || err == ENOSYS || err == EINVAL;
+        return false;
+    }
+    offset = map->fm_mapped_extents > 0 ? (uint64_t)map->fm_extents[0].fe_physical : 0;
+    return true;
+}
+
+#else
+
+bool GetPhysicalOffset(const std::filesystem::path&, uint64_t&, bool* unsupported) {
+    if (unsupported) *unsupported = true;
+    return false;
+}
+
+#endif
+
+// --- BATCHER ---
+
+DiskOrderBatcher::DiskOrderBatcher(DiskOrder order, size_t batchSize, Sink sink)
+    : m_order(order), m_batchSize(std::max<size_t>(1, batchSize)), m_sink(std::move(sink)) {
+    m_batch.reserve(m_batchSize);
+}
+
+void DiskOrderBatcher::Add(std::filesystem::path&& path, uint64_t inode) {
+    Entry entry;
+    entry.inode = inode;
+    entry.extent = 0;
+    entry.hasExtent = false;
+    if (m_order == DiskOrder::Extent && m_extentsWork) {
+        bool unsupported = false;
+        entry.hasExtent = GetPhysicalOffset(path, entry.extent, &unsupported);
+        if (unsupported) m_extentsWork = false;
+        else if (!entry.hasExtent) entry.hasExtent = true; // Gone or unreadable: fails first, wherever it goes
+    }
+    entry.path = std::move(path);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_batch.push_back(std::move(entry));
+    if (m_batch.size() < m_batchSize) return;
+    std::vector<Entry> batch;
+    batch.reserve(m_batchSize);
+    batch.swap(m_batch);
+    // Taken before letting go of the batch, so batches go out in order
+    std::lock_guard<std::mutex> dispatch(m_dispatchMutex);
+    lock.unlock();
+    Dispatch(batch);
+}
+
+void DiskOrderBatcher::Flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::vector<Entry> batch;
+    batch.swap(m_batch);
+    std::lock_guard<std::mutex> dispatch(m_dispatchMutex);
+    lock.unlock();
+    Dispatch(batch);
+}
+
+// Inodes where any file of the batch has no extent: the two don't compare.
+// Ties (Windows has neither) keep the walker's order.
+void DiskOrderBatcher::Dispatch(std::vector<Entry>& batch) {
+    bool byExtent = m_order == DiskOrder::Extent &&
+        std::all_of(batch.begin(), batch.end(), [](const Entry& e) { return e.hasExtent; });
+    if (byExtent) {
+        std::stable_sort(batch.begin(), batch.end(), [](const Entry& a, const Entry& b) { return a.extent < b.extent; });
+        m_extentKeys += batch.size();
+    } else {
+        std::stable_sort(batch.begin(), batch.end(), [](const Entry& a, const Entry& b) { return a.inode < b.inode; });
+        m_inodeKeys += batch.size();
+    }
+    for (Entry& entry : batch) m_sink(std::move(entry.path));
+}
@@ -0,0 +1,65 @@
+// disk_order.h
+// Locality-aware scheduling. The walker finds files in directory order,
+// which on a spinning disk or an SD card can mean a seek between every two
+// files. The scheduler collects them in batches and passes each batch on
+// sorted by where the files lie: the physical offset of their first extent
+// (FIEMAP, Linux) where the filesystem reports it, else their inode number,
+// which most filesystems allocate near the data.
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+enum class DiskOrder { Off, Inode, Extent };
+const int DISK_ORDER_COUNT = 3;
+
+const char* DiskOrderName(DiskOrder order);
+bool ParseDiskOrder(const std::string& name, DiskOrder& order);
+
+// Physical byte offset of the file's first extent on its device; a file
+// without data maps to 0. False if it can't be told, and then unsupported,
+// if given, tells whether that goes for the whole filesystem or platform.
+bool GetPhysicalOffset(const std::filesystem::path& path, uint64_t& offset, bool* unsupported = nullptr);
+
+class DiskOrderBatcher {
+public:
+    using Sink = std::function<void(std::filesystem::path&&)>;
+
+    // sink receives every file, a batch at a time, from whichever thread
+    // filled the batch; batches never interleave.
+    DiskOrderBatcher(DiskOrder order, size_t batchSize, Sink sink);
+
+    // Safe to call from several threads (the walker's)
+    void Add(std::filesystem::path&& path, uint64_t inode);
+    // Passes on what is left once the walk is over
+    void Flush();
+
+    uint64_t ExtentKeys() const { return m_extentKeys; }
+    uint64_t InodeKeys() const { return m_inodeKeys; }
+
+private:
+    struct Entry {
+        std::filesystem::path path;
+        uint64_t inode;
+        uint64_t extent;
+        bool hasExtent;
+    };
+
+    void Dispatch(std::vector<Entry>& batch);
+
+    DiskOrder m_order;
+    size_t m_batchSize;
+    Sink m_sink;
+    std::mutex m_mutex;
+    std::mutex m_dispatchMutex;
+    std::vector<Entry> m_batch;
+    std::atomic<bool> m_extentsWork{true};  // Off after the filesystem refused FIEMAP
+    std::atomic<uint64_t> m_extentKeys{0};
+    std::atomic<uint64_t> m_inodeKeys{0};
+};
@@ -0,0 +1,386 @@
+// exif_reader.h
+// Minimal, portable EXIF reader. Walks the JPEG APP1 segment or a TIFF header
+// directly and only extracts the tags the sorter needs, without decoding any
+// image data. TIFF-based camera RAW files (CR2, NEF, ARW, DNG, ORF, RW2) are
+// read through TiffStreamView, which fetches only the pages the IFDs and
+// their values sit in, wherever they are in the file.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+struct ExifInfo {
+    bool hasDate = false;
+    int year = 0;
+    int month = 0;
+    int day = 0;
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+
+    bool hasGps = false;
+    double latitude = 0.0;
+    double longitude = 0.0;
+};
+
+namespace exif {
+
+// Tags we care about
+const uint16_t TAG_EXIF_IFD        = 0x8769;
+const uint16_t TAG_GPS_IFD         = 0x8825;
+const uint16_t TAG_DATE_ORIGINAL   = 0x9003;
+const uint16_t TAG_GPS_LAT_REF     = 0x0001;
+const uint16_t TAG_GPS_LAT         = 0x0002;
+const uint16_t TAG_GPS_LON_REF     = 0x0003;
+const uint16_t TAG_GPS_LON         = 0x0004;
+
+const uint16_t TYPE_ASCII    = 2;
+const uint16_t TYPE_LONG     = 4;
+const uint16_t TYPE_RATIONAL = 5;
+const uint16_t TYPE_IFD      = 13;
+
+// Bytes read from the head of a file. The APP1 segment is at most 64 KB and
+// sits right after SOI in practice, so this covers it with room to spare.
+const size_t HEADER_WINDOW = 128 * 1024;
+
+// --- TIFF STRUCTURE ---
+
+// Byte order mark plus the version: 42 for TIFF (and the RAW formats built
+// on it), 0x4F52/0x5352 for Olympus ORF, 0x55 for Panasonic RW2.
+inline bool IsTiffHeader(const uint8_t* p, size_t size, bool& littleEndian) {
+    if (size < 8) return false;
+    if (p[0] == 'I' && p[1] == 'I') littleEndian = true;
+    else if (p[0] == 'M' && p[1] == 'M') littleEndian = false;
+    else return false;
+    uint16_t version = littleEndian ? (uint16_t)(p[2] | (p[3] << 8)) : (uint16_t)((p[2] << 8) | p[3]);
+    return version == 42 || version == 0x4F52 || version == 0x5352 || version == 0x55;
+}
+
+// Accessors shared by the views: value reads in the block's byte order
+template<typename View>
+class TiffValues {
+public:
+    uint16_t u16(size_t off) const {
+        uint8_t p[2];
+        if (!static_cast<const View*>(this)->read(off, p, 2)) return 0;
+        return m_littleEndian ? (uint16_t)(p[0] | (p[1] << 8)) : (uint16_t)((p[0] << 8) | p[1]);
+    }
+
+    uint32_t u32(size_t off) const {
+        uint8_t p[4];
+        if (!static_cast<const View*>(this)->read(off, p, 4)) return 0;
+        return m_littleEndian
+            ? ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24))
+            : (((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3]);
+    }
+
+protected:
+    bool m_littleEndian = true;
+};
+
+// A TIFF block in memory.
+class TiffView : public TiffValues<TiffView> {
+public:
+    TiffView(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+    bool init() { return IsTiffHeader(m_data, m_size, m_littleEndian); }
+
+    bool has(uint64_t offset, uint64_t len) const {
+        return offset <= m_size && len <= m_size - offset;
+    }
+
+    bool read(size_t off, void* out, size_t len) const {
+        if (!has(off, len)) return false;
+        memcpy(out, m_data + off, len);
+        return true;
+    }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+};
+
+// A TIFF file: the head already read, and beyond it pages loaded from the
+// stream as the IFDs and values are reached. RAW files keep their IFDs
+// small and near each other, so that's a few reads of PAGE_SIZE.
+class TiffStreamView : public TiffValues<TiffStreamView> {
+public:
+    static const size_t PAGE_SIZE = 4096;
+
+    TiffStreamView(const uint8_t* head, size_t headSize, std::istream& stream, uint64_t fileSize)
+        : m_head(head), m_headSize(headSize), m_stream(stream), m_size(fileSize) {}
+
+    bool init() { return IsTiffHeader(m_head, m_headSize, m_littleEndian); }
+
+    bool has(uint64_t offset, uint64_t len) const {
+        return offset <= m_size && len <= m_size - offset;
+    }
+
+    bool read(size_t off, void* out, size_t len) const {
+        if (!has(off, len)) return false;
+        uint8_t* dst = (uint8_t*)out;
+        while (len > 0) {
+            size_t n;
+            if (off < m_headSize) {
+                n = std::min(len, m_headSize - off);
+                memcpy(dst, m_head + off, n);
+            } else {
+                const std::vector<uint8_t>* page = Page(off / PAGE_SIZE);
+                size_t inPage = off % PAGE_SIZE;
+                if (!page || inPage >= page->size()) return false;
+                n = std::min(len, page->size() - inPage);
+                memcpy(dst, page->data() + inPage, n);
+            }
+            dst += n;
+            off += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    uint64_t bytesRead() const { return m_bytesRead; }
+
+private:
+    const std::vector<uint8_t>* Page(uint64_t index) const {
+        auto found = m_pages.find(index);
+        if (found != m_pages.end()) return &found->second;
+        // Hostile offsets could walk the whole file
+        if (m_pages.size() >= 64) return nullptr;
+        std::vector<uint8_t>& page = m_pages[index];
+        page.resize(PAGE_SIZE);
+        m_stream.clear();
+        m_stream.seekg((std::streamoff)(index * PAGE_SIZE));
+        m_stream.read((char*)page.data(), (std::streamsize)page.size());
+        page.resize((size_t)m_stream.gcount());
+        m_bytesRead += page.size();
+        return &page;
+    }
+
+    const uint8_t* m_head;
+    size_t m_headSize;
+    std::istream& m_stream;
+    uint64_t m_size;
+    mutable std::map<uint64_t, std::vector<uint8_t>> m_pages;
+    mutable uint64_t m_bytesRead = 0;
+};
+
+struct IfdEntry {
+    uint16_t tag = 0;
+    uint16_t type = 0;
+    uint32_t count = 0;
+    size_t valueOffset = 0; // Offset of the value bytes within the TIFF block
+};
+
+inline size_t TypeSize(uint16_t type) {
+    switch (type) {
+    case 1: case 2: case 6: case 7: return 1;
+    case 3: case 8: return 2;
+    case 4: case 9: case 11: return 4;
+    case 5: case 10: case 12: return 8;
+    default: return 0;
+    }
+}
+
+// Calls fn(entry) for each well-formed entry of the IFD at ifdOffset.
+template<typename View, typename Fn>
+bool ForEachEntry(const View& tiff, uint32_t ifdOffset, Fn fn) {
+    if (!tiff.has(ifdOffset, 2)) return false;
+    uint16_t count = tiff.u16(ifdOffset);
+    if (!tiff.has(ifdOffset + 2, (uint64_t)count * 12)) return false;
+
+    for (uint16_t i = 0; i < count; ++i) {
+        size_t e = ifdOffset + 2 + (size_t)i * 12;
+        IfdEntry entry;
+        entry.tag = tiff.u16(e);
+        entry.type = tiff.u16(e + 2);
+        entry.count = tiff.u32(e + 4);
+
+        uint64_t bytes = (uint64_t)TypeSize(entry.type) * entry.count;
+        if (bytes == 0) continue;
+        entry.valueOffset = bytes <= 4 ? e + 8 : tiff.u32(e + 8);
+        if (!tiff.has(entry.valueOffset, bytes)) continue;
+        fn(entry);
+    }
+    return true;
+}
+
+inline bool ParseDigits(const char* s, int len, int& out) {
+    int v = 0;
+    for (int i = 0; i < len; ++i) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        v = v * 10 + (s[i] - '0');
+    }
+    out = v;
+    return true;
+}
+
+// "YYYY:MM:DD HH:MM:SS"
+inline bool ParseExifDate(const char* s, size_t len, ExifInfo& out) {
+    if (len < 19) return false;
+    ExifInfo d;
+    if (!ParseDigits(s, 4, d.year) || !ParseDigits(s + 5, 2, d.month) || !ParseDigits(s + 8, 2, d.day) ||
+        !ParseDigits(s + 11, 2, d.hour) || !ParseDigits(s + 14, 2, d.minute) || !ParseDigits(s + 17, 2, d.second)) {
+        return false;
+    }
+    // Cameras without a clock write "0000:00:00 00:00:00"
+    if (d.year == 0 || d.month < 1 || d.month > 12 || d.day < 1 || d.day > 31) return false;
+
+    out.year = d.year; out.month = d.month; out.day = d.day;
+    out.hour = d.hour; out.minute = d.minute; out.second = d.second;
+    out.hasDate = true;
+    return true;
+}
+
+// Degrees/minutes/seconds as three unsigned rationals
+template<typename View>
+bool ReadGpsCoordinate(const View& tiff, const IfdEntry& e, double& out) {
+    if (e.type != TYPE_RATIONAL || e.count < 3) return false;
+    double parts[3];
+    for (int i = 0; i < 3; ++i) {
+        uint32_t num = tiff.u32(e.valueOffset + i * 8);
+        uint32_t den = tiff.u32(e.valueOffset + i * 8 + 4);
+        parts[i] = den == 0 ? 0.0 : (double)num / (double)den;
+    }
+    out = parts[0] + parts[1] / 60.0 + parts[2] / 3600.0;
+    return true;
+}
+
+// Which IFD the block's first IFD is. Canon CR3 stores the EXIF and GPS
+// IFDs as TIFF blocks of their own (CMT2, CMT4).
+enum class TiffRoot { Ifd0, Exif, Gps };
+
+template<typename View>
+bool ParseTiffView(const View& tiff, ExifInfo& out, TiffRoot root = TiffRoot::Ifd0) {
+    uint32_t exifIfd = 0;
+    uint32_t gpsIfd = 0;
+    if (root == TiffRoot::Exif) exifIfd = tiff.u32(4);
+    else if (root == TiffRoot::Gps) gpsIfd = tiff.u32(4);
+    else {
+        ForEachEntry(tiff, tiff.u32(4), [&](const IfdEntry& e) {
+            if (e.tag == TAG_EXIF_IFD && (e.type == TYPE_LONG || e.type == TYPE_IFD)) exifIfd = tiff.u32(e.valueOffset);
+            else if (e.tag == TAG_GPS_IFD && (e.type == TYPE_LONG || e.type == TYPE_IFD)) gpsIfd = tiff.u32(e.valueOffset);
+        });
+    }
+
+    if (exifIfd) {
+        ForEachEntry(tiff, exifIfd, [&](const IfdEntry& e) {
+            if (e.tag == TAG_DATE_ORIGINAL && e.type == TYPE_ASCII) {
+                char date[20] = {};
+                size_t len = e.count < sizeof(date) ? e.count : sizeof(date);
+                if (tiff.read(e.valueOffset, date, len)) ParseExifDate(date, len, out);
+            }
+        });
+    }
+
+    if (gpsIfd) {
+        char latRef = 0, lonRef = 0;
+        double lat = 0.0, lon = 0.0;
+        bool hasLat = false, hasLon = false;
+        ForEachEntry(tiff, gpsIfd, [&](const IfdEntry& e) {
+            switch (e.tag) {
+            case TAG_GPS_LAT_REF: if (e.type == TYPE_ASCII) tiff.read(e.valueOffset, &latRef, 1); break;
+            case TAG_GPS_LON_REF: if (e.type == TYPE_ASCII) tiff.read(e.valueOffset, &lonRef, 1); break;
+            case TAG_GPS_LAT: hasLat = ReadGpsCoordinate(tiff, e, lat); break;
+            case TAG_GPS_LON: hasLon = ReadGpsCoordinate(tiff, e, lon); break;
+            }
+        });
+        if (hasLat && hasLon && latRef && lonRef) {
+            out.latitude = latRef == 'S' ? -lat : lat;
+            out.longitude = lonRef == 'W' ? -lon : lon;
+            out.hasGps = true;
+        }
+    }
+    return true;
+}
+
+// Parses a TIFF block ("II*\0" / "MM\0*") as found in APP1 or at the start of a TIFF file.
+inline bool ParseTiff(const uint8_t* data, size_t size, ExifInfo& out, TiffRoot root = TiffRoot::Ifd0) {
+    TiffView tiff(data, size);
+    if (!tiff.init()) return false;
+    return ParseTiffView(tiff, out, root);
+}
+
+// A TIFF or TIFF-based RAW file of fileSize bytes, whose first headSize
+// bytes are in head; the IFDs beyond it are read from stream.
+inline bool ParseTiffStream(const uint8_t* head, size_t headSize, std::istream& stream, uint64_t fileSize,
+                            ExifInfo& out, uint64_t* bytesRead = nullptr) {
+    TiffStreamView tiff(head, headSize, stream, fileSize);
+    if (!tiff.init()) return false;
+    bool ok = ParseTiffView(tiff, out);
+    if (bytesRead) *bytesRead = tiff.bytesRead();
+    return ok;
+}
+
+// --- JPEG STRUCTURE ---
+
+// Locates the "Exif\0\0" APP1 payload. Returns false if there is none, or
+// if the markers before it or the segment itself run past the end of the
+// buffer: then needed, if given, receives the size that would get further.
+inline bool FindJpegExif(const uint8_t* data, size_t size, size_t& tiffOffset, size_t& tiffSize, size_t* needed = nullptr) {
+    if (needed) *needed = 0;
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+    size_t pos = 2;
+    while (true) {
+        if (pos + 4 > size) {
+            if (needed) *needed = pos + 4;
+            return false;
+        }
+        if (data[pos] != 0xFF) return false;
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) { ++pos; continue; } // fill byte
+        if (marker == 0xD9 || marker == 0xDA) return false; // EOI / SOS: no more metadata
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) { pos += 2; continue; }
+
+        size_t len = ((size_t)data[pos + 2] << 8) | data[pos + 3];
+        if (len < 2) return false;
+        if (marker == 0xE1 && len >= 8) {
+            if (pos + 10 > size) {
+                if (needed) *needed = pos + 10;
+                return false;
+            }
+            if (memcmp(data + pos + 4, "Exif\0\0", 6) == 0) {
+                tiffOffset = pos + 10;
+                tiffSize = len - 8;
+                if (tiffOffset + tiffSize <= size) return true;
+                if (needed) *needed = tiffOffset + tiffSize;
+                return false;
+            }
+        }
+        pos += 2 + len;
+    }
+}
+
+inline bool ParseJpeg(const uint8_t* data, size_t size, ExifInfo& out) {
+    size_t off = 0, len = 0;
+    if (!FindJpegExif(data, size, off, len)) return false;
+    return ParseTiff(data + off, len, out);
+}
+
+// Dispatches on the leading magic bytes.
+inline bool ParseBuffer(const uint8_t* data, size_t size, ExifInfo& out) {
+    if (size >= 2 && data[0] == 0xFF && data[1] == 0xD8) return ParseJpeg(data, size, out);
+    bool littleEndian;
+    if (IsTiffHeader(data, size, littleEndian)) return ParseTiff(data, size, out);
+    return false;
+}
+
+// Reads only the header window of the file and parses it.
+inline bool ReadExif(const std::filesystem::path& path, ExifInfo& out, size_t window = HEADER_WINDOW) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    std::vector<uint8_t> buffer(window);
+    in.read((char*)buffer.data(), (std::streamsize)buffer.size());
+    size_t got = (size_t)in.gcount();
+    if (got < 4) return false;
+    return ParseBuffer(buffer.data(), got, out);
+}
+
+} // namespace exif
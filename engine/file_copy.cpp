@@ -0,0 +1,519 @@
+// file_copy.cpp
+#include "file_copy.h"
+#include "io_ring.h"
+#include <string>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <cerrno>
+#endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/vfs.h>
+#include <linux/fs.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static const char* const METHOD_NAMES[COPY_METHOD_COUNT] = {
+    "auto", "reflink", "copy_file_range", "sendfile", "io_uring", "buffered", "platform" };
+
+const char* CopyMethodName(CopyMethod method) {
+    return METHOD_NAMES[(int)method];
+}
+
+bool ParseCopyMethod(const std::string& name, CopyMethod& method) {
+    for (int i = 0; i < COPY_METHOD_COUNT; ++i) {
+        if (name == METHOD_NAMES[i]) {
+            method = (CopyMethod)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static const char* const PLACEMENT_NAMES[PLACEMENT_MODE_COUNT] = { "copy", "move", "hardlink", "symlink" };
+
+const char* PlacementModeName(PlacementMode mode) {
+    return PLACEMENT_NAMES[(int)mode];
+}
+
+bool ParsePlacementMode(const std::string& name, PlacementMode& mode) {
+    for (int i = 0; i < PLACEMENT_MODE_COUNT; ++i) {
+        if (name == PLACEMENT_NAMES[i]) {
+            mode = (PlacementMode)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Errors that mean "not possible here" rather than "failed": the file is
+// copied instead.
+static bool CantLinkHere(const std::error_code& ec) {
+    return ec == std::errc::cross_device_link || ec == std::errc::operation_not_permitted ||
+           ec == std::errc::operation_not_supported || ec == std::errc::function_not_supported ||
+           ec == std::errc::too_many_links || ec == std::errc::permission_denied ||
+           ec == std::errc::not_supported
+#ifdef _WIN32
+           || ec.value() == ERROR_NOT_SAME_DEVICE || ec.value() == ERROR_PRIVILEGE_NOT_HELD
+#endif
+        ;
+}
+
+bool FileCopier::Place(const fs::path& from, const fs::path& to, PlacementMode mode, PlacementMode& used, std::error_code& ec) {
+    return Place(from, nullptr, to, mode, used, ec);
+}
+
+bool FileCopier::Place(SourceFile& from, const fs::path& to, PlacementMode mode, PlacementMode& used, std::error_code& ec) {
+    return Place(from.path(), &from, to, mode, used, ec);
+}
+
+bool FileCopier::Place(const fs::path& from, SourceFile* source, const fs::path& to, PlacementMode mode,
+                       PlacementMode& used, std::error_code& ec) {
+    ec.clear();
+    switch (mode) {
+    case PlacementMode::Move:
+        if (RenameNoReplace(from, to, ec)) {
+            used = PlacementMode::Move;
+            return true;
+        }
+        break;
+    case PlacementMode::Hardlink:
+        fs::create_hard_link(from, to, ec);
+        if (!ec) {
+            used = PlacementMode::Hardlink;
+            return true;
+        }
+        break;
+    case PlacementMode::Symlink:
+        fs::create_symlink(fs::absolute(from), to, ec);
+        if (!ec) {
+            used = PlacementMode::Symlink;
+            return true;
+        }
+        break;
+    case PlacementMode::Copy:
+        break;
+    }
+    if (ec && (ec == std::errc::file_exists || !CantLinkHere(ec))) return false;
+
+    used = PlacementMode::Copy;
+    if (!(source ? Copy(*source, to, ec) : Copy(from, to, ec))) return false;
+    if (mode == PlacementMode::Move) {
+        // Copied across volumes: the source goes only once the copy is complete
+        std::error_code removeError;
+        fs::remove(from, removeError);
+        if (!removeError) used = PlacementMode::Move;
+    }
+    return true;
+}
+
+FileCopier::Stats FileCopier::GetStats() const {
+    Stats stats;
+    for (int i = 0; i < COPY_METHOD_COUNT; ++i) {
+        stats.files[i] = m_files[i];
+        stats.bytes[i] = m_bytes[i];
+    }
+    return stats;
+}
+
+void FileCopier::Count(CopyMethod method, uint64_t bytes) {
+    m_files[(int)method]++;
+    m_bytes[(int)method] += bytes;
+}
+
+#ifdef _WIN32
+
+bool SameVolume(const fs::path& a, const fs::path& b) {
+    wchar_t volumeA[MAX_PATH], volumeB[MAX_PATH];
+    if (!GetVolumePathNameW(a.c_str(), volumeA, MAX_PATH) || !GetVolumePathNameW(b.c_str(), volumeB, MAX_PATH)) return false;
+    return _wcsicmp(volumeA, volumeB) == 0;
+}
+
+bool RenameNoReplace(const fs::path& from, const fs::path& to, std::error_code& ec) {
+    if (MoveFileExW(from.c_str(), to.c_str(), 0)) {
+        ec.clear();
+        return true;
+    }
+    DWORD err = GetLastError();
+    if (err == ERROR_FILE_EXISTS || err == ERROR_ALREADY_EXISTS) ec = std::make_error_code(std::errc::file_exists);
+    else ec.assign((int)err, std::system_category());
+    return false;
+}
+
+bool FileCopier::Copy(const fs::path& from, const fs::path& to, std::error_code& ec) {
+    // CopyFile already hands the work to the I/O manager (and ReFS block cloning)
+    uintmax_t size = fs::file_size(from, ec);
+    if (ec || !fs::copy_file(from, to, ec)) {
+        if (ec.value() == ERROR_FILE_EXISTS) ec = std::make_error_code(std::errc::file_exists);
+        return false;
+    }
+    Count(CopyMethod::Platform, size);
+    return true;
+}
+
+bool FileCopier::Copy(SourceFile& from, const fs::path& to, std::error_code& ec) {
+    return Copy(from.path(), to, ec);
+}
+
+CopyMethod FileCopier::FirstMethod(uint64_t, uint64_t, int) { return CopyMethod::Platform; }
+CopyMethod FileCopier::NextMethod(CopyMethod) const { return CopyMethod::Platform; }
+void FileCopier::Demote(uint64_t, uint64_t, CopyMethod) {}
+
+#else
+
+bool SameVolume(const fs::path& a, const fs::path& b) {
+    struct stat infoA, infoB;
+    return stat(a.c_str(), &infoA) == 0 && stat(b.c_str(), &infoB) == 0 && infoA.st_dev == infoB.st_dev;
+}
+
+// Another worker may take the name between a collision check and the rename,
+// so a plain rename could overwrite its file.
+bool RenameNoReplace(const fs::path& from, const fs::path& to, std::error_code& ec) {
+    ec.clear();
+    int err = 0;
+#ifdef SYS_renameat2
+    if (syscall(SYS_renameat2, AT_FDCWD, from.c_str(), AT_FDCWD, to.c_str(), 1 /* RENAME_NOREPLACE */) == 0) return true;
+    err = errno;
+#endif
+    if (err == 0 || err == EINVAL || err == ENOSYS) {
+        // No renameat2 here: a hard link fails the same way on an existing name
+        if (link(from.c_str(), to.c_str()) == 0) {
+            unlink(from.c_str());
+            return true;
+        }
+        err = errno;
+        if (err == EPERM || err == ENOTSUP) {
+            // No hard links either (FAT and friends)
+            if (fs::exists(to)) {
+                err = EEXIST;
+            } else {
+                fs::rename(from, to, ec);
+                return !ec;
+            }
+        }
+    }
+    ec.assign(err, std::generic_category());
+    return false;
+}
+
+// --- STRATEGIES ---
+
+// Each copies from offset to the end of the input and advances offset. They
+// return 0 or an errno; "unsupported" errnos make the caller try the next.
+static bool IsUnsupported(int err) {
+    return err == EXDEV || err == EOPNOTSUPP || err == ENOTSUP || err == EINVAL || err == ENOSYS ||
+           err == ENOTTY || err == EBADF;
+}
+
+#ifdef __linux__
+
+static int CopyReflink(int in, int out, uint64_t& offset) {
+    if (offset != 0) return EINVAL;
+    if (ioctl(out, FICLONE, in) != 0) return errno;
+    struct stat st;
+    if (fstat(out, &st) != 0) return errno;
+    offset = (uint64_t)st.st_size;
+    return 0;
+}
+
+static int CopyRange(int in, int out, uint64_t& offset) {
+    while (true) {
+        loff_t inOffset = (loff_t)offset, outOffset = (loff_t)offset;
+        ssize_t n = copy_file_range(in, &inOffset, out, &outOffset, 1 << 30, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        if (n == 0) return 0;
+        offset += (uint64_t)n;
+    }
+}
+
+static int CopySendfile(int in, int out, uint64_t& offset) {
+    if (lseek(out, (off_t)offset, SEEK_SET) < 0) return errno;
+    while (true) {
+        off_t inOffset = (off_t)offset;
+        ssize_t n = sendfile(out, in, &inOffset, 1 << 30);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        if (n == 0) return 0;
+        offset += (uint64_t)n;
+    }
+}
+
+// Reads and writes RING_CHUNKS chunks at a time through a per-thread ring:
+// a chunk's write is queued as soon as its read completes, and the next
+// read as soon as the write is done.
+static int CopyRing(int in, int out, uint64_t& offset) {
+    const unsigned RING_CHUNKS = 16;
+    const size_t CHUNK_SIZE = 512 * 1024;
+    struct RingState {
+        IoRing ring;
+        void* buffers = nullptr;
+        bool failed = false;
+        ~RingState() { free(buffers); }
+    };
+    static thread_local RingState state;
+    if (!state.ring.is_open()) {
+        if (state.failed) return ENOSYS;
+        if (!state.ring.Init(RING_CHUNKS) || posix_memalign(&state.buffers, 4096, RING_CHUNKS * CHUNK_SIZE) != 0) {
+            state.failed = true;
+            state.ring.Close();
+            return ENOSYS;
+        }
+    }
+
+    struct stat info;
+    if (fstat(in, &info) != 0) return errno;
+    uint64_t end = (uint64_t)info.st_size;
+
+    struct Chunk {
+        uint64_t offset;
+        unsigned length;
+        unsigned done;
+        bool writing;
+    };
+    Chunk chunks[RING_CHUNKS];
+    unsigned freeList[RING_CHUNKS], freeCount = 0;
+    for (unsigned i = 0; i < RING_CHUNKS; ++i) freeList[freeCount++] = RING_CHUNKS - 1 - i;
+
+    uint64_t next = offset;
+    unsigned inFlight = 0;
+    int err = 0;
+    auto bufferOf = [&](unsigned i) { return (char*)state.buffers + (size_t)i * CHUNK_SIZE; };
+
+    while (true) {
+        while (err == 0 && next < end && freeCount > 0) {
+            unsigned i = freeList[--freeCount];
+            Chunk& c = chunks[i];
+            c.offset = next;
+            c.length = (unsigned)(end - next < CHUNK_SIZE ? end - next : CHUNK_SIZE);
+            c.done = 0;
+            c.writing = false;
+            state.ring.PrepRead(in, bufferOf(i), c.length, c.offset, i);
+            next += c.length;
+            inFlight++;
+        }
+        if (inFlight == 0) break;
+        // Everything queued has to complete before the buffers can go
+        if (!state.ring.Submit(1)) {
+            state.failed = true;
+            state.ring.Close();
+            return err != 0 ? err : EIO;
+        }
+
+        IoRing::Completion completion;
+        while (state.ring.Peek(completion)) {
+            unsigned i = (unsigned)completion.userData;
+            Chunk& c = chunks[i];
+            inFlight--;
+            if (completion.result < 0 || err != 0) {
+                if (err == 0) err = -completion.result;
+                freeList[freeCount++] = i;
+                continue;
+            }
+            if (!c.writing) {
+                if (completion.result == 0) {
+                    err = EIO; // Shrank while being copied
+                    freeList[freeCount++] = i;
+                    continue;
+                }
+                c.done += (unsigned)completion.result;
+                if (c.done < c.length) {
+                    // Short read (FUSE, NFS): ask for the rest of the chunk
+                    state.ring.PrepRead(in, bufferOf(i) + c.done, c.length - c.done, c.offset + c.done, i);
+                    inFlight++;
+                    continue;
+                }
+                c.done = 0;
+                c.writing = true;
+            } else {
+                c.done += (unsigned)completion.result;
+                if (c.done == c.length) {
+                    freeList[freeCount++] = i;
+                    continue;
+                }
+            }
+            state.ring.PrepWrite(out, bufferOf(i) + c.done, c.length - c.done, c.offset + c.done, i);
+            inFlight++;
+        }
+    }
+    if (err != 0) return err;
+    offset = end;
+    return 0;
+}
+
+#endif
+
+// Large, page-aligned buffers keep the number of syscalls down and allow the
+// kernel to skip a copy on some filesystems.
+static int CopyBuffered(int in, int out, uint64_t& offset) {
+    const size_t BUFFER_SIZE = 1 << 20;
+    struct AlignedBuffer {
+        void* data = nullptr;
+        AlignedBuffer() { if (posix_memalign(&data, 4096, BUFFER_SIZE) != 0) data = nullptr; }
+        ~AlignedBuffer() { free(data); }
+    };
+    static thread_local AlignedBuffer buffer;
+    if (!buffer.data) return ENOMEM;
+
+    while (true) {
+        ssize_t n = pread(in, buffer.data, BUFFER_SIZE, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        if (n == 0) return 0;
+        for (ssize_t done = 0; done < n;) {
+            ssize_t w = pwrite(out, (const char*)buffer.data + done, (size_t)(n - done), (off_t)(offset + done));
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return errno;
+            }
+            done += w;
+        }
+        offset += (uint64_t)n;
+    }
+}
+
+static int RunMethod(CopyMethod method, int in, int out, uint64_t& offset) {
+    switch (method) {
+#ifdef __linux__
+    case CopyMethod::Reflink: return CopyReflink(in, out, offset);
+    case CopyMethod::CopyFileRange: return CopyRange(in, out, offset);
+    case CopyMethod::Sendfile: return CopySendfile(in, out, offset);
+    case CopyMethod::IoUring: return CopyRing(in, out, offset);
+#endif
+    default: return CopyBuffered(in, out, offset);
+    }
+}
+
+// --- COPIER ---
+
+CopyMethod FileCopier::NextMethod(CopyMethod method) const {
+    switch (method) {
+    case CopyMethod::Reflink: return CopyMethod::CopyFileRange;
+    case CopyMethod::CopyFileRange: return m_useRing ? CopyMethod::IoUring : CopyMethod::Sendfile;
+    default: return CopyMethod::Buffered;
+    }
+}
+
+// Reflinks only exist on a few filesystems; elsewhere the ioctl would fail on
+// every file before falling through.
+CopyMethod FileCopier::FirstMethod(uint64_t fromDevice, uint64_t toDevice, int toFd) {
+    if (m_method != CopyMethod::Auto) return m_method;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_best.find({ fromDevice, toDevice });
+    if (it != m_best.end()) return it->second;
+
+    CopyMethod method = CopyMethod::Buffered;
+#ifdef __linux__
+    method = CopyMethod::CopyFileRange;
+    struct statfs fsInfo;
+    if (fromDevice == toDevice && fstatfs(toFd, &fsInfo) == 0) {
+        const unsigned long BTRFS_MAGIC = 0x9123683E, XFS_MAGIC = 0x58465342, BCACHEFS_MAGIC = 0xCA451A4E;
+        unsigned long type = (unsigned long)fsInfo.f_type;
+        if (type == BTRFS_MAGIC || type == XFS_MAGIC || type == BCACHEFS_MAGIC) method = CopyMethod::Reflink;
+    }
+    if (m_useRing && fstatfs(toFd, &fsInfo) == 0) {
+        // Network targets: copy_file_range only helps with server-side copy
+        // support, and latency is what the ring hides
+        const unsigned long NFS_MAGIC = 0x6969, SMB2_MAGIC = 0xFE534D42, CIFS_MAGIC = 0xFF534D42, FUSE_MAGIC = 0x65735546;
+        unsigned long type = (unsigned long)fsInfo.f_type;
+        if (type == NFS_MAGIC || type == SMB2_MAGIC || type == CIFS_MAGIC || type == FUSE_MAGIC) method = CopyMethod::IoUring;
+    }
+#else
+    (void)toFd;
+#endif
+    m_best[{ fromDevice, toDevice }] = method;
+    return method;
+}
+
+void FileCopier::Demote(uint64_t fromDevice, uint64_t toDevice, CopyMethod failed) {
+    if (m_method != CopyMethod::Auto) return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CopyMethod& best = m_best[{ fromDevice, toDevice }];
+    if (best == failed) best = NextMethod(failed);
+}
+
+// in is read from offset 0 whatever its position; mode and device are its stat's
+bool FileCopier::CopyDescriptor(int in, unsigned mode, uint64_t fromDevice, const fs::path& to, std::error_code& ec) {
+    int out = open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode & 0777);
+    struct stat outInfo;
+    if (out < 0 || fstat(out, &outInfo) != 0) {
+        ec.assign(errno, std::generic_category());
+        if (out >= 0) {
+            close(out);
+            unlink(to.c_str());
+        }
+        return false;
+    }
+
+    uint64_t toDevice = (uint64_t)outInfo.st_dev;
+    CopyMethod method = FirstMethod(fromDevice, toDevice, out);
+    uint64_t offset = 0;
+    int err;
+    while ((err = RunMethod(method, in, out, offset)) != 0) {
+        if (!IsUnsupported(err) || method == CopyMethod::Buffered) break;
+        Demote(fromDevice, toDevice, method);
+        method = NextMethod(method);
+    }
+
+    if (err == 0 && fchmod(out, mode & 07777) != 0) err = errno;
+    if (close(out) != 0 && err == 0) err = errno;
+
+    if (err != 0) {
+        unlink(to.c_str());
+        ec.assign(err, std::generic_category());
+        return false;
+    }
+    Count(method, offset);
+    return true;
+}
+
+bool FileCopier::Copy(const fs::path& from, const fs::path& to, std::error_code& ec) {
+    ec.clear();
+    int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        ec.assign(errno, std::generic_category());
+        return false;
+    }
+    struct stat inInfo;
+    if (fstat(in, &inInfo) != 0) {
+        ec.assign(errno, std::generic_category());
+        close(in);
+        return false;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    bool ok = CopyDescriptor(in, (unsigned)inInfo.st_mode, (uint64_t)inInfo.st_dev, to, ec);
+#ifdef POSIX_FADV_DONTNEED
+    // Same as SourceFile::DropCache
+    if (ok) posix_fadvise(in, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    close(in);
+    return ok;
+}
+
+// The caller drops the source's pages once it is done with them (DropCache)
+bool FileCopier::Copy(SourceFile& from, const fs::path& to, std::error_code& ec) {
+    ec.clear();
+    if (!from.is_open()) return Copy(from.path(), to, ec);
+    from.AdviseSequential();
+    return CopyDescriptor(from.fd(), from.mode(), from.device(), to, ec);
+}
+
+#endif
@@ -0,0 +1,92 @@
+// file_copy.h
+// File copy that lets the kernel do the work where it can. On Linux the
+// strategies are tried from cheapest to most general: a reflink (FICLONE,
+// shares extents on btrfs/XFS), copy_file_range, sendfile and finally a
+// buffered copy with large aligned buffers and fadvise hints. The first one
+// that works is remembered per pair of source and target filesystems. With
+// the io_uring backend, chunked reads and writes with several chunks in
+// flight replace sendfile and the buffered copy, and are tried first on
+// network filesystems where the kernel can't offload the copy.
+// Windows uses CopyFile, other systems the buffered copy.
+#pragma once
+
+#include "source_file.h"
+#include <filesystem>
+#include <system_error>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <string>
+#include <utility>
+#include <cstdint>
+
+enum class CopyMethod { Auto, Reflink, CopyFileRange, Sendfile, IoUring, Buffered, Platform };
+const int COPY_METHOD_COUNT = 7;
+
+const char* CopyMethodName(CopyMethod method);
+bool ParseCopyMethod(const std::string& name, CopyMethod& method);
+
+// How a file gets into the target. Everything but Copy leaves no second copy
+// of the data; where that isn't possible (another volume, no link support)
+// the file is copied instead, and a move deletes the source afterwards.
+enum class PlacementMode { Copy, Move, Hardlink, Symlink };
+const int PLACEMENT_MODE_COUNT = 4;
+
+const char* PlacementModeName(PlacementMode mode);
+bool ParsePlacementMode(const std::string& name, PlacementMode& mode);
+
+// Whether both paths are on the same volume (device), i.e. can be renamed or
+// hard-linked into each other.
+bool SameVolume(const std::filesystem::path& a, const std::filesystem::path& b);
+
+// Atomic rename that never replaces an existing file: returns false with
+// ec == std::errc::file_exists then.
+bool RenameNoReplace(const std::filesystem::path& from, const std::filesystem::path& to, std::error_code& ec);
+
+class FileCopier {
+public:
+    struct Stats {
+        uint64_t files[COPY_METHOD_COUNT] = {};
+        uint64_t bytes[COPY_METHOD_COUNT] = {};
+    };
+
+    // Auto picks per filesystem; anything else is used for every copy (for
+    // benchmarking), falling back only where the call itself is unsupported.
+    explicit FileCopier(CopyMethod method = CopyMethod::Auto, bool useRing = false)
+        : m_method(method), m_useRing(useRing) {}
+
+    // Copies the contents and permissions of from to a new file to, which
+    // must not exist yet. A partial target is removed on failure.
+    bool Copy(const std::filesystem::path& from, const std::filesystem::path& to, std::error_code& ec);
+    // Same from a file the sorter has open: its descriptor and stat are
+    // reused, with sequential readahead from here on (Windows copies by path)
+    bool Copy(SourceFile& from, const std::filesystem::path& to, std::error_code& ec);
+
+    // Places from at to (which must not exist) the way mode asks for, or by
+    // copying where that isn't possible. used tells what was done. Returns
+    // false with ec == std::errc::file_exists if to was taken meanwhile.
+    bool Place(const std::filesystem::path& from, const std::filesystem::path& to, PlacementMode mode,
+               PlacementMode& used, std::error_code& ec);
+    bool Place(SourceFile& from, const std::filesystem::path& to, PlacementMode mode,
+               PlacementMode& used, std::error_code& ec);
+
+    Stats GetStats() const;
+
+private:
+    bool Place(const std::filesystem::path& from, SourceFile* source, const std::filesystem::path& to,
+               PlacementMode mode, PlacementMode& used, std::error_code& ec);
+#ifndef _WIN32
+    bool CopyDescriptor(int in, unsigned mode, uint64_t fromDevice, const std::filesystem::path& to, std::error_code& ec);
+#endif
+    CopyMethod FirstMethod(uint64_t fromDevice, uint64_t toDevice, int toDir);
+    CopyMethod NextMethod(CopyMethod failed) const;
+    void Demote(uint64_t fromDevice, uint64_t toDevice, CopyMethod failed);
+    void Count(CopyMethod method, uint64_t bytes);
+
+    CopyMethod m_method;
+    bool m_useRing;
+    std::mutex m_mutex;
+    std::map<std::pair<uint64_t, uint64_t>, CopyMethod> m_best;  // (source dev, target dev)
+    std::atomic<uint64_t> m_files[COPY_METHOD_COUNT] = {};
+    std::atomic<uint64_t> m_bytes[COPY_METHOD_COUNT] = {};
+};
@@ -0,0 +1,169 @@
+// file_metadata.cpp
+#include "file_metadata.h"
+#include "media_format.h"
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <time.h>
+#endif
+
+bool GetFileModifiedDate(const std::filesystem::path& path, MediaDate& date) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) return false;
+    SYSTEMTIME st;
+    if (!FileTimeToSystemTime(&data.ftLastWriteTime, &st)) return false;
+    date.year = st.wYear;
+    date.month = st.wMonth;
+    date.day = st.wDay;
+    date.hour = st.wHour;
+    date.minute = st.wMinute;
+    date.second = st.wSecond;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    struct tm tm;
+    if (!gmtime_r(&st.st_mtime, &tm)) return false;
+    date.year = tm.tm_year + 1900;
+    date.month = tm.tm_mon + 1;
+    date.day = tm.tm_mday;
+    date.hour = tm.tm_hour;
+    date.minute = tm.tm_min;
+    date.second = tm.tm_sec;
+#endif
+    return true;
+}
+
+bool DateFromModifiedTime(int64_t modifiedTime, MediaDate& date) {
+#ifdef _WIN32
+    FILETIME ft;
+    ft.dwLowDateTime = (DWORD)modifiedTime;
+    ft.dwHighDateTime = (DWORD)((uint64_t)modifiedTime >> 32);
+    SYSTEMTIME st;
+    if (!FileTimeToSystemTime(&ft, &st)) return false;
+    date.year = st.wYear;
+    date.month = st.wMonth;
+    date.day = st.wDay;
+    date.hour = st.wHour;
+    date.minute = st.wMinute;
+    date.second = st.wSecond;
+#else
+    int64_t seconds = modifiedTime / 1000000000;
+    if (modifiedTime < 0 && seconds * 1000000000 != modifiedTime) seconds--;
+    time_t t = (time_t)seconds;
+    struct tm tm;
+    if (!gmtime_r(&t, &tm)) return false;
+    date.year = tm.tm_year + 1900;
+    date.month = tm.tm_mon + 1;
+    date.day = tm.tm_mday;
+    date.hour = tm.tm_hour;
+    date.minute = tm.tm_min;
+    date.second = tm.tm_sec;
+#endif
+    return true;
+}
+
+bool GetFileIdentity(const std::filesystem::path& path, uint64_t& size, int64_t& modifiedTime, uint64_t* device) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) return false;
+    size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    modifiedTime = (int64_t)(((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime);
+    if (device) *device = 0;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    size = (uint64_t)st.st_size;
+    if (device) *device = (uint64_t)st.st_dev;
+#ifdef __APPLE__
+    modifiedTime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    modifiedTime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+    return true;
+}
+
+static void ApplyExif(const ExifInfo& exifInfo, FileMetadata& meta) {
+    if (exifInfo.hasDate) {
+        meta.date.year = exifInfo.year;
+        meta.date.month = exifInfo.month;
+        meta.date.day = exifInfo.day;
+        meta.date.hour = exifInfo.hour;
+        meta.date.minute = exifInfo.minute;
+        meta.date.second = exifInfo.second;
+        meta.hasDate = true;
+    }
+    if (exifInfo.hasGps) {
+        meta.hasGps = true;
+        meta.latitude = exifInfo.latitude;
+        meta.longitude = exifInfo.longitude;
+    }
+}
+
+FileMetadata GetFileMetadata(const std::filesystem::path& path, MediaFormat* format, uint64_t* bytesRead) {
+    FileMetadata meta;
+    if (format) *format = MediaFormat::Unknown;
+    if (bytesRead) *bytesRead = 0;
+
+    try {
+        // Default to File Modification Time
+        GetFileModifiedDate(path, meta.date);
+
+        // EXIF (date taken, GPS) as the format has it, from one small read
+        // plus whatever that format needs beyond it
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return meta;
+        MediaHead head(in);
+        ExifInfo exifInfo;
+        MediaFormat found = ReadMediaMetadata(head, exifInfo);
+        ApplyExif(exifInfo, meta);
+        if (format) *format = found;
+        if (bytesRead) *bytesRead = head.BytesRead();
+    } catch (...) {
+    }
+
+    return meta;
+}
+
+FileMetadata GetFileMetadata(SourceFile& file, MediaFormat* format, uint64_t* bytesRead) {
+    FileMetadata meta;
+    if (format) *format = MediaFormat::Unknown;
+    if (bytesRead) *bytesRead = 0;
+
+    try {
+        DateFromModifiedTime(file.modified_time(), meta.date);
+        SourceFileBuf buffer(file);
+        std::istream in(&buffer);
+        MediaHead head(in);
+        ExifInfo exifInfo;
+        MediaFormat found = ReadMediaMetadata(head, exifInfo);
+        ApplyExif(exifInfo, meta);
+        if (format) *format = found;
+        if (bytesRead) *bytesRead = head.BytesRead();
+    } catch (...) {
+    }
+
+    return meta;
+}
+
+FileMetadata GetBufferMetadata(const uint8_t* header, size_t size, const MediaDate& defaultDate, MediaFormat* format) {
+    FileMetadata meta;
+    meta.date = defaultDate;
+    MediaHead head(header, size);
+    ExifInfo exifInfo;
+    MediaFormat found = ReadMediaMetadata(head, exifInfo);
+    ApplyExif(exifInfo, meta);
+    if (format) *format = found;
+    return meta;
+}
+
+bool NeedsWholeFile(const uint8_t* header, size_t size, const FileMetadata& meta) {
+    if (meta.hasDate) return false;
+    MediaFormat format = SniffFormat(header, size);
+    return format == MediaFormat::Tiff || format == MediaFormat::Heif || format == MediaFormat::Bmff;
+}
@@ -0,0 +1,61 @@
+// file_metadata.h
+#pragma once
+
+#include "media_format.h"
+#include "source_file.h"
+#include <string>
+#include <filesystem>
+#include <cstdint>
+
+struct MediaDate {
+    int year = 0;
+    int month = 0;
+    int day = 0;
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+};
+
+struct FileMetadata {
+    MediaDate date;
+    bool hasDate = false;           // Date taken from EXIF (otherwise file modification time)
+    bool hasGps = false;
+    double latitude = 0.0;
+    double longitude = 0.0;
+    std::string location = "";     // UTF-8, filled in by the caller from the GPS position
+    uint64_t size = 0;              // Source identity (GetFileIdentity), filled in by the caller
+    int64_t modifiedTime = 0;
+    uint64_t device = 0;            // Its filesystem (st_dev), also filled in by the caller
+};
+
+// File modification time (UTC)
+bool GetFileModifiedDate(const std::filesystem::path& path, MediaDate& date);
+// Same from a modification time GetFileIdentity returned, without a stat
+bool DateFromModifiedTime(int64_t modifiedTime, MediaDate& date);
+
+// Size and modification time with one stat. The time is in platform ticks
+// (FILETIME on Windows, nanoseconds since the epoch elsewhere), only meant
+// for comparing against an earlier value on the same machine. device, if
+// given, receives the filesystem's device number (st_dev; 0 on Windows).
+bool GetFileIdentity(const std::filesystem::path& path, uint64_t& size, int64_t& modifiedTime,
+                     uint64_t* device = nullptr);
+
+// Date and location from the file's own metadata (see media_format.h), or
+// else its modification time. format and bytesRead, if given, receive what
+// the file was taken for and how much of it was read.
+FileMetadata GetFileMetadata(const std::filesystem::path& path, MediaFormat* format = nullptr,
+                             uint64_t* bytesRead = nullptr);
+// Same from an open source file, with its stat for the modification time
+FileMetadata GetFileMetadata(SourceFile& file, MediaFormat* format = nullptr, uint64_t* bytesRead = nullptr);
+
+// Same for content that isn't a file on disk (an archive member): header is
+// its first bytes, up to exif::HEADER_WINDOW, and defaultDate stands in for
+// the modification time. Videos, HEIC and RAW files are only understood if
+// their metadata is within the header (see NeedsWholeFile).
+FileMetadata GetBufferMetadata(const uint8_t* header, size_t size, const MediaDate& defaultDate,
+                               MediaFormat* format = nullptr);
+
+// True if GetBufferMetadata found nothing in header that GetFileMetadata
+// could find further into the file (a video with moov after its data, a
+// RAW file with its EXIF IFD past the header).
+bool NeedsWholeFile(const uint8_t* header, size_t size, const FileMetadata& meta);
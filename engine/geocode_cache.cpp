@@ -0,0 +1,61 @@
+// geocode_cache.cpp
+#include "geocode_cache.h"
+#include <cmath>
+#include <cstring>
+
+static const char CACHE_MAGIC[4] = { 'M', 'S', 'G', 'C' };
+static const uint32_t CACHE_VERSION = 1;
+
+uint64_t GeocodeCache::MakeKey(double lat, double lon) {
+    int32_t latE3 = (int32_t)std::lround(lat * 1000.0);
+    int32_t lonE3 = (int32_t)std::lround(lon * 1000.0);
+    return ((uint64_t)(uint32_t)latE3 << 32) | (uint32_t)lonE3;
+}
+
+bool GeocodeCache::Open(const std::filesystem::path& file) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_log.Open(file, CACHE_MAGIC, CACHE_VERSION, [this](const uint8_t* data, size_t size) {
+        if (size < 8) return;
+        uint64_t key = ((uint64_t)GetLE32(data) << 32) | GetLE32(data + 4);
+        m_entries[key].assign((const char*)data + 8, size - 8);
+    });
+}
+
+bool GeocodeCache::Lookup(uint64_t key, std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        m_misses++;
+        return false;
+    }
+    m_hits++;
+    name = it->second;
+    return true;
+}
+
+bool GeocodeCache::Peek(uint64_t key, std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) return false;
+    name = it->second;
+    return true;
+}
+
+void GeocodeCache::Store(uint64_t key, const std::string& name, bool persist) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries[key] = name;
+    }
+    if (persist && m_log.is_open()) {
+        std::string record(8 + name.size(), '\0');
+        PutLE32((uint8_t*)&record[0], (uint32_t)(key >> 32));
+        PutLE32((uint8_t*)&record[4], (uint32_t)key);
+        memcpy(&record[8], name.data(), name.size());
+        m_log.Append(record.data(), record.size());
+    }
+}
+
+size_t GeocodeCache::Size() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
@@ -0,0 +1,44 @@
+// geocode_cache.h
+// Reverse-geocoding cache shared across runs. Keys are lat/lon quantized to
+// 1/1000 degree (the precision lookups have always been made at) and packed
+// into one integer; values are UTF-8 place names, "" meaning "looked up,
+// nothing found". Persisted through a RecordLog with 8 + name bytes per entry.
+// Rather than a memory-mapped key/value file, the log is replayed into a hash
+// map at open; lookups never touch the file. An entry survives the process
+// once stored (fflush), but not necessarily a power loss (no fsync): a torn
+// tail is dropped on the next open and those places are looked up again.
+#pragma once
+
+#include "record_log.h"
+#include <filesystem>
+#include <unordered_map>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+class GeocodeCache {
+public:
+    static uint64_t MakeKey(double lat, double lon);
+
+    // Loads an existing cache file and keeps it open for appends. Without a
+    // successful Open the cache still works, in memory only.
+    bool Open(const std::filesystem::path& file);
+
+    // Lookup counts a hit or miss; Peek doesn't (for re-checks after a wait)
+    bool Lookup(uint64_t key, std::string& name);
+    bool Peek(uint64_t key, std::string& name);
+    // persist = false keeps the entry for this run only (e.g. a failed request)
+    void Store(uint64_t key, const std::string& name, bool persist = true);
+
+    uint64_t Hits() const { return m_hits; }
+    uint64_t Misses() const { return m_misses; }
+    size_t Size();
+
+private:
+    std::unordered_map<uint64_t, std::string> m_entries;
+    std::mutex m_mutex;
+    RecordLog m_log;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+};
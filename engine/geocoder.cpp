@@ -0,0 +1,278 @@
+// geocoder.cpp
+#include "geocoder.h"
+#include "http_client.h"
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+
+static std::string ExtractJsonString(const std::string& response, const std::string& key) {
+    std::string search = "\"" + key + "\":\"";
+    size_t pos = response.find(search);
+    if (pos != std::string::npos) {
+        size_t end = response.find("\"", pos + search.length());
+        if (end != std::string::npos) {
+            return response.substr(pos + search.length(), end - (pos + search.length()));
+        }
+    }
+    return "";
+}
+
+Geocoder::~Geocoder() {
+    StopResolver();
+}
+
+bool Geocoder::Configure(GeocodeMode mode, const std::filesystem::path& placesFile, std::string& error) {
+    m_mode = mode;
+    m_offline.reset();
+    if (mode == GeocodeMode::Offline) {
+        std::unique_ptr<OfflineGeocoder> offline(new OfflineGeocoder());
+        if (!offline->Load(placesFile, error)) return false;
+        m_offline = std::move(offline);
+    }
+    return true;
+}
+
+bool Geocoder::SetEndpoint(const std::string& url) {
+    if (url.empty()) {
+        m_host = "nominatim.openstreetmap.org";
+        m_port = 0;
+        m_secure = true;
+        m_pathPrefix.clear();
+        return true;
+    }
+
+    size_t pos;
+    bool secure;
+    if (url.compare(0, 8, "https://") == 0) { secure = true; pos = 8; }
+    else if (url.compare(0, 7, "http://") == 0) { secure = false; pos = 7; }
+    else return false;
+
+    size_t slash = url.find('/', pos);
+    std::string hostPort = url.substr(pos, slash == std::string::npos ? std::string::npos : slash - pos);
+    std::string prefix = slash == std::string::npos ? "" : url.substr(slash);
+    while (!prefix.empty() && prefix.back() == '/') prefix.pop_back();
+
+    int port = 0;
+    size_t colon = hostPort.rfind(':');
+    if (colon != std::string::npos && hostPort.find(']', colon) == std::string::npos) {
+        port = std::atoi(hostPort.c_str() + colon + 1);
+        if (port <= 0 || port > 65535) return false;
+        hostPort.resize(colon);
+    }
+    if (hostPort.empty()) return false;
+
+    m_host = hostPort;
+    m_port = port;
+    m_secure = secure;
+    m_pathPrefix = prefix;
+    return true;
+}
+
+bool Geocoder::OpenCache(const std::filesystem::path& cacheFile) {
+    return m_cache.Open(cacheFile);
+}
+
+// Resolves a cache miss over the network and caches the result. Requests are
+// serialized and spaced 1.1 s apart (Nominatim Usage Policy); another thread
+// may have resolved the same spot while this one waited for its turn.
+// False if the request failed.
+bool Geocoder::Resolve(uint64_t key, double lat, double lon, std::string& name) {
+    std::lock_guard<std::mutex> networkLock(m_networkMutex);
+    if (m_cache.Peek(key, name)) return true;
+
+    bool resolved = Fetch(lat, lon, name);
+    // Failed requests are only remembered for this run
+    m_cache.Store(key, name, resolved);
+    return resolved;
+}
+
+// Caller holds m_networkMutex. False if the request failed.
+bool Geocoder::Fetch(double lat, double lon, std::string& name) {
+    name.clear();
+    if (!HttpAvailable()) return false;
+
+    auto waitStart = std::chrono::steady_clock::now();
+    std::this_thread::sleep_until(m_nextRequest);
+    if (m_profiler) m_profiler->Record(Probe::GeocodeWait, waitStart, 0);
+
+    std::ostringstream path;
+    path << m_pathPrefix << std::fixed << std::setprecision(6) << "/reverse?format=json&lat=" << lat << "&lon=" << lon << "&zoom=10";
+    std::string response;
+    auto requestStart = std::chrono::steady_clock::now();
+    bool ok = HttpGet(m_host, m_port, path.str(), m_secure, response);
+    if (m_profiler) m_profiler->Record(Probe::GeocodeHttp, requestStart, response.size());
+    m_networkRequests++;
+    m_nextRequest = std::chrono::steady_clock::now() + std::chrono::milliseconds(1100);
+    if (!ok) return false;
+
+    name = ExtractJsonString(response, "city");
+    if (name.empty()) name = ExtractJsonString(response, "town");
+    if (name.empty()) name = ExtractJsonString(response, "village");
+    if (name.empty()) name = ExtractJsonString(response, "municipality");
+    return true;
+}
+
+std::string Geocoder::ReverseGeocode(double lat, double lon) {
+    std::string result;
+    if (Lookup(lat, lon, result)) return result;
+    bool resolved = Resolve(KeyFor(lat, lon), lat, lon, result);
+
+    std::lock_guard<std::mutex> lock(m_cellMutex);
+    m_cells.emplace(CellFor(lat, lon), CellResult{ result, resolved });
+    return result;
+}
+
+bool Geocoder::Lookup(double lat, double lon, std::string& name) {
+    if (m_mode == GeocodeMode::Disabled) { name.clear(); return true; }
+    if (m_mode == GeocodeMode::Offline) { name = m_offline->Nearest(lat, lon); return true; }
+
+    uint64_t key = KeyFor(lat, lon);
+    if (m_cache.Lookup(key, name)) return true;
+
+    // Another location in the same cell was already resolved this run
+    bool resolved;
+    {
+        std::lock_guard<std::mutex> lock(m_cellMutex);
+        auto it = m_cells.find(CellFor(lat, lon));
+        if (it == m_cells.end()) return false;
+        name = it->second.name;
+        resolved = it->second.resolved;
+    }
+    m_cache.Store(key, name, resolved);
+    m_lookupsSaved++;
+    return true;
+}
+
+bool Geocoder::Peek(double lat, double lon, std::string& name) {
+    if (m_mode != GeocodeMode::Online) return Lookup(lat, lon, name);
+    return m_cache.Peek(KeyFor(lat, lon), name);
+}
+
+// --- BACKGROUND RESOLVER ---
+
+// Geohash of CELL_BITS bits (alternating lon/lat bisections), used as the
+// cluster id: with 25 bits a cell is about 0.044 x 0.044 deg, ~5 km at the
+// equator, well inside the city-level answers asked for (zoom=10).
+uint64_t Geocoder::CellFor(double lat, double lon) {
+    const int CELL_BITS = 25;
+    double latLo = -90.0, latHi = 90.0, lonLo = -180.0, lonHi = 180.0;
+    uint64_t cell = 0;
+    for (int bit = 0; bit < CELL_BITS; ++bit) {
+        cell <<= 1;
+        if (bit % 2 == 0) {
+            double mid = (lonLo + lonHi) / 2;
+            if (lon >= mid) { cell |= 1; lonLo = mid; } else lonHi = mid;
+        } else {
+            double mid = (latLo + latHi) / 2;
+            if (lat >= mid) { cell |= 1; latLo = mid; } else latHi = mid;
+        }
+    }
+    return cell;
+}
+
+void Geocoder::StartResolver(const ResolvedCallback& onResolved) {
+    StopResolver();
+    m_onResolved = onResolved;
+    m_resolverStop = false;
+    m_resolver = std::thread(&Geocoder::ResolverLoop, this);
+}
+
+// Requests are grouped by cell. While the resolver waits out the rate limit,
+// a whole track's worth of locations piles up in a few cells, and each cell
+// costs one request.
+void Geocoder::Request(double lat, double lon) {
+    uint64_t key = KeyFor(lat, lon);
+    uint64_t cell = CellFor(lat, lon);
+    {
+        std::lock_guard<std::mutex> lock(m_resolverMutex);
+        if (!m_requested.insert(key).second) return;
+        std::vector<PendingLocation>& members = m_pending[cell];
+        if (members.empty()) m_pendingCells.push_back(cell);
+        members.push_back({ key, lat, lon });
+    }
+    m_resolverCond.notify_one();
+}
+
+void Geocoder::StopResolver() {
+    if (!m_resolver.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_resolverMutex);
+        m_resolverStop = true;
+        m_pendingCells.clear();
+        m_pending.clear();
+        m_requested.clear();
+    }
+    m_resolverCond.notify_all();
+    m_resolver.join();
+}
+
+void Geocoder::ResolverLoop() {
+    if (m_profiler) m_profiler->NameThread("geocoder");
+    while (true) {
+        uint64_t cell;
+        std::vector<PendingLocation> members;
+        {
+            std::unique_lock<std::mutex> lock(m_resolverMutex);
+            m_resolverCond.wait(lock, [this]() { return m_resolverStop || !m_pendingCells.empty(); });
+            if (m_resolverStop) break;
+            cell = m_pendingCells.front();
+            m_pendingCells.pop_front();
+            auto it = m_pending.find(cell);
+            members.swap(it->second);
+            m_pending.erase(it);
+        }
+
+        CellResult result;
+        bool known;
+        {
+            std::lock_guard<std::mutex> lock(m_cellMutex);
+            auto it = m_cells.find(cell);
+            known = it != m_cells.end();
+            if (known) result = it->second;
+        }
+
+        // Resolve the member closest to the cell's centroid on behalf of all
+        size_t representative = members.size();
+        if (!known) {
+            double latSum = 0.0, lonSum = 0.0;
+            for (const auto& m : members) {
+                latSum += m.lat;
+                lonSum += m.lon;
+            }
+            double latMean = latSum / members.size(), lonMean = lonSum / members.size();
+            double bestDist = 0.0;
+            for (size_t i = 0; i < members.size(); ++i) {
+                double dLat = members[i].lat - latMean, dLon = members[i].lon - lonMean;
+                double dist = dLat * dLat + dLon * dLon;
+                if (i == 0 || dist < bestDist) {
+                    bestDist = dist;
+                    representative = i;
+                }
+            }
+            const PendingLocation& rep = members[representative];
+            result.resolved = Resolve(rep.key, rep.lat, rep.lon, result.name);
+
+            std::lock_guard<std::mutex> lock(m_cellMutex);
+            m_cells.emplace(cell, result);
+        }
+
+        for (size_t i = 0; i < members.size(); ++i) {
+            if (i != representative) {
+                m_cache.Store(members[i].key, result.name, result.resolved);
+                m_lookupsSaved++;
+            }
+        }
+        // The cache is updated first, so a caller that checks it after a
+        // miss either sees the result or has already been queued for it
+        for (const auto& m : members) {
+            m_onResolved(m.key, result.name);
+        }
+
+        std::lock_guard<std::mutex> lock(m_resolverMutex);
+        for (const auto& m : members) {
+            m_requested.erase(m.key);
+        }
+    }
+}
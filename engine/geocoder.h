@@ -0,0 +1,126 @@
+// geocoder.h
+#pragma once
+
+#include "offline_geocoder.h"
+#include "geocode_cache.h"
+#include "run_profile.h"
+#include <string>
+#include <mutex>
+#include <memory>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <unordered_set>
+#include <unordered_map>
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+enum class GeocodeMode {
+    Online,     // Nominatim over HTTP, rate limited
+    Offline,    // Nearest place from a local places file
+    Disabled
+};
+
+// Reverse geocoding (Lat,Lon -> City Name). Online lookups go through a
+// GeocodeCache, optionally persisted across runs. Names are UTF-8.
+//
+// Online misses can be resolved either inline (ReverseGeocode, blocks for the
+// request and the rate limit) or by a background resolver: Lookup answers
+// from the cache only, Request queues the coordinates, and the resolver
+// reports each distinct location once through the callback given to
+// StartResolver.
+//
+// Within a run, locations are clustered into ~5 km geohash cells and one
+// request per cell answers for every location in it.
+class Geocoder {
+public:
+    using ResolvedCallback = std::function<void(uint64_t key, const std::string& name)>;
+
+    ~Geocoder();
+
+    // Call before the first lookup. Offline mode loads placesFile and returns
+    // false (with a message in error) if it can't be used.
+    bool Configure(GeocodeMode mode, const std::filesystem::path& placesFile, std::string& error);
+
+    // Server for online mode, e.g. "http://localhost:8080" for a self-hosted
+    // Nominatim. Empty restores the public instance. False if unparsable.
+    bool SetEndpoint(const std::string& url);
+
+    // Persists online lookups in cacheFile. Returns false if it can't be
+    // opened, in which case the cache stays in memory for this run.
+    bool OpenCache(const std::filesystem::path& cacheFile);
+
+    // Coordinates are quantized to 0.001 deg (~100 m) to avoid hammering the API
+    static uint64_t KeyFor(double lat, double lon) { return GeocodeCache::MakeKey(lat, lon); }
+    // The ~5 km cluster a location belongs to: one request per cell and run
+    static uint64_t CellFor(double lat, double lon);
+
+    // Blocking lookup
+    std::string ReverseGeocode(double lat, double lon);
+
+    // Non-blocking: false if an online lookup would need the network
+    bool Lookup(double lat, double lon, std::string& name);
+    // Same without counting towards cache hits (for re-checks)
+    bool Peek(double lat, double lon, std::string& name);
+
+    // Times the rate limit waits and requests into profiler (may be null)
+    void SetProfiler(RunProfiler* profiler) { m_profiler = profiler; }
+
+    void StartResolver(const ResolvedCallback& onResolved);
+    // Queues a location for the resolver; already queued locations are ignored
+    void Request(double lat, double lon);
+    // Drops anything still queued and joins the resolver
+    void StopResolver();
+
+    uint64_t CacheHits() const { return m_cache.Hits(); }
+    uint64_t CacheMisses() const { return m_cache.Misses(); }
+    uint64_t NetworkRequests() const { return m_networkRequests; }
+    // Distinct locations answered by another location in their cell
+    uint64_t LookupsSaved() const { return m_lookupsSaved; }
+
+private:
+    struct PendingLocation {
+        uint64_t key;
+        double lat;
+        double lon;
+    };
+
+    struct CellResult {
+        std::string name;
+        bool resolved = false;
+    };
+
+    bool Resolve(uint64_t key, double lat, double lon, std::string& name);
+    bool Fetch(double lat, double lon, std::string& name);
+    void ResolverLoop();
+
+    GeocodeMode m_mode = GeocodeMode::Online;
+    std::unique_ptr<OfflineGeocoder> m_offline;
+
+    std::string m_host = "nominatim.openstreetmap.org";
+    int m_port = 0;
+    bool m_secure = true;
+    std::string m_pathPrefix;
+
+    GeocodeCache m_cache;
+    std::mutex m_networkMutex; // Ensure 1 search at a time
+    std::chrono::steady_clock::time_point m_nextRequest;
+    std::atomic<uint64_t> m_networkRequests{0};
+    std::atomic<uint64_t> m_lookupsSaved{0};
+    RunProfiler* m_profiler = nullptr;
+
+    std::mutex m_cellMutex;
+    std::unordered_map<uint64_t, CellResult> m_cells;   // Resolved this run
+
+    std::thread m_resolver;
+    ResolvedCallback m_onResolved;
+    std::mutex m_resolverMutex;
+    std::condition_variable m_resolverCond;
+    std::deque<uint64_t> m_pendingCells;        // Arrival order
+    std::unordered_map<uint64_t, std::vector<PendingLocation>> m_pending;   // By cell
+    std::unordered_set<uint64_t> m_requested;   // Queued or being resolved
+    bool m_resolverStop = false;
+};
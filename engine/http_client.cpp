@@ -0,0 +1,103 @@
+// http_client.cpp
+#include "http_client.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winhttp.h>
+#include <vector>
+#pragma comment(lib, "winhttp.lib")
+#elif defined(MEDIA_SORTER_HAVE_CURL)
+#include <curl/curl.h>
+#endif
+
+#ifdef _WIN32
+
+static std::wstring Widen(const std::string& s) {
+    int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, NULL, 0);
+    if (len <= 0) return L"";
+    std::vector<wchar_t> buf(len);
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, &buf[0], len);
+    return std::wstring(&buf[0]);
+}
+
+bool HttpGet(const std::string& host, int port, const std::string& path, bool secure, std::string& body) {
+    bool ok = false;
+    HINTERNET hSession = WinHttpOpen(L"MediaSorter/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+    if (hSession) {
+        INTERNET_PORT connectPort = port > 0 ? (INTERNET_PORT)port : (secure ? INTERNET_DEFAULT_HTTPS_PORT : INTERNET_DEFAULT_HTTP_PORT);
+        HINTERNET hConnect = WinHttpConnect(hSession, Widen(host).c_str(), connectPort, 0);
+        if (hConnect) {
+            HINTERNET hRequest = WinHttpOpenRequest(hConnect, L"GET", Widen(path).c_str(), NULL, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, secure ? WINHTTP_FLAG_SECURE : 0);
+            if (hRequest) {
+                if (WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0, WINHTTP_NO_REQUEST_DATA, 0, 0, 0)) {
+                    DWORD status = 0;
+                    DWORD statusSize = sizeof(status);
+                    if (WinHttpReceiveResponse(hRequest, NULL) &&
+                        WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX, &status, &statusSize, WINHTTP_NO_HEADER_INDEX) &&
+                        status < 400) {
+                        DWORD dwSize = 0;
+                        DWORD dwDownloaded = 0;
+                        do {
+                            dwSize = 0;
+                            if (!WinHttpQueryDataAvailable(hRequest, &dwSize)) break;
+                            if (dwSize == 0) break;
+                            std::vector<char> buffer(dwSize);
+                            if (WinHttpReadData(hRequest, &buffer[0], dwSize, &dwDownloaded)) {
+                                body.append(&buffer[0], dwDownloaded);
+                            }
+                        } while (dwSize > 0);
+                        ok = true;
+                    }
+                }
+                WinHttpCloseHandle(hRequest);
+            }
+            WinHttpCloseHandle(hConnect);
+        }
+        WinHttpCloseHandle(hSession);
+    }
+    return ok;
+}
+
+bool HttpAvailable() {
+    return true;
+}
+
+#elif defined(MEDIA_SORTER_HAVE_CURL)
+
+static size_t CurlWrite(char* data, size_t size, size_t count, void* user) {
+    ((std::string*)user)->append(data, size * count);
+    return size * count;
+}
+
+bool HttpGet(const std::string& host, int port, const std::string& path, bool secure, std::string& body) {
+    CURL* curl = curl_easy_init();
+    if (!curl) return false;
+    std::string url = (secure ? "https://" : "http://") + host;
+    if (port > 0) url += ":" + std::to_string(port);
+    url += path;
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "MediaSorter/1.0");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    CURLcode res = curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+    return res == CURLE_OK;
+}
+
+bool HttpAvailable() {
+    return true;
+}
+
+#else
+
+bool HttpGet(const std::string&, int, const std::string&, bool, std::string&) {
+    return false;
+}
+
+bool HttpAvailable() {
+    return false;
+}
+
+#endif
@@ -0,0 +1,13 @@
+// http_client.h
+#pragma once
+
+#include <string>
+
+// Blocking HTTP GET. Uses WinHTTP on Windows and libcurl elsewhere (when the
+// engine is built with MEDIA_SORTER_HAVE_CURL). port 0 means the scheme's
+// default. Returns false if no response body could be retrieved or the
+// server answered with an error status.
+bool HttpGet(const std::string& host, int port, const std::string& path, bool secure, std::string& body);
+
+// Whether this build can issue requests at all.
+bool HttpAvailable();
@@ -0,0 +1,272 @@
+// inflate.cpp
+#include "inflate.h"
+#include <cstring>
+
+static const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t DIST_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t DIST_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// --- HUFFMAN TABLES ---
+
+bool InflateStream::Huffman::Build(const uint8_t* lengths, int n) {
+    memset(count, 0, sizeof(count));
+    for (int i = 0; i < n; ++i) count[lengths[i]]++;
+    count[0] = 0;
+
+    // Over-subscribed sets are invalid; incomplete ones are allowed (a lone
+    // distance code) and fail at decode time if an unused code shows up
+    int left = 1;
+    for (int len = 1; len < 16; ++len) {
+        left <<= 1;
+        left -= count[len];
+        if (left < 0) return false;
+    }
+
+    uint16_t offsets[16];
+    offsets[1] = 0;
+    for (int len = 1; len < 15; ++len) offsets[len + 1] = offsets[len] + count[len];
+    for (int i = 0; i < n; ++i) {
+        if (lengths[i]) symbol[offsets[lengths[i]]++] = (uint16_t)i;
+    }
+
+    // Codes are stored MSB-first but read LSB-first, so index the fast table
+    // by the bit-reversed code
+    memset(fast, 0, sizeof(fast));
+    int code = 0, index = 0;
+    for (int len = 1; len <= FAST_BITS; ++len) {
+        for (int k = 0; k < count[len]; ++k, ++code, ++index) {
+            int rev = 0;
+            for (int b = 0; b < len; ++b) rev |= ((code >> b) & 1) << (len - 1 - b);
+            for (int j = rev; j < (1 << FAST_BITS); j += 1 << len) {
+                fast[j] = (uint16_t)(symbol[index] | (len << 9));
+            }
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+void InflateStream::FixedTables(const Huffman*& lit, const Huffman*& dist) {
+    struct Fixed {
+        Huffman lit, dist;
+        Fixed() {
+            uint8_t lengths[288];
+            int i = 0;
+            for (; i < 144; ++i) lengths[i] = 8;
+            for (; i < 256; ++i) lengths[i] = 9;
+            for (; i < 280; ++i) lengths[i] = 7;
+            for (; i < 288; ++i) lengths[i] = 8;
+            lit.Build(lengths, 288);
+            for (i = 0; i < 30; ++i) lengths[i] = 5;
+            dist.Build(lengths, 30);
+        }
+    };
+    static const Fixed fixed;
+    lit = &fixed.lit;
+    dist = &fixed.dist;
+}
+
+// --- BIT READER ---
+
+InflateStream::InflateStream(const uint8_t* data, size_t size) : m_src(data), m_size(size) {
+}
+
+// Tops the buffer up with whole bytes. Past the end of the input, zero bits
+// are appended (only as many as asked for) so a short final code can still
+// be looked up with a full-width peek; consuming them is an error.
+void InflateStream::Refill(int bits) {
+    while (m_bitCount <= 56) {
+        if (m_pos < m_size) {
+            m_bitBuf |= (uint64_t)m_src[m_pos++] << m_bitCount;
+        } else if (m_bitCount < bits) {
+            m_padBits += 8;
+        } else {
+            break;
+        }
+        m_bitCount += 8;
+    }
+}
+
+uint32_t InflateStream::Bits(int n) {
+    if (n == 0) return 0;
+    Refill(n);
+    uint32_t v = (uint32_t)(m_bitBuf & ((1ULL << n) - 1));
+    m_bitBuf >>= n;
+    m_bitCount -= n;
+    if (m_bitCount < m_padBits) m_overrun = true;
+    return v;
+}
+
+int InflateStream::Decode(const Huffman& h) {
+    Refill(15);
+    uint16_t entry = h.fast[m_bitBuf & ((1 << Huffman::FAST_BITS) - 1)];
+    if (entry) {
+        Bits(entry >> 9);
+        return entry & 511;
+    }
+
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; ++len) {
+        code |= (int)((m_bitBuf >> (len - 1)) & 1);
+        int count = h.count[len];
+        if (code < first + count) {
+            Bits(len);
+            return h.symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+bool InflateStream::ReadDynamicTables() {
+    static const uint8_t ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    int nlen = (int)Bits(5) + 257;
+    int ndist = (int)Bits(5) + 1;
+    int ncode = (int)Bits(4) + 4;
+    if (nlen > 286 || ndist > 30) return false;
+
+    uint8_t lengths[320];
+    memset(lengths, 0, 19);
+    for (int i = 0; i < ncode; ++i) lengths[ORDER[i]] = (uint8_t)Bits(3);
+    Huffman codeLengths;
+    if (!codeLengths.Build(lengths, 19)) return false;
+
+    int index = 0;
+    while (index < nlen + ndist) {
+        int sym = Decode(codeLengths);
+        if (sym < 0 || m_overrun) return false;
+        if (sym < 16) {
+            lengths[index++] = (uint8_t)sym;
+            continue;
+        }
+        uint8_t value = 0;
+        int repeat;
+        if (sym == 16) {
+            if (index == 0) return false;
+            value = lengths[index - 1];
+            repeat = 3 + (int)Bits(2);
+        } else if (sym == 17) {
+            repeat = 3 + (int)Bits(3);
+        } else {
+            repeat = 11 + (int)Bits(7);
+        }
+        if (index + repeat > nlen + ndist) return false;
+        while (repeat--) lengths[index++] = value;
+    }
+    if (lengths[256] == 0) return false; // No end-of-block code
+
+    if (!m_dynLit.Build(lengths, nlen) || !m_dynDist.Build(lengths + nlen, ndist)) return false;
+    m_lit = &m_dynLit;
+    m_dist = &m_dynDist;
+    return !m_overrun;
+}
+
+// --- DECODER ---
+
+long InflateStream::Read(uint8_t* out, size_t size) {
+    size_t produced = 0;
+    while (produced < size) {
+        if (m_matchLen > 0) {
+            while (m_matchLen > 0 && produced < size) {
+                Emit(m_window[(m_total - m_matchDist) & 32767], out, produced);
+                m_matchLen--;
+            }
+            continue;
+        }
+
+        switch (m_state) {
+        case State::Finished:
+            return (long)produced;
+
+        case State::Error:
+            return -1;
+
+        case State::BlockHeader: {
+            if (m_lastBlock) {
+                m_state = State::Finished;
+                break;
+            }
+            m_lastBlock = Bits(1) != 0;
+            uint32_t type = Bits(2);
+            if (type == 0) {
+                // Stored: byte-align and hand back whole bytes still buffered
+                Bits(m_bitCount % 8);
+                if (m_overrun || m_padBits > 0) { m_state = State::Error; return -1; }
+                m_pos -= (size_t)(m_bitCount / 8);
+                m_bitBuf = 0;
+                m_bitCount = 0;
+                if (m_size - m_pos < 4) { m_state = State::Error; return -1; }
+                uint32_t len = m_src[m_pos] | (m_src[m_pos + 1] << 8);
+                uint32_t nlen = m_src[m_pos + 2] | (m_src[m_pos + 3] << 8);
+                if (len != (~nlen & 0xFFFF)) { m_state = State::Error; return -1; }
+                m_pos += 4;
+                m_storedLeft = len;
+                m_state = State::Stored;
+            } else if (type == 1) {
+                FixedTables(m_lit, m_dist);
+                m_state = State::Compressed;
+            } else if (type == 2) {
+                if (!ReadDynamicTables()) { m_state = State::Error; return -1; }
+                m_state = State::Compressed;
+            } else {
+                m_state = State::Error;
+                return -1;
+            }
+            if (m_overrun) { m_state = State::Error; return -1; }
+            break;
+        }
+
+        case State::Stored: {
+            size_t n = m_storedLeft;
+            if (n > size - produced) n = size - produced;
+            if (n > m_size - m_pos) { m_state = State::Error; return -1; }
+            memcpy(out + produced, m_src + m_pos, n);
+            // Keep the window current (only the last 32 KB matter)
+            size_t keep = n > 32768 ? 32768 : n;
+            for (size_t i = n - keep; i < n; ++i) m_window[(m_total + i) & 32767] = m_src[m_pos + i];
+            m_total += n;
+            m_pos += n;
+            produced += n;
+            m_storedLeft -= n;
+            if (m_storedLeft == 0) m_state = State::BlockHeader;
+            break;
+        }
+
+        case State::Compressed: {
+            int sym = Decode(*m_lit);
+            if (sym < 0) { m_state = State::Error; return -1; }
+            if (sym < 256) {
+                Emit((uint8_t)sym, out, produced);
+            } else if (sym == 256) {
+                m_state = State::BlockHeader;
+            } else {
+                sym -= 257;
+                if (sym >= 29) { m_state = State::Error; return -1; }
+                uint32_t len = LENGTH_BASE[sym] + Bits(LENGTH_EXTRA[sym]);
+                int dsym = Decode(*m_dist);
+                if (dsym < 0 || dsym >= 30) { m_state = State::Error; return -1; }
+                uint32_t dist = DIST_BASE[dsym] + Bits(DIST_EXTRA[dsym]);
+                if (dist > m_total) { m_state = State::Error; return -1; }
+                m_matchLen = len;
+                m_matchDist = dist;
+            }
+            if (m_overrun) { m_state = State::Error; return -1; }
+            break;
+        }
+        }
+    }
+    return (long)produced;
+}
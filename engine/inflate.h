@@ -0,0 +1,65 @@
+// inflate.h
+// Raw DEFLATE (RFC 1951) decoder with a pull interface: Read() produces the
+// next decompressed bytes on demand, so a member can be parsed from its first
+// bytes and streamed to disk without ever being held in memory whole. The
+// compressed input must be available in full (e.g. a mapped ZIP).
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+class InflateStream {
+public:
+    InflateStream(const uint8_t* data, size_t size);
+
+    // Up to size bytes of output; 0 once the stream is complete. Returns -1
+    // on corrupt input.
+    long Read(uint8_t* out, size_t size);
+
+    bool Finished() const { return m_state == State::Finished; }
+
+private:
+    // Canonical Huffman code: codes up to FAST_BITS long decode with a single
+    // table lookup, longer ones by walking the per-length counts.
+    struct Huffman {
+        static const int FAST_BITS = 10;
+        uint16_t fast[1 << FAST_BITS];  // symbol | length << 9, 0 = longer code
+        uint16_t count[16];
+        uint16_t symbol[288];
+        bool Build(const uint8_t* lengths, int n);
+    };
+
+    enum class State { BlockHeader, Stored, Compressed, Finished, Error };
+
+    static void FixedTables(const Huffman*& lit, const Huffman*& dist);
+
+    void Refill(int bits);
+    uint32_t Bits(int n);
+    int Decode(const Huffman& h);
+    bool ReadDynamicTables();
+    void Emit(uint8_t b, uint8_t* out, size_t& produced) {
+        out[produced++] = b;
+        m_window[m_total++ & 32767] = b;
+    }
+
+    const uint8_t* m_src;
+    size_t m_size;
+    size_t m_pos = 0;
+    uint64_t m_bitBuf = 0;
+    int m_bitCount = 0;
+    int m_padBits = 0;          // Zero bits appended past the end of input
+    bool m_overrun = false;     // Consumed some of them
+
+    State m_state = State::BlockHeader;
+    bool m_lastBlock = false;
+    size_t m_storedLeft = 0;
+    const Huffman* m_lit = nullptr;
+    const Huffman* m_dist = nullptr;
+    Huffman m_dynLit;
+    Huffman m_dynDist;
+
+    uint32_t m_matchLen = 0;    // Pending back-reference, continued on the next Read
+    uint32_t m_matchDist = 0;
+    uint64_t m_total = 0;
+    uint8_t m_window[32768];
+};
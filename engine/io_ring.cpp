@@ -0,0 +1,249 @@
+// io_ring.cpp
+#include "io_ring.h"
+#include <fstream>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define MEDIA_SORTER_HAVE_IO_URING 1
+#endif
+
+namespace fs = std::filesystem;
+
+static void ReadHeadsBlocking(std::vector<HeadRead>& reads) {
+    for (auto& read : reads) {
+        if (read.ok) continue;
+        std::ifstream in(read.path, std::ios::binary);
+        read.data.resize(read.size);
+        in.read((char*)read.data.data(), (std::streamsize)read.size);
+        read.data.resize((size_t)in.gcount());
+        read.ok = in.is_open() && (in.good() || in.eof());
+    }
+}
+
+
+#ifdef MEDIA_SORTER_HAVE_IO_URING
+
+// --- RING ---
+
+bool IoRing::Init(unsigned entries) {
+    Close();
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) return false;
+    m_fd = fd;
+    m_entries = params.sq_entries;
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap) {
+        if (m_cqRingSize > m_sqRingSize) m_sqRingSize = m_cqRingSize;
+        m_cqRingSize = 0;
+    }
+
+    void* sq = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        Close();
+        return false;
+    }
+    m_sqRing = sq;
+    void* cq = sq;
+    if (!singleMap) {
+        cq = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            Close();
+            return false;
+        }
+        m_cqRing = cq;
+    }
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        Close();
+        return false;
+    }
+    m_sqes = sqes;
+
+    char* sqBase = (char*)sq;
+    char* cqBase = (char*)cq;
+    m_sqHead = (unsigned*)(sqBase + params.sq_off.head);
+    m_sqTail = (unsigned*)(sqBase + params.sq_off.tail);
+    m_sqMask = (unsigned*)(sqBase + params.sq_off.ring_mask);
+    m_sqArray = (unsigned*)(sqBase + params.sq_off.array);
+    m_cqHead = (unsigned*)(cqBase + params.cq_off.head);
+    m_cqTail = (unsigned*)(cqBase + params.cq_off.tail);
+    m_cqMask = (unsigned*)(cqBase + params.cq_off.ring_mask);
+    m_cqes = cqBase + params.cq_off.cqes;
+    m_toSubmit = 0;
+    return true;
+}
+
+void IoRing::Close() {
+    if (m_sqes) munmap(m_sqes, m_sqesSize);
+    if (m_cqRing) munmap(m_cqRing, m_cqRingSize);
+    if (m_sqRing) munmap(m_sqRing, m_sqRingSize);
+    if (m_fd >= 0) close(m_fd);
+    m_sqes = m_cqRing = m_sqRing = nullptr;
+    m_fd = -1;
+    m_entries = 0;
+}
+
+bool IoRing::Available() {
+    static const bool available = [] {
+        IoRing probe;
+        return probe.Init(2);
+    }();
+    return available;
+}
+
+bool IoRing::Prep(int op, int fd, uint64_t address, unsigned length, uint64_t offset, uint64_t userData) {
+    unsigned tail = *m_sqTail;
+    unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    if (tail - head >= m_entries) return false;
+
+    unsigned index = tail & *m_sqMask;
+    io_uring_sqe* sqe = (io_uring_sqe*)m_sqes + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (uint8_t)op;
+    sqe->fd = fd;
+    sqe->addr = address;
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = userData;
+    m_sqArray[index] = index;
+    __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+    m_toSubmit++;
+    return true;
+}
+
+bool IoRing::PrepRead(int fd, void* buffer, unsigned length, uint64_t offset, uint64_t userData) {
+    return Prep(IORING_OP_READ, fd, (uint64_t)(uintptr_t)buffer, length, offset, userData);
+}
+
+bool IoRing::PrepWrite(int fd, const void* buffer, unsigned length, uint64_t offset, uint64_t userData) {
+    return Prep(IORING_OP_WRITE, fd, (uint64_t)(uintptr_t)buffer, length, offset, userData);
+}
+
+bool IoRing::Submit(unsigned waitFor) {
+    while (m_toSubmit > 0 || waitFor > 0) {
+        unsigned flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+        int n = (int)syscall(__NR_io_uring_enter, m_fd, m_toSubmit, waitFor, flags, nullptr, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        m_toSubmit -= (unsigned)n;
+        if (waitFor > 0) break;
+    }
+    return true;
+}
+
+bool IoRing::Peek(Completion& completion) {
+    unsigned head = *m_cqHead;
+    unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+    if (head == tail) return false;
+    const io_uring_cqe* cqe = (const io_uring_cqe*)m_cqes + (head & *m_cqMask);
+    completion.userData = cqe->user_data;
+    completion.result = cqe->res;
+    __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// --- BATCHED HEADER READS ---
+
+void ReadHeads(IoRing* ring, std::vector<HeadRead>& reads) {
+    if (!ring || !ring->is_open()) {
+        ReadHeadsBlocking(reads);
+        return;
+    }
+
+    std::vector<int> fds(reads.size(), -1);
+    std::vector<size_t> filled(reads.size(), 0);
+    size_t next = 0, inFlight = 0;
+    bool ringFailed = false;
+
+    while (next < reads.size() || inFlight > 0) {
+        while (next < reads.size()) {
+            HeadRead& read = reads[next];
+            if (fds[next] < 0) {
+                read.data.resize(read.size);
+                fds[next] = open(read.path.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fds[next] < 0 || read.size == 0) {
+                    read.data.clear();
+                    read.ok = fds[next] >= 0;
+                    next++;
+                    continue;
+                }
+            }
+            if (!ring->PrepRead(fds[next], read.data.data(), (unsigned)read.size, 0, next)) break;
+            inFlight++;
+            next++;
+        }
+        if (inFlight == 0) continue;
+        if (!ring->Submit(1)) {
+            ringFailed = true;
+            break;
+        }
+
+        IoRing::Completion c;
+        while (ring->Peek(c)) {
+            inFlight--;
+            size_t i = (size_t)c.userData;
+            HeadRead& read = reads[i];
+            if (c.result < 0) {
+                read.data.clear();
+                close(fds[i]);
+                fds[i] = -1;
+                continue;
+            }
+            filled[i] += (size_t)c.result;
+            if (c.result > 0 && filled[i] < read.size) {
+                // Short read before the end: ask for the rest
+                if (ring->PrepRead(fds[i], read.data.data() + filled[i], (unsigned)(read.size - filled[i]), filled[i], i)) {
+                    inFlight++;
+                    continue;
+                }
+            }
+            read.data.resize(filled[i]);
+            read.ok = true;
+            close(fds[i]);
+            fds[i] = -1;
+        }
+    }
+
+    for (int fd : fds) {
+        if (fd >= 0) close(fd);
+    }
+    if (ringFailed) {
+        // Closing the ring cancels what is still in flight; finish blocking
+        ring->Close();
+        ReadHeadsBlocking(reads);
+    }
+}
+
+#else
+
+bool IoRing::Init(unsigned) { return false; }
+void IoRing::Close() {}
+bool IoRing::Available() { return false; }
+bool IoRing::Prep(int, int, uint64_t, unsigned, uint64_t, uint64_t) { return false; }
+bool IoRing::PrepRead(int, void*, unsigned, uint64_t, uint64_t) { return false; }
+bool IoRing::PrepWrite(int, const void*, unsigned, uint64_t, uint64_t) { return false; }
+bool IoRing::Submit(unsigned) { return false; }
+bool IoRing::Peek(Completion&) { return false; }
+
+void ReadHeads(IoRing*, std::vector<HeadRead>& reads) {
+    ReadHeadsBlocking(reads);
+}
+
+#endif
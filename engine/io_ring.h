@@ -0,0 +1,81 @@
+// io_ring.h
+// Minimal io_uring wrapper on the raw system calls, no liburing needed. One
+// thread can keep many reads and writes in flight with it, which is what
+// deep-queue devices (NVMe) and high-latency mounts need to be kept busy.
+// Where io_uring is missing (non-Linux, old kernels, disabled by sysctl or a
+// seccomp policy) Init fails and callers take the blocking path.
+#pragma once
+
+#include <filesystem>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class IoRing {
+public:
+    struct Completion {
+        uint64_t userData;
+        int result;                 // Bytes transferred, or -errno
+    };
+
+    IoRing() {}
+    ~IoRing() { Close(); }
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    bool Init(unsigned entries);
+    void Close();
+    bool is_open() const { return m_fd >= 0; }
+
+    // Whether a ring can be set up at all here; probed once.
+    static bool Available();
+
+    // Queue one operation, false when the submission queue is full. Nothing
+    // reaches the kernel before Submit.
+    bool PrepRead(int fd, void* buffer, unsigned length, uint64_t offset, uint64_t userData);
+    bool PrepWrite(int fd, const void* buffer, unsigned length, uint64_t offset, uint64_t userData);
+
+    // Hands everything queued to the kernel and waits until at least
+    // waitFor completions are ready. Returns false on a ring error.
+    bool Submit(unsigned waitFor = 0);
+
+    // Takes the next ready completion, if any.
+    bool Peek(Completion& completion);
+
+    unsigned Capacity() const { return m_entries; }
+
+private:
+    bool Prep(int op, int fd, uint64_t address, unsigned length, uint64_t offset, uint64_t userData);
+
+    int m_fd = -1;
+    unsigned m_entries = 0;
+    unsigned m_toSubmit = 0;
+
+    void* m_sqRing = nullptr;
+    void* m_cqRing = nullptr;
+    void* m_sqes = nullptr;
+    size_t m_sqRingSize = 0;
+    size_t m_cqRingSize = 0;
+    size_t m_sqesSize = 0;
+
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned* m_sqMask = nullptr;
+    unsigned* m_sqArray = nullptr;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned* m_cqMask = nullptr;
+    void* m_cqes = nullptr;
+};
+
+// The first bytes of a file, read ahead for metadata parsing.
+struct HeadRead {
+    std::filesystem::path path;
+    size_t size = 0;                // Bytes wanted (at most the file size)
+    std::vector<uint8_t> data;      // What was read; short at end of file
+    bool ok = false;
+};
+
+// Reads the heads of all files with up to the ring's capacity in flight at
+// once. Without a ring (nullptr or not open) they are read one by one.
+void ReadHeads(IoRing* ring, std::vector<HeadRead>& reads);
@@ -0,0 +1,81 @@
+// mapped_file.cpp
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::filesystem::path& path) {
+    Close();
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0) {
+        CloseHandle(hFile);
+        return false;
+    }
+    HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!hMapping) {
+        CloseHandle(hFile);
+        return false;
+    }
+    void* view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return false;
+    }
+
+    m_hFile = hFile;
+    m_hMapping = hMapping;
+    m_data = (const uint8_t*)view;
+    m_size = (size_t)size.QuadPart;
+    return true;
+}
+
+void MappedFile::Close() {
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_hMapping) CloseHandle(m_hMapping);
+    if (m_hFile) CloseHandle(m_hFile);
+    m_data = nullptr;
+    m_size = 0;
+    m_hMapping = nullptr;
+    m_hFile = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::filesystem::path& path) {
+    Close();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+
+    m_data = (const uint8_t*)view;
+    m_size = (size_t)st.st_size;
+    return true;
+}
+
+void MappedFile::Close() {
+    if (m_data) munmap((void*)m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
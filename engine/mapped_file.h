@@ -0,0 +1,30 @@
+// mapped_file.h
+#pragma once
+
+#include <filesystem>
+#include <cstdint>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+    MappedFile() {}
+    ~MappedFile() { Close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::filesystem::path& path);
+    void Close();
+
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool is_open() const { return m_data != nullptr; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_hFile = nullptr;
+    void* m_hMapping = nullptr;
+#endif
+};
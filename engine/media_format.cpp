@@ -0,0 +1,182 @@
+// media_format.cpp
+#include "media_format.h"
+#include "bmff_reader.h"
+#include <algorithm>
+#include <cstring>
+
+static const char* const FORMAT_NAMES[MEDIA_FORMAT_COUNT] = {
+    "unknown", "jpeg", "tiff", "heif", "bmff", "png", "zip" };
+
+const char* MediaFormatName(MediaFormat format) {
+    return FORMAT_NAMES[(int)format];
+}
+
+static uint32_t BE32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// --- HEAD ---
+
+MediaHead::MediaHead(const uint8_t* data, size_t size)
+    : m_data(data), m_size(size), m_fileSize(size), m_haveFileSize(true) {
+}
+
+MediaHead::MediaHead(std::istream& stream) : m_stream(&stream) {
+    m_buffer.resize(SNIFF_WINDOW);
+    stream.read((char*)m_buffer.data(), (std::streamsize)m_buffer.size());
+    m_buffer.resize((size_t)stream.gcount());
+    m_bytesRead = m_buffer.size();
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    // A short read was the whole file
+    if (m_size < SNIFF_WINDOW) {
+        m_fileSize = m_size;
+        m_haveFileSize = true;
+    }
+}
+
+uint64_t MediaHead::FileSize() {
+    if (!m_haveFileSize) {
+        m_stream->clear();
+        m_stream->seekg(0, std::ios::end);
+        std::streamoff end = m_stream->tellg();
+        m_fileSize = end < 0 ? m_size : (uint64_t)end;
+        m_haveFileSize = true;
+    }
+    return m_fileSize;
+}
+
+bool MediaHead::Extend(size_t size) {
+    if (size <= m_size) return true;
+    if (!m_stream || size > exif::HEADER_WINDOW || size > FileSize()) return false;
+    // Reads at least double, segments tend to follow each other closely
+    size_t want = (size_t)std::min<uint64_t>(std::min(std::max(size, m_size * 2), exif::HEADER_WINDOW), FileSize());
+    m_buffer.resize(want);
+    m_stream->clear();
+    m_stream->seekg((std::streamoff)m_size);
+    m_stream->read((char*)m_buffer.data() + m_size, (std::streamsize)(want - m_size));
+    size_t got = (size_t)m_stream->gcount();
+    m_bytesRead += got;
+    m_buffer.resize(m_size + got);
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    return size <= m_size;
+}
+
+// --- PARSERS ---
+
+// Formats without metadata of their own (ZIPs are opened as archives)
+template<MediaFormat F>
+static bool ParseAs(MediaHead&, ExifInfo&) {
+    return false;
+}
+
+template<>
+bool ParseAs<MediaFormat::Jpeg>(MediaHead& head, ExifInfo& out) {
+    size_t offset = 0, length = 0, needed = 0;
+    while (!exif::FindJpegExif(head.Data(), head.Size(), offset, length, &needed)) {
+        if (needed <= head.Size() || !head.Extend(needed)) return false;
+    }
+    return exif::ParseTiff(head.Data() + offset, length, out);
+}
+
+template<>
+bool ParseAs<MediaFormat::Tiff>(MediaHead& head, ExifInfo& out) {
+    if (!head.Stream()) return exif::ParseTiff(head.Data(), head.Size(), out);
+    uint64_t read = 0;
+    bool ok = exif::ParseTiffStream(head.Data(), head.Size(), *head.Stream(), head.FileSize(), out, &read);
+    head.CountRead(read);
+    return ok;
+}
+
+static bool ParseBoxes(MediaHead& head, ExifInfo& out) {
+    if (!head.Stream()) return bmff::ParseBuffer(head.Data(), head.Size(), out);
+    uint64_t read = 0;
+    bool ok = bmff::ParseStream(head.Data(), head.Size(), *head.Stream(), head.FileSize(), out, &read);
+    head.CountRead(read);
+    return ok;
+}
+
+template<>
+bool ParseAs<MediaFormat::Heif>(MediaHead& head, ExifInfo& out) {
+    return ParseBoxes(head, out);
+}
+
+template<>
+bool ParseAs<MediaFormat::Bmff>(MediaHead& head, ExifInfo& out) {
+    return ParseBoxes(head, out);
+}
+
+// Chunks of length, type, data and CRC; an eXIf chunk holds a TIFF block
+// and has to come before the image data (IDAT)
+template<>
+bool ParseAs<MediaFormat::Png>(MediaHead& head, ExifInfo& out) {
+    size_t pos = 8;
+    for (int chunk = 0; chunk < 1000 && head.Extend(pos + 8); ++chunk) {
+        uint32_t length = BE32(head.Data() + pos);
+        uint32_t type = BE32(head.Data() + pos + 4);
+        if (type == BE32((const uint8_t*)"IDAT") || type == BE32((const uint8_t*)"IEND")) break;
+        if (length > exif::HEADER_WINDOW) break;
+        if (type == BE32((const uint8_t*)"eXIf")) {
+            return head.Extend(pos + 8 + length) && exif::ParseTiff(head.Data() + pos + 8, length, out);
+        }
+        pos += 12 + (size_t)length;
+    }
+    return false;
+}
+
+// --- DISPATCH ---
+
+static bool IsHeifBrand(const uint8_t* data, size_t size) {
+    static const char* const BRANDS[] = { "heic", "heix", "heim", "heis", "hevc", "hevx", "mif1", "msf1", "avif", "avis" };
+    if (size < 12) return false;
+    for (const char* brand : BRANDS) {
+        if (memcmp(data + 8, brand, 4) == 0) return true;
+    }
+    return false;
+}
+
+struct Signature {
+    MediaFormat format;
+    size_t offset;
+    const char* magic;                      // length bytes at offset
+    size_t length;
+    bool (*accept)(const uint8_t* data, size_t size);   // Further check, or null
+};
+
+// First match wins: HEIF before the other ISO-BMFF brands
+static constexpr Signature SIGNATURES[] = {
+    { MediaFormat::Jpeg, 0, "\xFF\xD8\xFF", 3, nullptr },
+    { MediaFormat::Tiff, 0, "II*\0", 4, nullptr },
+    { MediaFormat::Tiff, 0, "MM\0*", 4, nullptr },
+    { MediaFormat::Tiff, 0, "IIRO", 4, nullptr },          // Olympus ORF
+    { MediaFormat::Tiff, 0, "IIRS", 4, nullptr },
+    { MediaFormat::Tiff, 0, "IIU\0", 4, nullptr },         // Panasonic RW2
+    { MediaFormat::Heif, 4, "ftyp", 4, IsHeifBrand },
+    { MediaFormat::Bmff, 0, "", 0, bmff::LooksLikeBmff },   // Also CR3
+    { MediaFormat::Png, 0, "\x89PNG\r\n\x1A\n", 8, nullptr },
+    { MediaFormat::Zip, 0, "PK\x03\x04", 4, nullptr },
+    { MediaFormat::Zip, 0, "PK\x05\x06", 4, nullptr },      // Empty archive
+};
+
+using Parser = bool (*)(MediaHead& head, ExifInfo& out);
+
+static constexpr Parser PARSERS[] = {
+    ParseAs<MediaFormat::Unknown>, ParseAs<MediaFormat::Jpeg>, ParseAs<MediaFormat::Tiff>, ParseAs<MediaFormat::Heif>,
+    ParseAs<MediaFormat::Bmff>, ParseAs<MediaFormat::Png>, ParseAs<MediaFormat::Zip> };
+static_assert(sizeof(PARSERS) / sizeof(PARSERS[0]) == MEDIA_FORMAT_COUNT, "one parser per format");
+
+MediaFormat SniffFormat(const uint8_t* data, size_t size) {
+    for (const Signature& s : SIGNATURES) {
+        if (s.offset + s.length > size || memcmp(data + s.offset, s.magic, s.length) != 0) continue;
+        if (s.accept && !s.accept(data, size)) continue;
+        return s.format;
+    }
+    return MediaFormat::Unknown;
+}
+
+MediaFormat ReadMediaMetadata(MediaHead& head, ExifInfo& out) {
+    MediaFormat format = SniffFormat(head.Data(), head.Size());
+    PARSERS[(int)format](head, out);
+    return format;
+}
@@ -0,0 +1,59 @@
+// media_format.h
+// Format detection and metadata dispatch. A file's first SNIFF_WINDOW bytes
+// are matched against a table of magic numbers, and the parser for the
+// format found reads only what that format needs beyond them: the APP1
+// segment of a JPEG, the IFDs of a TIFF/RAW, the meta or moov box of a
+// HEIF/MP4, the chunks ahead of a PNG's image data. Anything unrecognised
+// costs the one read and nothing more.
+#pragma once
+
+#include "exif_reader.h"
+#include <istream>
+#include <vector>
+#include <cstdint>
+
+enum class MediaFormat { Unknown, Jpeg, Tiff, Heif, Bmff, Png, Zip };
+const int MEDIA_FORMAT_COUNT = 7;
+
+const char* MediaFormatName(MediaFormat format);
+
+// The first read of a file: every magic number, and all the metadata of
+// most formats. A JPEG with a large APP1 segment takes a second read.
+const size_t SNIFF_WINDOW = 4096;
+
+MediaFormat SniffFormat(const uint8_t* data, size_t size);
+
+// The start of a file and, for a file on disk, the stream the rest comes
+// from. Parsers grow the head with Extend, up to exif::HEADER_WINDOW.
+class MediaHead {
+public:
+    // Content only available in memory (an archive member's header, a prefetched read)
+    MediaHead(const uint8_t* data, size_t size);
+    // A file: reads its first SNIFF_WINDOW bytes
+    explicit MediaHead(std::istream& stream);
+
+    const uint8_t* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+    std::istream* Stream() const { return m_stream; }
+    uint64_t FileSize();
+
+    // True once the first size bytes are in Data()
+    bool Extend(size_t size);
+
+    // Bytes read from the stream, by the head and by parsers (CountRead)
+    uint64_t BytesRead() const { return m_bytesRead; }
+    void CountRead(uint64_t bytes) { m_bytesRead += bytes; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    std::vector<uint8_t> m_buffer;
+    std::istream* m_stream = nullptr;
+    uint64_t m_fileSize = 0;
+    bool m_haveFileSize = false;
+    uint64_t m_bytesRead = 0;
+};
+
+// Sniffs the head and runs the format's parser. Returns the format, also
+// when its parser found nothing.
+MediaFormat ReadMediaMetadata(MediaHead& head, ExifInfo& out);
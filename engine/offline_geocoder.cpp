@@ -0,0 +1,238 @@
+// offline_geocoder.cpp
+#include "offline_geocoder.h"
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char INDEX_MAGIC[4] = { 'M', 'S', 'K', 'D' };
+const uint32_t INDEX_VERSION = 1;
+const double EARTH_RADIUS_KM = 6371.0;
+const double PI = 3.14159265358979323846;
+
+// Native byte order; the index is a cache, rebuilt whenever it doesn't match.
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+};
+
+void ToUnitSphere(double lat, double lon, float out[3]) {
+    double la = lat * PI / 180.0;
+    double lo = lon * PI / 180.0;
+    out[0] = (float)(std::cos(la) * std::cos(lo));
+    out[1] = (float)(std::cos(la) * std::sin(lo));
+    out[2] = (float)std::sin(la);
+}
+
+void SourceIdentity(const fs::path& file, uint64_t& size, int64_t& time) {
+    std::error_code ec;
+    size = (uint64_t)fs::file_size(file, ec);
+    time = (int64_t)fs::last_write_time(file, ec).time_since_epoch().count();
+}
+
+} // namespace
+
+OfflineGeocoder::OfflineGeocoder(double maxDistanceKm) {
+    double chord = 2.0 * std::sin(maxDistanceKm / (2.0 * EARTH_RADIUS_KM));
+    m_maxChordSq = chord * chord;
+}
+
+bool OfflineGeocoder::BuildIndex(const fs::path& placesFile, std::vector<uint8_t>& out, std::string& error) {
+    std::ifstream in(placesFile, std::ios::binary);
+    if (!in) {
+        error = "Cannot open places file: " + placesFile.u8string();
+        return false;
+    }
+
+    struct Place {
+        float p[3];
+        uint32_t name;
+    };
+    std::vector<Place> places;
+    std::string names;
+    std::string line;
+    std::vector<std::string> cols;
+
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+
+        cols.clear();
+        size_t start = 0;
+        while (cols.size() < 7) {
+            size_t tab = line.find('\t', start);
+            cols.push_back(line.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+            if (tab == std::string::npos) break;
+            start = tab + 1;
+        }
+        if (cols.size() < 6 || cols[1].empty()) continue;
+        // Only populated places when given a full GeoNames dump
+        if (cols.size() >= 7 && !cols[6].empty() && cols[6] != "P") continue;
+
+        char* end = nullptr;
+        double lat = std::strtod(cols[4].c_str(), &end);
+        if (end == cols[4].c_str() || lat < -90.0 || lat > 90.0) continue;
+        double lon = std::strtod(cols[5].c_str(), &end);
+        if (end == cols[5].c_str() || lon < -180.0 || lon > 180.0) continue;
+
+        Place place;
+        ToUnitSphere(lat, lon, place.p);
+        place.name = (uint32_t)names.size();
+        names += cols[1];
+        names += '\0';
+        places.push_back(place);
+    }
+
+    if (places.empty()) {
+        error = "No places found in " + placesFile.u8string();
+        return false;
+    }
+
+    // Balanced k-d tree in implicit layout: the median of [lo, hi) sits at the
+    // midpoint, split axis cycles x -> y -> z with depth.
+    struct Builder {
+        std::vector<Place>& v;
+        void Build(size_t lo, size_t hi, int axis) {
+            if (hi - lo <= 1) return;
+            size_t mid = lo + (hi - lo) / 2;
+            std::nth_element(v.begin() + lo, v.begin() + mid, v.begin() + hi,
+                             [axis](const Place& a, const Place& b) { return a.p[axis] < b.p[axis]; });
+            Build(lo, mid, (axis + 1) % 3);
+            Build(mid + 1, hi, (axis + 1) % 3);
+        }
+    };
+    Builder builder{ places };
+    builder.Build(0, places.size(), 0);
+
+    IndexHeader header;
+    memcpy(header.magic, INDEX_MAGIC, 4);
+    header.version = INDEX_VERSION;
+    header.count = (uint32_t)places.size();
+    header.reserved = 0;
+    SourceIdentity(placesFile, header.sourceSize, header.sourceTime);
+    header.namesOffset = sizeof(IndexHeader) + places.size() * sizeof(KdNode);
+    header.namesSize = names.size();
+
+    out.resize(header.namesOffset + names.size());
+    memcpy(out.data(), &header, sizeof(header));
+    KdNode* nodes = (KdNode*)(out.data() + sizeof(IndexHeader));
+    for (size_t i = 0; i < places.size(); ++i) {
+        nodes[i].x = places[i].p[0];
+        nodes[i].y = places[i].p[1];
+        nodes[i].z = places[i].p[2];
+        nodes[i].name = places[i].name;
+    }
+    memcpy(out.data() + header.namesOffset, names.data(), names.size());
+    return true;
+}
+
+bool OfflineGeocoder::Attach(const uint8_t* data, size_t size) {
+    if (size < sizeof(IndexHeader)) return false;
+    IndexHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, INDEX_MAGIC, 4) != 0 || header.version != INDEX_VERSION) return false;
+    if (header.namesOffset != sizeof(IndexHeader) + (uint64_t)header.count * sizeof(KdNode)) return false;
+    if (header.namesOffset + header.namesSize > size || header.namesSize == 0) return false;
+    if (data[header.namesOffset + header.namesSize - 1] != '\0') return false;
+
+    m_nodes = (const KdNode*)(data + sizeof(IndexHeader));
+    m_names = (const char*)(data + header.namesOffset);
+    m_namesSize = (size_t)header.namesSize;
+    m_count = header.count;
+    return true;
+}
+
+bool OfflineGeocoder::Load(const fs::path& placesFile, std::string& error) {
+    fs::path indexFile = placesFile;
+    indexFile += ".kdx";
+
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    SourceIdentity(placesFile, sourceSize, sourceTime);
+
+    // Reuse the compiled index if it was built from this exact file
+    if (m_mapped.Open(indexFile) && m_mapped.size() >= sizeof(IndexHeader)) {
+        IndexHeader header;
+        memcpy(&header, m_mapped.data(), sizeof(header));
+        if (header.sourceSize == sourceSize && header.sourceTime == sourceTime && Attach(m_mapped.data(), m_mapped.size())) {
+            return true;
+        }
+    }
+    m_mapped.Close();
+
+    std::vector<uint8_t> index;
+    if (!BuildIndex(placesFile, index, error)) return false;
+
+    // Write to a temp file and rename, so a concurrent reader never maps a partial index
+    fs::path tempFile = indexFile;
+    tempFile += ".tmp";
+    {
+        std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+        out.write((const char*)index.data(), (std::streamsize)index.size());
+    }
+    std::error_code ec;
+    fs::rename(tempFile, indexFile, ec);
+    if (!ec && m_mapped.Open(indexFile) && Attach(m_mapped.data(), m_mapped.size())) {
+        return true;
+    }
+    fs::remove(tempFile, ec);
+
+    // Read-only location: keep the index in memory
+    m_mapped.Close();
+    m_memory.swap(index);
+    return Attach(m_memory.data(), m_memory.size());
+}
+
+void OfflineGeocoder::Search(uint32_t lo, uint32_t hi, int axis, const float q[3], uint32_t& best, float& bestDist) const {
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const KdNode& n = m_nodes[mid];
+        float dx = n.x - q[0], dy = n.y - q[1], dz = n.z - q[2];
+        float d = dx * dx + dy * dy + dz * dz;
+        if (d < bestDist) {
+            bestDist = d;
+            best = mid;
+        }
+
+        float split = axis == 0 ? n.x : (axis == 1 ? n.y : n.z);
+        float diff = q[axis] - split;
+        int next = (axis + 1) % 3;
+        // Near side first, then the far side only if the splitting plane is
+        // closer than the best match so far
+        if (diff < 0) {
+            Search(lo, mid, next, q, best, bestDist);
+            lo = mid + 1;
+        } else {
+            Search(mid + 1, hi, next, q, best, bestDist);
+            hi = mid;
+        }
+        if (diff * diff >= bestDist) return;
+        axis = next;
+    }
+}
+
+std::string OfflineGeocoder::Nearest(double lat, double lon) const {
+    if (m_count == 0) return "";
+    float q[3];
+    ToUnitSphere(lat, lon, q);
+
+    uint32_t best = m_count;
+    float bestDist = (float)m_maxChordSq;
+    Search(0, m_count, 0, q, best, bestDist);
+    if (best == m_count) return "";
+
+    uint32_t offset = m_nodes[best].name;
+    if (offset >= m_namesSize) return "";
+    return std::string(m_names + offset);
+}
@@ -0,0 +1,48 @@
+// offline_geocoder.h
+// Offline reverse geocoding against a GeoNames-style places file
+// (tab separated: geonameid, name, asciiname, alternatenames, latitude,
+// longitude, feature class, ...), e.g. cities1000.txt.
+//
+// On first use the places are compiled into a balanced k-d tree over unit
+// sphere coordinates and written next to the source as <file>.kdx; later runs
+// memory-map that index directly. Nodes are 16 bytes and stored in implicit
+// (median-split) order, so a query touches O(log n) cache lines.
+#pragma once
+
+#include "mapped_file.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class OfflineGeocoder {
+public:
+    // Places further away than this are not used as a location name.
+    explicit OfflineGeocoder(double maxDistanceKm = 30.0);
+
+    // Returns false (with a message in error) if the places file can't be read.
+    bool Load(const std::filesystem::path& placesFile, std::string& error);
+
+    // Name of the nearest place (UTF-8), or "" if none is within range.
+    std::string Nearest(double lat, double lon) const;
+
+    size_t PlaceCount() const { return m_count; }
+
+private:
+    struct KdNode {
+        float x, y, z;
+        uint32_t name;      // Offset into the name blob
+    };
+
+    static bool BuildIndex(const std::filesystem::path& placesFile, std::vector<uint8_t>& out, std::string& error);
+    bool Attach(const uint8_t* data, size_t size);
+    void Search(uint32_t lo, uint32_t hi, int axis, const float q[3], uint32_t& best, float& bestDist) const;
+
+    double m_maxChordSq;
+    MappedFile m_mapped;
+    std::vector<uint8_t> m_memory;  // Used when the index can't be written to disk
+    const KdNode* m_nodes = nullptr;
+    const char* m_names = nullptr;
+    size_t m_namesSize = 0;
+    uint32_t m_count = 0;
+};
@@ -0,0 +1,111 @@
+// record_log.cpp
+#include "record_log.h"
+#include "mapped_file.h"
+#include <vector>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+uint32_t Crc32(const void* data, size_t size, uint32_t crc) {
+    static uint32_t table[256];
+    static bool init = [] {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)init;
+
+    const uint8_t* p = (const uint8_t*)data;
+    crc ^= 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static std::FILE* OpenFile(const fs::path& path, const char* mode) {
+#ifdef _WIN32
+    std::wstring wmode(mode, mode + strlen(mode));
+    return _wfopen(path.c_str(), wmode.c_str());
+#else
+    return std::fopen(path.c_str(), mode);
+#endif
+}
+
+bool RecordLog::WriteHeader() {
+    uint8_t header[8];
+    memcpy(header, m_magic, 4);
+    PutLE32(header + 4, m_version);
+    return std::fwrite(header, 1, sizeof(header), m_file) == sizeof(header) && std::fflush(m_file) == 0;
+}
+
+bool RecordLog::Open(const fs::path& file, const char magic[4], uint32_t version, const RecordCallback& onRecord) {
+    Close();
+    m_path = file;
+    memcpy(m_magic, magic, 4);
+    m_version = version;
+
+    bool fresh = true;
+    size_t validEnd = 0;
+    size_t fileSize = 0;
+    {
+        MappedFile map;
+        if (map.Open(file)) {
+            const uint8_t* d = map.data();
+            size_t n = map.size();
+            fileSize = n;
+            if (n >= 4 && memcmp(d, magic, 4) != 0) return false;   // Not ours, leave it alone
+
+            if (n >= 8 && GetLE32(d + 4) == version) {
+                fresh = false;
+                size_t pos = 8;
+                while (pos + 8 <= n) {
+                    uint32_t size = GetLE32(d + pos);
+                    if (size > n - pos - 8) break;
+                    if (Crc32(d + pos + 4, size) != GetLE32(d + pos + 4 + size)) break;
+                    if (onRecord) onRecord(d + pos + 4, size);
+                    pos += 8 + (size_t)size;
+                }
+                validEnd = pos;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (fresh) {
+        m_file = OpenFile(file, "wb");
+        if (!m_file) return false;
+        if (!WriteHeader()) {
+            std::fclose(m_file);
+            m_file = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    if (validEnd < fileSize) {
+        std::error_code ec;
+        fs::resize_file(file, validEnd, ec);
+        if (ec) return false;
+    }
+    m_file = OpenFile(file, "ab");
+    return m_file != nullptr;
+}
+
+void RecordLog::Close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file) std::fclose(m_file);
+    m_file = nullptr;
+}
+
+bool RecordLog::Append(const void* data, size_t size) {
+    std::vector<uint8_t> record(size + 8);
+    PutLE32(record.data(), (uint32_t)size);
+    memcpy(record.data() + 4, data, size);
+    PutLE32(record.data() + 4 + size, Crc32(data, size));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file) return false;
+    return std::fwrite(record.data(), 1, record.size(), m_file) == record.size() && std::fflush(m_file) == 0;
+}
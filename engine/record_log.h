@@ -0,0 +1,68 @@
+// record_log.h
+// Append-only file of checksummed records, used for the engine's persistent
+// caches. Layout:
+//   header:  char magic[4], uint32 version
+//   record:  uint32 size, <size> payload bytes, uint32 crc32(payload)
+// The file is memory-mapped and replayed on open. A torn or corrupt tail (a
+// crash mid-append) fails its checksum and is truncated away, so appends are
+// crash-safe without a separate journal. Appends are flushed to the OS but
+// not fsync'ed: a power loss can drop the last records, never corrupt older
+// ones. Integers are little-endian.
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+class RecordLog {
+public:
+    using RecordCallback = std::function<void(const uint8_t* data, size_t size)>;
+
+    RecordLog() {}
+    ~RecordLog() { Close(); }
+    RecordLog(const RecordLog&) = delete;
+    RecordLog& operator=(const RecordLog&) = delete;
+
+    // Creates the file if needed, replays every valid record through onRecord
+    // and leaves the log open for appending. Returns false if the file can't
+    // be created or belongs to something else.
+    bool Open(const std::filesystem::path& file, const char magic[4], uint32_t version, const RecordCallback& onRecord);
+    void Close();
+    bool is_open() const { return m_file != nullptr; }
+
+    // Thread-safe. Each record is written with a single write and flushed.
+    bool Append(const void* data, size_t size);
+
+private:
+    bool WriteHeader();
+
+    std::FILE* m_file = nullptr;
+    std::mutex m_mutex;
+    char m_magic[4] = { 0, 0, 0, 0 };
+    uint32_t m_version = 0;
+    std::filesystem::path m_path;
+};
+
+// CRC-32 (IEEE, as in zlib/ZIP). Pass the previous result as crc to continue
+// a running checksum.
+uint32_t Crc32(const void* data, size_t size, uint32_t crc = 0);
+
+inline void PutLE32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+inline uint32_t GetLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline void PutLE64(uint8_t* p, uint64_t v) {
+    PutLE32(p, (uint32_t)v);
+    PutLE32(p + 4, (uint32_t)(v >> 32));
+}
+
+inline uint64_t GetLE64(const uint8_t* p) {
+    return (uint64_t)GetLE32(p) | ((uint64_t)GetLE32(p + 4) << 32);
+}
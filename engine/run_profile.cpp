@@ -0,0 +1,190 @@
+// run_profile.cpp
+#include "run_profile.h"
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+
+static const char* const PROBE_NAMES[PROBE_COUNT] = {
+    "stat", "read_ahead", "metadata", "geocode_lookup", "geocode_wait", "geocode_http",
+    "dedup", "create_dirs", "name_probe", "copy", "extract", "rename", "manifest" };
+
+// Unique across profilers, so a thread's cached registration can't outlive its run
+static std::atomic<uint64_t> g_runIds{0};
+
+const char* ProbeName(Probe probe) {
+    return PROBE_NAMES[(int)probe];
+}
+
+static int BucketFor(uint64_t nanos) {
+    if (nanos < 4) return (int)nanos;
+    int log2 = 2;
+    while ((nanos >> (log2 + 1)) != 0) log2++;
+    int index = log2 * 4 + (int)((nanos >> (log2 - 2)) & 3);
+    return std::min(index, RunProfiler::HISTOGRAM_BUCKETS - 1);
+}
+
+// Middle of the bucket's range, in nanoseconds
+static double BucketValue(int index) {
+    if (index < 4) return index;
+    int log2 = index / 4, sub = index % 4;
+    return (4.5 + sub) * (double)(1ULL << (log2 - 2));
+}
+
+static void Add(std::atomic<uint64_t>& counter, uint64_t value) {
+    // Only the owning thread writes
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static std::string JsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// --- RECORDING ---
+
+void RunProfiler::Begin(bool trace, size_t maxEvents) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_threads.clear();
+    m_run = ++g_runIds;
+    m_start = std::chrono::steady_clock::now();
+    m_trace = trace;
+    m_maxEvents = maxEvents;
+    m_dropped = 0;
+}
+
+RunProfiler::ThreadProfile* RunProfiler::Local() {
+    thread_local uint64_t t_run = 0;
+    thread_local ThreadProfile* t_profile = nullptr;
+    if (t_run == m_run && t_profile) return t_profile;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unique_ptr<ThreadProfile> profile(new ThreadProfile());
+    profile->id = (int)m_threads.size() + 1;
+    profile->name = "thread " + std::to_string(profile->id);
+    t_profile = profile.get();
+    t_run = m_run;
+    m_threads.push_back(std::move(profile));
+    return t_profile;
+}
+
+void RunProfiler::NameThread(const std::string& name) {
+    ThreadProfile* profile = Local();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    profile->name = name;
+}
+
+void RunProfiler::Record(Probe probe, std::chrono::steady_clock::time_point start, uint64_t bytes) {
+    auto now = std::chrono::steady_clock::now();
+    uint64_t nanos = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+    ThreadProfile* profile = Local();
+    Counters& counters = profile->probes[(int)probe];
+    Add(counters.calls, 1);
+    Add(counters.nanos, nanos);
+    Add(counters.bytes, bytes);
+    Add(counters.buckets[BucketFor(nanos)], 1);
+    if (nanos > counters.maxNanos.load(std::memory_order_relaxed)) counters.maxNanos.store(nanos, std::memory_order_relaxed);
+
+    if (m_trace) {
+        if (profile->events.size() < m_maxEvents) {
+            int64_t offset = std::chrono::duration_cast<std::chrono::nanoseconds>(start - m_start).count();
+            profile->events.push_back(TraceEvent{ offset, (int64_t)nanos, probe });
+        } else {
+            m_dropped++;
+        }
+    }
+}
+
+// --- REPORTING ---
+
+ProbeStats RunProfiler::Summarize(Probe probe, const std::vector<const Counters*>& counters) {
+    ProbeStats stats;
+    stats.name = ProbeName(probe);
+    uint64_t nanos = 0, maxNanos = 0;
+    std::vector<uint64_t> buckets(HISTOGRAM_BUCKETS, 0);
+    for (const Counters* c : counters) {
+        stats.calls += c->calls.load(std::memory_order_relaxed);
+        stats.bytes += c->bytes.load(std::memory_order_relaxed);
+        nanos += c->nanos.load(std::memory_order_relaxed);
+        maxNanos = std::max(maxNanos, c->maxNanos.load(std::memory_order_relaxed));
+        for (int b = 0; b < HISTOGRAM_BUCKETS; ++b) buckets[b] += c->buckets[b].load(std::memory_order_relaxed);
+    }
+    stats.seconds = nanos / 1e9;
+    stats.max = maxNanos / 1e9;
+
+    uint64_t total = 0;
+    for (uint64_t count : buckets) total += count;
+    if (total == 0) return stats;
+    const double quantiles[3] = { 0.50, 0.90, 0.99 };
+    double* results[3] = { &stats.p50, &stats.p90, &stats.p99 };
+    uint64_t seen = 0;
+    int q = 0;
+    for (int b = 0; b < HISTOGRAM_BUCKETS && q < 3; ++b) {
+        seen += buckets[b];
+        while (q < 3 && seen >= (uint64_t)(quantiles[q] * total + 0.5) && seen > 0) {
+            *results[q] = std::min(BucketValue(b) / 1e9, stats.max);
+            q++;
+        }
+    }
+    return stats;
+}
+
+std::vector<ProbeStats> RunProfiler::GetProbeStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<ProbeStats> result;
+    for (int p = 0; p < PROBE_COUNT; ++p) {
+        std::vector<const Counters*> counters;
+        for (const auto& thread : m_threads) counters.push_back(&thread->probes[p]);
+        result.push_back(Summarize((Probe)p, counters));
+    }
+    return result;
+}
+
+std::vector<RunProfiler::ThreadStats> RunProfiler::GetThreadStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<ThreadStats> result;
+    for (const auto& thread : m_threads) {
+        ThreadStats stats;
+        stats.name = thread->name;
+        for (int p = 0; p < PROBE_COUNT; ++p) {
+            if (thread->probes[p].calls.load(std::memory_order_relaxed) == 0) continue;
+            stats.probes.push_back(Summarize((Probe)p, { &thread->probes[p] }));
+        }
+        result.push_back(std::move(stats));
+    }
+    return result;
+}
+
+// Trace Event Format: one complete ("X") event per probe call, timestamps
+// in microseconds, plus the thread names as metadata events.
+bool RunProfiler::WriteChromeTrace(const std::filesystem::path& file) const {
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    char line[256];
+    for (const auto& thread : m_threads) {
+        out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->id
+            << ",\"args\":{\"name\":" << JsonString(thread->name) << "}}";
+        first = false;
+        for (const TraceEvent& event : thread->events) {
+            snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                     ProbeName(event.probe), thread->id, event.start / 1000.0, event.duration / 1000.0);
+            out << line;
+        }
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
@@ -0,0 +1,127 @@
+// run_profile.h
+// Hot-path instrumentation for a sort run. Each probe (a step like metadata
+// decode, directory creation or the copy itself) is timed with a ProfileScope;
+// every thread records into its own counters and latency histogram, so the
+// only shared write is registering a thread the first time it shows up.
+// Optionally every probe is also kept as an event for a Chrome trace
+// (chrome://tracing, Perfetto).
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+enum class Probe {
+    Stat,           // Identity stat and manifest check
+    ReadAhead,      // Batched header reads (io_uring)
+    Metadata,       // Header read and EXIF decode
+    GeocodeLookup,  // Cache and offline lookups
+    GeocodeWait,    // Resolver waiting out the rate limit
+    GeocodeHttp,    // Resolver request
+    Dedup,          // Content claim (hashing where sizes collide)
+    CreateDirs,
+    NameProbe,      // Finding a free target name, comparing same-named files
+    Copy,           // Copy, move or link into the target
+    Extract,        // Archive member written next to its target
+    Rename,         // Extracted member renamed into place
+    Manifest,
+};
+const int PROBE_COUNT = 13;
+
+const char* ProbeName(Probe probe);
+
+// One probe over the whole run, all threads together.
+struct ProbeStats {
+    std::string name;
+    uint64_t calls = 0;
+    double seconds = 0.0;
+    uint64_t bytes = 0;             // Read or written by the step
+    double p50 = 0.0;               // Latency quantiles in seconds, from
+    double p90 = 0.0;               // the histogram (within 1/8)
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+class RunProfiler {
+public:
+    // Log-linear histogram: four buckets per power of two nanoseconds
+    static const int HISTOGRAM_BUCKETS = 4 * 42;
+
+    struct ThreadStats {
+        std::string name;
+        std::vector<ProbeStats> probes;     // Only those it called
+    };
+
+    // Starts a run: forgets everything recorded so far. With trace, every
+    // probe is also kept as an event, up to maxEvents per thread.
+    void Begin(bool trace, size_t maxEvents = 1000000);
+
+    // Names the calling thread in the profile and trace.
+    void NameThread(const std::string& name);
+
+    void Record(Probe probe, std::chrono::steady_clock::time_point start, uint64_t bytes);
+
+    std::vector<ProbeStats> GetProbeStats() const;
+    std::vector<ThreadStats> GetThreadStats() const;
+    bool Tracing() const { return m_trace; }
+    size_t DroppedEvents() const { return m_dropped; }
+
+    // Only once the threads that recorded have finished.
+    bool WriteChromeTrace(const std::filesystem::path& file) const;
+
+private:
+    struct Counters {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> nanos{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> maxNanos{0};
+        std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS] = {};
+    };
+
+    struct TraceEvent {
+        int64_t start;              // Nanoseconds since Begin
+        int64_t duration;
+        Probe probe;
+    };
+
+    struct ThreadProfile {
+        std::string name;
+        int id = 0;
+        Counters probes[PROBE_COUNT];
+        std::vector<TraceEvent> events;
+    };
+
+    ThreadProfile* Local();
+    static ProbeStats Summarize(Probe probe, const std::vector<const Counters*>& counters);
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<ThreadProfile>> m_threads;
+    uint64_t m_run = 0;
+    std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+    bool m_trace = false;
+    size_t m_maxEvents = 0;
+    std::atomic<size_t> m_dropped{0};
+};
+
+// Times the enclosing block as one call of probe. Set bytes before it ends
+// for steps that read or write data.
+class ProfileScope {
+public:
+    ProfileScope(RunProfiler& profiler, Probe probe)
+        : m_profiler(profiler), m_probe(probe), m_start(std::chrono::steady_clock::now()) {}
+    ~ProfileScope() { m_profiler.Record(m_probe, m_start, bytes); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    uint64_t bytes = 0;
+
+private:
+    RunProfiler& m_profiler;
+    Probe m_probe;
+    std::chrono::steady_clock::time_point m_start;
+};
@@ -0,0 +1,61 @@
+// safe_queue.h
+#pragma once
+
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+// --- THREAD-SAFE QUEUE ---
+template<typename T>
+class SafeQueue {
+private:
+    std::queue<T> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_finished = false;
+
+public:
+    void push(T item) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push(std::move(item));
+        }
+        m_cond.notify_one();
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this]() { return !m_queue.empty() || m_finished; });
+        if (m_queue.empty()) return false;
+        item = std::move(m_queue.front());
+        m_queue.pop();
+        return true;
+    }
+
+    // Waits for the first item like pop, then takes whatever else is queued,
+    // up to max items in all.
+    bool pop_batch(std::vector<T>& items, size_t max) {
+        items.clear();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this]() { return !m_queue.empty() || m_finished; });
+        while (!m_queue.empty() && items.size() < max) {
+            items.push_back(std::move(m_queue.front()));
+            m_queue.pop();
+        }
+        return !items.empty();
+    }
+
+    void set_finished() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_finished = true;
+        }
+        m_cond.notify_all();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_queue.size();
+    }
+};
@@ -0,0 +1,1094 @@
+// sorter_engine.cpp
+#include "sorter_engine.h"
+#include "file_metadata.h"
+#include "dir_walker.h"
+#include "content_hash.h"
+#include "exif_reader.h"
+#include "io_ring.h"
+#include <thread>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+// --- UTILITIES ---
+
+// Random name for files being written into the target
+static std::string GenerateTempName() {
+    static const char alphanum[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<> dis(0, sizeof(alphanum) - 2);
+    std::string s = ".media-sorter-";
+    for (int i = 0; i < 8; ++i) {
+        s += alphanum[dis(gen)];
+    }
+    return s;
+}
+
+// Writes the rest of a member to dest, after the bytes already read from it.
+static bool ExtractMember(ZipMemberReader& reader, const std::vector<uint8_t>& head, const fs::path& dest) {
+    std::ofstream out(dest, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out.write((const char*)head.data(), (std::streamsize)head.size());
+
+    std::vector<uint8_t> buffer(256 * 1024);
+    long n;
+    while ((n = reader.Read(buffer.data(), buffer.size())) > 0) {
+        out.write((const char*)buffer.data(), n);
+    }
+    out.close();
+    if (n < 0 || !out) {
+        std::error_code ec;
+        fs::remove(dest, ec);
+        return false;
+    }
+    return true;
+}
+
+// Reads up to head.size() bytes, resizing head to what was read.
+static bool ReadHead(ZipMemberReader& reader, std::vector<uint8_t>& head) {
+    size_t got = 0;
+    while (got < head.size()) {
+        long n = reader.Read(head.data() + got, head.size() - got);
+        if (n < 0) return false;
+        if (n == 0) break;
+        got += (size_t)n;
+    }
+    head.resize(got);
+    return true;
+}
+
+// The member's timestamp from the archive, local time as stored
+static bool MemberDate(const ZipEntry& entry, MediaDate& date) {
+    if (entry.dosDate == 0) return false;
+    date.year = 1980 + (entry.dosDate >> 9);
+    date.month = (entry.dosDate >> 5) & 15;
+    date.day = entry.dosDate & 31;
+    date.hour = entry.dosTime >> 11;
+    date.minute = (entry.dosTime >> 5) & 63;
+    date.second = (entry.dosTime & 31) * 2;
+    return date.month >= 1 && date.month <= 12 && date.day >= 1;
+}
+
+// Files the scanner may get ahead of the metadata stage
+static const size_t QUEUE_CAPACITY = 4096;
+// Files read but not placed yet; members hold their decoder and header
+static const size_t PLACE_QUEUE_CAPACITY = 256;
+
+// Files sorted at a time by the disk order scheduler: enough to turn a
+// folder's worth of seeks into one sweep, few enough for an early first copy
+static const size_t DISK_ORDER_BATCH = 1024;
+
+// Threads per stage with adaptive concurrency; the stage limits stay below it
+static const int MAX_ADAPTIVE_WORKERS = 16;
+
+static std::string MemberFileName(const ZipEntry& entry) {
+    size_t slash = entry.name.find_last_of("/\\");
+    return slash == std::string::npos ? entry.name : entry.name.substr(slash + 1);
+}
+
+// Members of an archive are sorted by the workers straight from the mapped
+// ZIP, in parallel. Whoever finishes the last one records the archive in the
+// manifest; a nested archive counts as one member of its parent until all of
+// its own members are done.
+struct SorterEngine::ArchiveJob {
+    std::unique_ptr<ZipArchive> zip;
+    std::string name;               // For messages: source file name, or parent/member
+    fs::path source;                // Top level only: recorded in the manifest when done
+    uint64_t size = 0;
+    int64_t modifiedTime = 0;
+    bool haveIdentity = false;
+    std::shared_ptr<ArchiveJob> parent;
+    fs::path tempFile;              // A nested archive's extracted copy
+    MediaDate defaultDate;          // For members without a timestamp
+    std::atomic<int> remaining{1};  // Members not done yet, plus one while dispatching
+    std::atomic<bool> failed{false};
+
+    bool opened = false;
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    int members = 0;
+    uint64_t bytes = 0;
+    std::atomic<int> copied{0};
+    std::atomic<int> duplicates{0};
+    std::atomic<int> skipped{0};
+
+    ~ArchiveJob() {
+        zip.reset();
+        if (!tempFile.empty()) {
+            std::error_code ec;
+            fs::remove(tempFile, ec);
+        }
+    }
+};
+
+// --- ENGINE ---
+
+SorterEngine::SorterEngine(const SortOptions& options, SortProgressListener* listener)
+    : m_options(options), m_listener(listener) {
+}
+
+SortStats SorterEngine::Stats() const {
+    SortStats stats;
+    stats.totalFiles = m_totalFiles;
+    stats.processed = m_processedCount;
+    stats.copied = m_successCount;
+    stats.skipped = m_skippedCount;
+    stats.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+    stats.scanSeconds = m_scanComplete ? m_scanSeconds : stats.elapsedSeconds;
+    long long firstCopy = m_firstCopyNanos;
+    stats.firstCopySeconds = firstCopy < 0 ? -1.0 : firstCopy / 1e9;
+    stats.geocodeCacheHits = m_geocoder.CacheHits();
+    stats.geocodeCacheMisses = m_geocoder.CacheMisses();
+    stats.geocodeRequests = m_geocoder.NetworkRequests();
+    stats.geocodeLookupsSaved = m_geocoder.LookupsSaved();
+    stats.duplicates = m_duplicateCount;
+    stats.unchanged = m_unchangedCount;
+    stats.dedupBytesRead = m_dedup.BytesHashed() + m_compareBytes;
+    stats.geocodeDeferred = m_deferredCount;
+    std::lock_guard<std::mutex> lock(m_archiveMutex);
+    stats.archives = m_archiveStats;
+    if (m_copier) stats.copies = m_copier->GetStats();
+    stats.moved = m_placedBy[(int)PlacementMode::Move];
+    stats.hardlinked = m_placedBy[(int)PlacementMode::Hardlink];
+    stats.symlinked = m_placedBy[(int)PlacementMode::Symlink];
+    stats.bytesPlaced = m_placedBytes;
+    stats.workerThreads = m_workerThreads;
+    for (int i = 0; i < WORK_STAGE_COUNT; ++i) {
+        const StageCounters& counters = m_stages[i];
+        StageStats stage;
+        stage.name = WorkStageName((WorkStage)i);
+        stage.threads = m_workerThreads;
+        stage.items = counters.items;
+        stage.busySeconds = counters.busyNanos / 1e9;
+        stage.blockedSeconds = counters.blockedNanos / 1e9;
+        stage.peakQueue = counters.peakQueue;
+        stage.queueCapacity = i == (int)WorkStage::Metadata ? QUEUE_CAPACITY : PLACE_QUEUE_CAPACITY;
+        stats.stages.push_back(stage);
+    }
+    stats.adaptiveConcurrency = m_options.threads < 1;
+    stats.concurrency = m_concurrency.GetStats();
+    stats.profile = m_profiler.GetProbeStats();
+    for (int i = 0; i < MEDIA_FORMAT_COUNT; ++i) {
+        const FormatCounters& counters = m_formats[i];
+        FormatStats format;
+        format.name = MediaFormatName((MediaFormat)i);
+        format.files = counters.files;
+        format.dated = counters.dated;
+        format.located = counters.located;
+        format.seconds = counters.nanos / 1e9;
+        format.bytesRead = counters.bytesRead;
+        stats.formats.push_back(format);
+    }
+    // Reflinks share the source's extents, nothing is written
+    stats.bytesWritten = m_extractedBytes;
+    for (int m = 0; m < COPY_METHOD_COUNT; ++m) {
+        if (m != (int)CopyMethod::Reflink) stats.bytesWritten += stats.copies.bytes[m];
+    }
+    return stats;
+}
+
+void SorterEngine::Log(const std::string& msg) {
+    if (m_listener) m_listener->OnStatus(msg);
+}
+
+void SorterEngine::AddFiles(int count) {
+    m_totalFiles += count;
+    int estimate = (m_estimatedTotal += count);
+    if (m_listener) m_listener->OnTotal(estimate, m_scanComplete);
+}
+
+void SorterEngine::CountProcessed() {
+    int processed = ++m_processedCount;
+    if (m_listener) m_listener->OnProgress(processed, m_estimatedTotal);
+}
+
+// Opens the archive and queues its members for the workers. They join the
+// totals now, so progress keeps moving while the archive is worked off.
+void SorterEngine::ProcessZip(const fs::path& zipPath, const std::shared_ptr<ArchiveJob>& job) {
+    std::string error;
+    job->zip.reset(new ZipArchive());
+    if (!job->zip->Open(zipPath, error)) {
+        m_skippedCount++;
+        Log("Failed to read ZIP " + job->name + ": " + error);
+        MemberDone(job, false);
+        return;
+    }
+    job->opened = true;
+    if (!job->parent) GetFileModifiedDate(zipPath, job->defaultDate);
+    Log("Reading ZIP: " + job->name);
+
+    const std::vector<ZipEntry>& entries = job->zip->Entries();
+    for (const ZipEntry& entry : entries) {
+        if (entry.IsDirectory()) continue;
+        job->members++;
+        job->bytes += entry.uncompressedSize;
+    }
+    AddFiles(job->members);
+
+    for (size_t i = 0; i < entries.size() && !m_stopRequested; ++i) {
+        const ZipEntry& entry = entries[i];
+        if (entry.IsDirectory()) continue;
+        if (!entry.IsSupported()) {
+            CountProcessed();
+            m_skippedCount++;
+            job->skipped++;
+            job->failed = true;
+            Log("Skipping " + std::string(entry.IsEncrypted() ? "encrypted" : "unsupported") +
+                " ZIP member: " + job->name + "/" + entry.name);
+            continue;
+        }
+        job->remaining++;
+        m_inFlight++;
+        WorkItem item;
+        item.archive = job;
+        item.member = i;
+        m_metaQueue->requeue(std::move(item));
+        m_stages[(int)WorkStage::Metadata].NoteQueue(m_metaQueue->size());
+    }
+    MemberDone(job, !m_stopRequested);
+}
+
+void SorterEngine::MemberDone(const std::shared_ptr<ArchiveJob>& job, bool ok) {
+    if (!ok) job->failed = true;
+    if (--job->remaining > 0) return;
+
+    if (job->opened && !m_stopRequested) {
+        ArchiveStats stats;
+        stats.name = job->name;
+        stats.members = job->members;
+        stats.copied = job->copied;
+        stats.duplicates = job->duplicates;
+        stats.skipped = job->skipped;
+        stats.bytes = job->bytes;
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job->started).count();
+        Log("Finished ZIP: " + stats.name + " (" + std::to_string(stats.members) + " files, " +
+            std::to_string(stats.copied) + " copied, " + std::to_string(stats.duplicates) + " duplicates, " +
+            std::to_string(stats.skipped) + " skipped)");
+        std::lock_guard<std::mutex> lock(m_archiveMutex);
+        m_archiveStats.push_back(std::move(stats));
+    }
+
+    if (job->parent) {
+        MemberDone(job->parent, !job->failed);
+    } else if (!job->failed && !m_stopRequested && job->haveIdentity && m_manifest.is_open()) {
+        m_manifest.Record(job->source, job->size, job->modifiedTime, 0, fs::path());
+    }
+}
+
+// False if the location has to come from the geocoding server
+bool SorterEngine::LookupLocation(FileMetadata& meta) {
+    ProfileScope probe(m_profiler, Probe::GeocodeLookup);
+    return m_geocoder.Lookup(meta.latitude, meta.longitude, meta.location);
+}
+
+void SorterEngine::CreateDirectories(const fs::path& dir) {
+    ProfileScope probe(m_profiler, Probe::CreateDirs);
+    fs::create_directories(dir);
+}
+
+// Parks a file until the resolver reports back on its location. Returns
+// false if the location turned up in the meantime (then it's in meta).
+bool SorterEngine::Park(WorkItem& item) {
+    std::lock_guard<std::mutex> lock(m_parkMutex);
+    // The resolver stores its result before it takes m_parkMutex
+    if (m_geocoder.Peek(item.meta.latitude, item.meta.longitude, item.meta.location)) return false;
+    double lat = item.meta.latitude, lon = item.meta.longitude;
+    m_parked[Geocoder::KeyFor(lat, lon)].push_back(std::move(item));
+    m_deferredCount++;
+    m_geocoder.Request(lat, lon);
+    return true;
+}
+
+// Metadata stage for a source file: reads its metadata and hands it on to
+// the copy stage, unless its location still has to come from the geocoding
+// server: then the file is parked until the resolver reports back.
+// With prefetched, the manifest check is done and the header already read.
+SorterEngine::Outcome SorterEngine::ProcessFile(WorkItem& item, Prefetched* prefetched) {
+    if (m_stopRequested) return Outcome::Done;
+
+    const fs::path& filePath = item.path;
+    try {
+        // Sorted by an earlier run and untouched since: one stat, nothing else
+        uint64_t size = 0;
+        int64_t modifiedTime = 0;
+        uint64_t device = 0;
+        bool haveIdentity = true;
+        if (prefetched) {
+            size = prefetched->size;
+            modifiedTime = prefetched->modifiedTime;
+            device = prefetched->device;
+        } else {
+            // The stat the file's identity, date and copy all come from
+            ProfileScope probe(m_profiler, Probe::Stat);
+            item.source.reset(new SourceFile());
+            haveIdentity = item.source->Stat(filePath);
+            size = item.source->size();
+            modifiedTime = item.source->modified_time();
+            device = item.source->device();
+            if (haveIdentity && m_manifest.is_open() && m_manifest.IsUnchanged(filePath, size, modifiedTime)) {
+                m_unchangedCount++;
+                CountProcessed();
+                return Outcome::Done;
+            }
+        }
+
+        CountProcessed();
+        Log("Processing: " + filePath.filename().u8string());
+
+        MediaFormat format = MediaFormat::Unknown;
+        auto parseStart = std::chrono::steady_clock::now();
+        uint64_t bytesRead = 0;
+        if (prefetched) {
+            // The header was read (and counted) by the batch
+            ProfileScope probe(m_profiler, Probe::Metadata);
+            MediaDate modified;
+            DateFromModifiedTime(modifiedTime, modified);
+            item.meta = GetBufferMetadata(prefetched->head.data(), prefetched->head.size(), modified, &format);
+            bytesRead = prefetched->head.size();
+            // A video's moov can sit behind gigabytes of sample data
+            if (format != MediaFormat::Zip && NeedsWholeFile(prefetched->head.data(), prefetched->head.size(), item.meta)) {
+                uint64_t more = 0;
+                item.meta = GetFileMetadata(filePath, &format, &more);
+                probe.bytes = more;
+                bytesRead += more;
+            }
+        } else {
+            // Opened once: the copy stage reads on from the same descriptor
+            AdaptiveLimit::Permit permit(m_concurrency.For(WorkStage::Metadata, device));
+            AdaptiveLimit::Permit reader(m_concurrency.Readers(device));
+            ProfileScope probe(m_profiler, Probe::Metadata);
+            if (haveIdentity && item.source->Open()) {
+                item.meta = GetFileMetadata(*item.source, &format, &bytesRead);
+            } else {
+                item.source.reset();
+                item.meta = GetFileMetadata(filePath, &format, &bytesRead);
+            }
+            probe.bytes = bytesRead;
+            permit.Done(1);
+        }
+
+        // An archive, whatever its name: counts as one file itself, plus its members
+        if (format == MediaFormat::Zip) {
+            item.source.reset(); // Mapped by path
+            CountFormat(format, parseStart, bytesRead, FileMetadata());
+            auto job = std::make_shared<ArchiveJob>();
+            job->name = filePath.filename().u8string();
+            job->source = filePath;
+            job->size = size;
+            job->modifiedTime = modifiedTime;
+            job->haveIdentity = haveIdentity;
+            ProcessZip(filePath, job);
+            return Outcome::Done;
+        }
+        CountFormat(format, parseStart, bytesRead, item.meta);
+        item.meta.size = size;
+        item.meta.modifiedTime = modifiedTime;
+        item.meta.device = device;
+
+        if (item.meta.hasGps && !LookupLocation(item.meta)) {
+            // Any number of files may wait: not with a descriptor each
+            item.source.reset();
+            if (Park(item)) return Outcome::Parked;
+        }
+        return Outcome::ToPlace;
+    } catch (const std::exception& e) {
+        m_skippedCount++;
+        Log(std::string("Error: ") + e.what());
+    } catch (...) {
+        m_skippedCount++;
+        Log("Unknown error processing file.");
+    }
+    return Outcome::Done;
+}
+
+// Metadata stage for an archive member: the EXIF header is parsed from its
+// first decompressed bytes. The decoder travels on with the item, so the
+// copy stage streams the rest without decompressing the head again.
+SorterEngine::Outcome SorterEngine::ProcessMember(WorkItem& item) {
+    if (m_stopRequested) return Outcome::Done;
+
+    std::shared_ptr<ArchiveJob> job = item.archive;
+    const ZipEntry& entry = job->zip->Entries()[item.member];
+    std::string displayName = job->name + "/" + entry.name;
+    try {
+        CountProcessed();
+        Log("Processing: " + displayName);
+
+        ProfileScope probe(m_profiler, Probe::Metadata);
+        item.reader.reset(new ZipMemberReader());
+        if (!item.reader->Open(*job->zip, entry)) throw std::runtime_error("Corrupt ZIP member: " + displayName);
+        item.head.resize(entry.uncompressedSize < exif::HEADER_WINDOW ? (size_t)entry.uncompressedSize : exif::HEADER_WINDOW);
+        if (!ReadHead(*item.reader, item.head)) throw std::runtime_error("Corrupt ZIP member: " + displayName);
+        probe.bytes = item.head.size();
+
+        if (SniffFormat(item.head.data(), item.head.size()) == MediaFormat::Zip) {
+            // Nested archive: needs random access, so it goes to a temp file
+            CountFormat(MediaFormat::Zip, std::chrono::steady_clock::now(), 0, FileMetadata());
+            auto nested = std::make_shared<ArchiveJob>();
+            nested->name = displayName;
+            nested->parent = job;
+            nested->defaultDate = job->defaultDate;
+            nested->tempFile = m_options.targetPath / (GenerateTempName() + ".zip");
+            ProfileScope extract(m_profiler, Probe::Extract);
+            if (!ExtractMember(*item.reader, item.head, nested->tempFile)) {
+                nested->tempFile.clear();
+                throw std::runtime_error("Corrupt ZIP member: " + displayName);
+            }
+            extract.bytes = entry.uncompressedSize;
+            ProcessZip(nested->tempFile, nested);
+            return Outcome::Done; // Done for the parent once the nested members are
+        }
+
+        MediaDate date = job->defaultDate;
+        MemberDate(entry, date);
+        MediaFormat format = MediaFormat::Unknown;
+        auto parseStart = std::chrono::steady_clock::now();
+        item.meta = GetBufferMetadata(item.head.data(), item.head.size(), date, &format);
+        CountFormat(format, parseStart, 0, item.meta);
+        item.meta.size = entry.uncompressedSize;
+
+        if (item.meta.hasGps && !LookupLocation(item.meta)) {
+            // Waiting members keep the archive mapped, but not their decoder
+            item.reader.reset();
+            item.head = std::vector<uint8_t>();
+            if (Park(item)) return Outcome::Parked;
+        }
+        return Outcome::ToPlace;
+    } catch (const std::exception& e) {
+        Log(std::string("Error: ") + e.what());
+    } catch (...) {
+        Log("Unknown error processing file.");
+    }
+    m_skippedCount++;
+    job->skipped++;
+    MemberDone(job, false);
+    return Outcome::Done;
+}
+
+// Streams the member into a hidden file in its target folder, so placing it
+// is a rename on the same volume.
+SorterEngine::PlaceResult SorterEngine::PlaceMember(const WorkItem& item, ZipMemberReader& reader, const std::vector<uint8_t>& head) {
+    const ZipEntry& entry = item.archive->zip->Entries()[item.member];
+    fs::path targetDir = TargetDirFor(item.meta);
+    CreateDirectories(targetDir);
+
+    fs::path staged = targetDir / fs::u8path(GenerateTempName());
+    staged += fs::u8path(MemberFileName(entry)).extension();
+    AdaptiveLimit::Permit permit(m_concurrency.For(WorkStage::Copy, m_targetDevice));
+    {
+        ProfileScope probe(m_profiler, Probe::Extract);
+        if (!ExtractMember(reader, head, staged)) {
+            throw std::runtime_error("Corrupt ZIP member: " + item.archive->name + "/" + entry.name);
+        }
+        probe.bytes = entry.uncompressedSize;
+    }
+    permit.Done(entry.uncompressedSize);
+    return PlaceFile(staged, item.meta, true);
+}
+
+// Copy stage for an archive member. One that waited for its location is
+// decoded from the start again.
+void SorterEngine::PlaceArchiveMember(WorkItem& item) {
+    std::shared_ptr<ArchiveJob> job = item.archive;
+    PlaceResult result = PlaceResult::Failed;
+    try {
+        if (!item.reader) {
+            const ZipEntry& entry = job->zip->Entries()[item.member];
+            item.reader.reset(new ZipMemberReader());
+            item.head.clear();
+            if (!item.reader->Open(*job->zip, entry)) throw std::runtime_error("Corrupt ZIP member: " + job->name + "/" + entry.name);
+        }
+        result = PlaceMember(item, *item.reader, item.head);
+    } catch (const std::exception& e) {
+        m_skippedCount++;
+        Log(std::string("Error: ") + e.what());
+    } catch (...) {
+        m_skippedCount++;
+        Log("Unknown error processing file.");
+    }
+    item.reader.reset();
+    if (result == PlaceResult::Copied) job->copied++;
+    else if (result == PlaceResult::Duplicate) job->duplicates++;
+    else job->skipped++;
+    MemberDone(job, result != PlaceResult::Failed);
+}
+
+fs::path SorterEngine::TargetDirFor(const FileMetadata& meta) const {
+    // Target/YYYY/YYYY-MM/
+    std::ostringstream ssMonth;
+    ssMonth << meta.date.year << "-" << std::setw(2) << std::setfill('0') << meta.date.month;
+    return m_options.targetPath / std::to_string(meta.date.year) / ssMonth.str();
+}
+
+// Places a source file by copying it. A staged file (an extracted archive
+// member already inside the target) is renamed into place instead, or
+// deleted if it turns out to be a duplicate. source, if given, is the file
+// opened by the metadata stage: hashes and the copy read through it.
+SorterEngine::PlaceResult SorterEngine::PlaceFile(const fs::path& filePath, const FileMetadata& meta, bool staged,
+                                                  SourceFile* source) {
+    DedupIndex::Ticket ticket;
+    bool claimed = false;
+    try {
+        fs::path ext = filePath.extension();
+
+        // Identical content anywhere in this run
+        fs::path original;
+        bool duplicate;
+        {
+            ProfileScope probe(m_profiler, Probe::Dedup);
+            duplicate = m_dedup.Claim(filePath, meta.size, ticket, original, source);
+        }
+        if (duplicate) {
+            m_skippedCount++;
+            m_duplicateCount++;
+            if (staged) {
+                fs::remove(filePath);
+                return PlaceResult::Duplicate;
+            }
+            // Remembered as placed where its twin went, once that is in the target
+            fs::path rel = original.lexically_relative(m_options.targetPath);
+            if (m_manifest.is_open() && !rel.empty() && *rel.begin() != "..") {
+                ProfileScope probe(m_profiler, Probe::Manifest);
+                m_manifest.Record(filePath, meta.size, meta.modifiedTime, 0, original);
+            }
+            return PlaceResult::Duplicate;
+        }
+        claimed = true;
+
+        // Build Target Path (V2)
+        fs::path targetDir = TargetDirFor(meta);
+
+        // Filename: YYYY-MM-DD HH-mm-ss [Location].ext
+        std::ostringstream ssName;
+        ssName << meta.date.year << "-"
+               << std::setw(2) << std::setfill('0') << meta.date.month << "-"
+               << std::setw(2) << std::setfill('0') << meta.date.day << " "
+               << std::setw(2) << std::setfill('0') << meta.date.hour << "-"
+               << std::setw(2) << std::setfill('0') << meta.date.minute << "-"
+               << std::setw(2) << std::setfill('0') << meta.date.second;
+
+        if (!meta.location.empty()) {
+            ssName << " " << meta.location;
+        }
+
+        std::string baseName = ssName.str();
+
+        CreateDirectories(targetDir);
+
+        fs::path targetFile = targetDir / fs::u8path(baseName);
+        targetFile += ext;
+        int dup = 0;
+        bool isDuplicate = false;
+
+        PlacementMode used = PlacementMode::Copy;
+        while (true) {
+            {
+                ProfileScope probe(m_profiler, Probe::NameProbe);
+                while (fs::exists(targetFile)) {
+                     uint64_t bytesRead = 0;
+                     bool same = FilesEqual(filePath, targetFile, bytesRead);
+                     m_compareBytes += bytesRead;
+                     probe.bytes += bytesRead;
+                     if (same) {
+                          m_skippedCount++;
+                          m_duplicateCount++;
+                          isDuplicate = true;
+                          break;
+                     }
+                     dup++;
+                     targetFile = targetDir / fs::u8path(baseName + "_" + std::to_string(dup));
+                     targetFile += ext;
+                }
+            }
+            if (isDuplicate) break;
+
+            // Exclusive create/rename/link: the name may have been taken since the check
+            std::error_code ec;
+            bool placed;
+            if (staged) {
+                ProfileScope probe(m_profiler, Probe::Rename);
+                placed = RenameNoReplace(filePath, targetFile, ec);
+            } else {
+                AdaptiveLimit::Permit permit(m_concurrency.For(WorkStage::Copy, m_targetDevice));
+                AdaptiveLimit::Permit reader(m_concurrency.Readers(meta.device));
+                ProfileScope probe(m_profiler, Probe::Copy);
+                placed = source ? m_copier->Place(*source, targetFile, m_options.placement, used, ec)
+                                : m_copier->Place(filePath, targetFile, m_options.placement, used, ec);
+                probe.bytes = placed ? meta.size : 0;
+                permit.Done(placed ? meta.size : 0);
+            }
+            if (placed) break;
+            if (ec != std::errc::file_exists) throw fs::filesystem_error("place", filePath, targetFile, ec);
+        }
+
+        if (isDuplicate) {
+            if (staged) fs::remove(filePath);
+        } else {
+            m_successCount++;
+            m_placedBytes += meta.size;
+            if (staged) m_extractedBytes += meta.size;
+            else if (used != PlacementMode::Copy) m_placedBy[(int)used]++;
+
+            if (m_firstCopyNanos < 0) {
+                long long expected = -1;
+                long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_startTime).count();
+                m_firstCopyNanos.compare_exchange_strong(expected, now);
+            }
+        }
+        m_dedup.Placed(ticket, targetFile);
+        claimed = false;
+
+        if (!staged && m_manifest.is_open()) {
+            ProfileScope probe(m_profiler, Probe::Manifest);
+            uint64_t hash = 0;
+            m_dedup.PartialHash(ticket, hash, source);
+            m_manifest.Record(filePath, meta.size, meta.modifiedTime, hash, targetFile);
+        }
+        // Placed: its pages can go
+        if (source && !isDuplicate) source->DropCache();
+        return isDuplicate ? PlaceResult::Duplicate : PlaceResult::Copied;
+    } catch (const std::exception& e) {
+        if (claimed) m_dedup.Release(ticket);
+        m_skippedCount++;
+        Log(std::string("Error: ") + e.what());
+    } catch (...) {
+        if (claimed) m_dedup.Release(ticket);
+        m_skippedCount++;
+        Log("Unknown error processing file.");
+    }
+    if (staged) {
+        std::error_code ec;
+        fs::remove(filePath, ec);
+    }
+    return PlaceResult::Failed;
+}
+
+// Runs on the resolver thread: sends every file waiting for this location
+// on to the copy stage.
+void SorterEngine::OnLocationResolved(uint64_t key, const std::string& name) {
+    std::vector<WorkItem> items;
+    {
+        std::lock_guard<std::mutex> lock(m_parkMutex);
+        auto it = m_parked.find(key);
+        if (it == m_parked.end()) return;
+        items.swap(it->second);
+        m_parked.erase(it);
+    }
+    for (auto& item : items) {
+        item.meta.location = name;
+        m_placeQueue->requeue(std::move(item));
+        m_stages[(int)WorkStage::Copy].NoteQueue(m_placeQueue->size());
+    }
+}
+
+// Passes a file the metadata stage is done with to the copy stage, or
+// retires it. Parked files are the resolver's until it reports back.
+void SorterEngine::HandOff(WorkItem& item, Outcome outcome) {
+    if (outcome == Outcome::Done) {
+        ItemDone();
+    } else if (outcome == Outcome::ToPlace) {
+        // Blocks while the copy stage is behind
+        auto start = std::chrono::steady_clock::now();
+        m_placeQueue->push(std::move(item), &m_stopRequested);
+        m_stages[(int)WorkStage::Metadata].blockedNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        m_stages[(int)WorkStage::Copy].NoteQueue(m_placeQueue->size());
+    }
+}
+
+void SorterEngine::CountStage(WorkStage stage, std::chrono::steady_clock::time_point start, uint64_t items) {
+    StageCounters& counters = m_stages[(int)stage];
+    counters.items += items;
+    counters.busyNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SorterEngine::CountFormat(MediaFormat format, std::chrono::steady_clock::time_point start, uint64_t bytesRead,
+                               const FileMetadata& meta) {
+    FormatCounters& counters = m_formats[(int)format];
+    counters.files++;
+    if (meta.hasDate) counters.dated++;
+    if (meta.hasGps) counters.located++;
+    counters.bytesRead += bytesRead;
+    counters.nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SorterEngine::MetadataThread(WorkQueue<WorkItem>& queue, int index) {
+    m_profiler.NameThread("metadata " + std::to_string(index + 1));
+    WorkItem item;
+    while (queue.pop(item)) {
+        if (m_stopRequested) break;
+        auto start = std::chrono::steady_clock::now();
+        Outcome outcome = item.archive ? ProcessMember(item) : ProcessFile(item, nullptr);
+        CountStage(WorkStage::Metadata, start, 1);
+        HandOff(item, outcome);
+    }
+}
+
+// Takes up to ioDepth items at a time and reads the headers of all source
+// files among them through one ring, so a single thread keeps that many
+// reads in flight. Unchanged files are still skipped after one stat.
+void SorterEngine::RingMetadataThread(WorkQueue<WorkItem>& queue, int index) {
+    m_profiler.NameThread("metadata " + std::to_string(index + 1));
+    const size_t NO_READ = (size_t)-1;
+    const size_t SKIPPED = NO_READ - 1;
+    size_t depth = (size_t)std::max(1, std::min(m_options.ioDepth, 4096));
+
+    IoRing ring;
+    ring.Init((unsigned)depth); // Reads block if this fails
+    std::vector<WorkItem> batch;
+    std::vector<HeadRead> reads;
+    std::vector<Prefetched> prefetched;
+    std::vector<size_t> readOf;
+
+    while (queue.pop_batch(batch, depth)) {
+        if (m_stopRequested) break;
+        auto start = std::chrono::steady_clock::now();
+        reads.clear();
+        prefetched.clear();
+        readOf.assign(batch.size(), NO_READ);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            const WorkItem& item = batch[i];
+            if (item.archive) continue;
+            Prefetched file;
+            ProfileScope probe(m_profiler, Probe::Stat);
+            if (!GetFileIdentity(item.path, file.size, file.modifiedTime, &file.device)) continue; // Reported by ProcessFile
+            if (m_manifest.is_open() && m_manifest.IsUnchanged(item.path, file.size, file.modifiedTime)) {
+                m_unchangedCount++;
+                CountProcessed();
+                readOf[i] = SKIPPED;
+                continue;
+            }
+            HeadRead read;
+            read.path = item.path;
+            read.size = (size_t)std::min<uint64_t>(file.size, exif::HEADER_WINDOW);
+            readOf[i] = reads.size();
+            reads.push_back(std::move(read));
+            prefetched.push_back(std::move(file));
+        }
+        if (!reads.empty()) {
+            // The whole batch counts as one stay in the metadata stage
+            AdaptiveLimit::Permit permit(m_concurrency.For(WorkStage::Metadata, prefetched.front().device));
+            AdaptiveLimit::Permit reader(m_concurrency.Readers(prefetched.front().device));
+            ProfileScope probe(m_profiler, Probe::ReadAhead);
+            ReadHeads(&ring, reads);
+            for (const HeadRead& read : reads) probe.bytes += read.ok ? read.data.size() : 0;
+            permit.Done(reads.size());
+        }
+
+        std::vector<Outcome> outcomes(batch.size(), Outcome::Done);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            WorkItem& item = batch[i];
+            if (readOf[i] == SKIPPED) continue;
+            Prefetched* file = nullptr;
+            if (readOf[i] != NO_READ && reads[readOf[i]].ok) {
+                file = &prefetched[readOf[i]];
+                file->head = std::move(reads[readOf[i]].data);
+            }
+            outcomes[i] = item.archive ? ProcessMember(item) : ProcessFile(item, file);
+        }
+        CountStage(WorkStage::Metadata, start, batch.size());
+        for (size_t i = 0; i < batch.size(); ++i) HandOff(batch[i], outcomes[i]);
+    }
+}
+
+void SorterEngine::PlaceThread(WorkQueue<WorkItem>& queue, int index) {
+    m_profiler.NameThread("copy " + std::to_string(index + 1));
+    WorkItem item;
+    while (queue.pop(item)) {
+        if (m_stopRequested) break;
+        auto start = std::chrono::steady_clock::now();
+        if (item.archive) PlaceArchiveMember(item);
+        else PlaceFile(item.path, item.meta, false, item.source.get());
+        item.source.reset();
+        CountStage(WorkStage::Copy, start, 1);
+        ItemDone();
+    }
+}
+
+void SorterEngine::ItemDone() {
+    if (--m_inFlight == 0) {
+        std::lock_guard<std::mutex> lock(m_drainMutex);
+        m_drainCond.notify_all();
+    }
+}
+
+// Extrapolates the final file count from the ratio of directories found to
+// directories already listed. Never below what was already discovered.
+void SorterEngine::PublishEstimate(int discovered, uint64_t dirsListed, uint64_t dirsFound) {
+    int estimate = discovered;
+    if (dirsListed > 0 && dirsFound > dirsListed) {
+        estimate = (int)(discovered * (double)dirsFound / (double)dirsListed);
+    }
+    int processed = m_processedCount;
+    if (estimate < processed) estimate = processed;
+    m_estimatedTotal = estimate;
+    if (m_listener) m_listener->OnTotal(estimate, false);
+}
+
+// Walks the source with the parallel walker and feeds the queue as it goes, so
+// workers start copying while the rest of the tree is still being enumerated.
+// With a disk order, files go out a batch at a time, sorted by their place.
+void SorterEngine::ScanSource(WorkQueue<WorkItem>& queue) {
+    int scanThreads = m_options.scanThreads;
+    if (scanThreads < 1) {
+        scanThreads = (int)std::thread::hardware_concurrency();
+        if (scanThreads < 2) scanThreads = 2;
+        if (scanThreads > 8) scanThreads = 8;
+    }
+
+    DirWalker walker(scanThreads);
+    auto dispatch = [&](fs::path&& file) {
+        int discovered = ++m_totalFiles;
+        int estimate = m_estimatedTotal;
+        while (estimate < discovered && !m_estimatedTotal.compare_exchange_weak(estimate, discovered)) {}
+        m_inFlight++;
+        WorkItem item;
+        item.path = std::move(file);
+        // Blocks while the workers are behind; dropped only on a stop
+        queue.push(std::move(item), &m_stopRequested);
+        m_stages[(int)WorkStage::Metadata].NoteQueue(queue.size());
+
+        if (discovered % 256 == 0) {
+            PublishEstimate(discovered, walker.DirectoriesListed(), walker.DirectoriesFound());
+        }
+    };
+
+    // Absolute, so manifest entries don't depend on the working directory
+    fs::path root = fs::absolute(m_options.sourcePath);
+    if (m_options.diskOrder == DiskOrder::Off) {
+        walker.Walk({ root }, [&](fs::path&& file, uint64_t) { dispatch(std::move(file)); }, &m_stopRequested);
+    } else {
+        DiskOrderBatcher batcher(m_options.diskOrder, DISK_ORDER_BATCH, dispatch);
+        walker.Walk({ root }, [&](fs::path&& file, uint64_t inode) { batcher.Add(std::move(file), inode); }, &m_stopRequested);
+        batcher.Flush();
+        Log("Disk order: " + std::to_string(batcher.ExtentKeys()) + " files by extent, " +
+            std::to_string(batcher.InodeKeys()) + " by inode");
+    }
+    uint64_t unlisted = walker.GetStats().errors;
+    if (unlisted > 0) Log("Error: " + std::to_string(unlisted) + " folder(s) could not be listed completely");
+}
+
+// --- PROFILE ---
+
+static void WriteProbe(std::ostream& out, const ProbeStats& probe) {
+    out << "{\"name\":\"" << probe.name << "\",\"calls\":" << probe.calls << ",\"seconds\":" << probe.seconds
+        << ",\"bytes\":" << probe.bytes << ",\"p50\":" << probe.p50 << ",\"p90\":" << probe.p90
+        << ",\"p99\":" << probe.p99 << ",\"max\":" << probe.max << "}";
+}
+
+// The run profile: totals, stages, stage limits, and every probe over the
+// run and per thread. Latencies are in seconds.
+void SorterEngine::WriteProfile(const SortStats& stats) {
+    if (m_profiler.Tracing()) {
+        if (!m_profiler.WriteChromeTrace(m_options.traceFile)) {
+            Log("Can't write the trace: " + m_options.traceFile.u8string());
+        } else if (m_profiler.DroppedEvents() > 0) {
+            Log("Trace is incomplete, " + std::to_string(m_profiler.DroppedEvents()) + " events dropped.");
+        }
+    }
+    if (m_options.profileFile.empty()) return;
+
+    std::ofstream out(m_options.profileFile, std::ios::binary | std::ios::trunc);
+    out << std::setprecision(9);
+    out << "{\n\"elapsedSeconds\":" << stats.elapsedSeconds << ",\"scanSeconds\":" << stats.scanSeconds
+        << ",\"firstCopySeconds\":" << stats.firstCopySeconds << ",\n";
+    out << "\"files\":{\"total\":" << stats.totalFiles << ",\"processed\":" << stats.processed
+        << ",\"copied\":" << stats.copied << ",\"skipped\":" << stats.skipped << ",\"duplicates\":" << stats.duplicates
+        << ",\"unchanged\":" << stats.unchanged << "},\n";
+    out << "\"bytes\":{\"placed\":" << stats.bytesPlaced << ",\"written\":" << stats.bytesWritten
+        << ",\"dedupRead\":" << stats.dedupBytesRead << "},\n";
+    out << "\"workerThreads\":" << stats.workerThreads << ",\"adaptiveConcurrency\":"
+        << (stats.adaptiveConcurrency ? "true" : "false") << ",\n";
+
+    out << "\"stages\":[";
+    for (size_t i = 0; i < stats.stages.size(); ++i) {
+        const StageStats& stage = stats.stages[i];
+        out << (i ? ",\n" : "\n") << "{\"name\":\"" << stage.name << "\",\"threads\":" << stage.threads
+            << ",\"items\":" << stage.items << ",\"busySeconds\":" << stage.busySeconds
+            << ",\"blockedSeconds\":" << stage.blockedSeconds << ",\"peakQueue\":" << stage.peakQueue
+            << ",\"queueCapacity\":" << stage.queueCapacity << "}";
+    }
+    out << "],\n\"concurrency\":[";
+    for (size_t i = 0; i < stats.concurrency.size(); ++i) {
+        const ConcurrencyController::Entry& entry = stats.concurrency[i];
+        out << (i ? ",\n" : "\n") << "{\"stage\":\"" << WorkStageName(entry.stage) << "\",\"device\":\"" << entry.device
+            << "\",\"limit\":" << entry.stats.limit << ",\"low\":" << entry.stats.low << ",\"high\":" << entry.stats.high
+            << ",\"operations\":" << entry.stats.operations << ",\"units\":" << entry.stats.units
+            << ",\"busySeconds\":" << entry.stats.busySeconds << "}";
+    }
+    out << "],\n\"formats\":[";
+    bool first = true;
+    for (const FormatStats& format : stats.formats) {
+        if (format.files == 0) continue;
+        out << (first ? "\n" : ",\n") << "{\"name\":\"" << format.name << "\",\"files\":" << format.files
+            << ",\"dated\":" << format.dated << ",\"located\":" << format.located << ",\"seconds\":" << format.seconds
+            << ",\"bytesRead\":" << format.bytesRead << "}";
+        first = false;
+    }
+    out << "],\n\"probes\":[";
+    first = true;
+    for (const ProbeStats& probe : stats.profile) {
+        if (probe.calls == 0) continue;
+        out << (first ? "\n" : ",\n");
+        WriteProbe(out, probe);
+        first = false;
+    }
+    out << "],\n\"threads\":[";
+    std::vector<RunProfiler::ThreadStats> threads = m_profiler.GetThreadStats();
+    for (size_t i = 0; i < threads.size(); ++i) {
+        out << (i ? ",\n" : "\n") << "{\"name\":\"" << threads[i].name << "\",\"probes\":[";
+        for (size_t p = 0; p < threads[i].probes.size(); ++p) {
+            if (p) out << ",";
+            WriteProbe(out, threads[i].probes[p]);
+        }
+        out << "]}";
+    }
+    out << "]\n}\n";
+    out.close();
+    if (!out) Log("Can't write the run profile: " + m_options.profileFile.u8string());
+}
+
+SortStats SorterEngine::Run() {
+    m_startTime = std::chrono::steady_clock::now();
+
+    // Reset stats
+    m_processedCount = 0;
+    m_successCount = 0;
+    m_skippedCount = 0;
+    m_totalFiles = 0;
+    m_estimatedTotal = 0;
+    m_scanComplete = false;
+    m_firstCopyNanos = -1;
+    m_deferredCount = 0;
+    m_duplicateCount = 0;
+    m_unchangedCount = 0;
+    m_compareBytes = 0;
+    m_inFlight = 0;
+    m_parked.clear();
+    m_archiveStats.clear();
+    for (auto& count : m_placedBy) count = 0;
+    m_placedBytes = 0;
+    m_extractedBytes = 0;
+    m_profiler.Begin(!m_options.traceFile.empty());
+    m_geocoder.SetProfiler(&m_profiler);
+
+    std::string geocodeError;
+    if (!m_geocoder.Configure(m_options.geocodeMode, m_options.placesFile, geocodeError)) {
+        throw std::runtime_error(geocodeError);
+    }
+    if (m_options.geocodeMode == GeocodeMode::Offline) {
+        Log("Offline geocoding enabled.");
+    } else if (m_options.geocodeMode == GeocodeMode::Online && !m_options.geocodeCacheFile.empty()) {
+        if (!m_geocoder.OpenCache(m_options.geocodeCacheFile)) {
+            Log("Geocode cache unavailable, using memory only: " + m_options.geocodeCacheFile.u8string());
+        }
+    }
+    if (!m_geocoder.SetEndpoint(m_options.geocodeUrl)) {
+        throw std::runtime_error("Invalid geocoding server URL: " + m_options.geocodeUrl);
+    }
+
+    m_useRing = false;
+    if (m_options.ioUring) {
+        m_useRing = IoRing::Available();
+        Log(m_useRing ? "Reading and copying through io_uring."
+                      : "io_uring is not available here, using blocking reads.");
+    }
+    m_copier.reset(new FileCopier(m_options.copyMethod, m_useRing));
+
+    if (m_options.placement != PlacementMode::Copy && !SameVolume(m_options.sourcePath, m_options.targetPath)) {
+        Log(std::string("Source and target are on different volumes, files are copied") +
+            (m_options.placement == PlacementMode::Move ? " and then deleted." : "."));
+    }
+
+    if (m_options.useManifest) {
+        if (m_manifest.Open(m_options.targetPath)) {
+            // Files already in the library count for duplicate detection
+            size_t known = 0;
+            m_manifest.ForEachPlacement([&](const TargetManifest::Entry& entry, const fs::path& placedAt) {
+                m_dedup.AddKnown(placedAt, entry.size, entry.contentHash);
+                known++;
+            });
+            if (known > 0) Log("Library manifest: " + std::to_string(known) + " files already sorted.");
+        } else {
+            Log("Can't open the library manifest in the target folder, sorting without it.");
+        }
+    }
+
+    // Scanner -> metadata stage -> copy stage, with the resolver feeding
+    // parked files into the copy stage
+    WorkQueue<WorkItem> queue(QUEUE_CAPACITY);
+    WorkQueue<WorkItem> placeQueue(PLACE_QUEUE_CAPACITY);
+    m_metaQueue = &queue;
+    m_placeQueue = &placeQueue;
+    for (auto& stage : m_stages) stage.Reset();
+    for (auto& format : m_formats) format.Reset();
+    if (m_options.geocodeMode == GeocodeMode::Online) {
+        m_geocoder.StartResolver([this](uint64_t key, const std::string& name) { OnLocationResolved(key, name); });
+    }
+    // A fixed count per stage is just that; otherwise the threads are mostly
+    // waiting on I/O, and per-device stage limits decide how many are busy
+    int numThreads = m_options.threads;
+    bool adaptive = numThreads < 1;
+    if (adaptive) numThreads = MAX_ADAPTIVE_WORKERS;
+    m_workerThreads = numThreads;
+    m_concurrency.Configure(numThreads, adaptive,
+                            m_options.diskOrder != DiskOrder::Off ? m_options.rotationalReaders : 0);
+    uint64_t targetSize = 0;
+    int64_t targetTime = 0;
+    GetFileIdentity(m_options.targetPath, targetSize, targetTime, &m_targetDevice);
+
+    std::vector<std::thread> readers, placers;
+    for (int i = 0; i < numThreads; ++i) {
+        readers.emplace_back(m_useRing ? &SorterEngine::RingMetadataThread : &SorterEngine::MetadataThread, this, std::ref(queue), i);
+        placers.emplace_back(&SorterEngine::PlaceThread, this, std::ref(placeQueue), i);
+    }
+
+    Log("Scanning and processing in parallel...");
+    bool scanFailed = false;
+    try {
+        ScanSource(queue);
+    } catch (...) {
+        scanFailed = true;
+        m_stopRequested = true;
+    }
+
+    m_scanSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+    m_scanComplete = true;
+    m_estimatedTotal = (int)m_totalFiles;
+    if (m_listener && !scanFailed) m_listener->OnTotal(m_totalFiles, true);
+
+    // Parked files come back through the copy queue, so the queues stay open
+    // until every file has been placed (or a stop is requested)
+    {
+        std::unique_lock<std::mutex> lock(m_drainMutex);
+        while (m_inFlight > 0 && !m_stopRequested) {
+            m_drainCond.wait_for(lock, std::chrono::milliseconds(100));
+        }
+    }
+    queue.set_finished();
+    for (auto& t : readers) {
+        t.join();
+    }
+    placeQueue.set_finished();
+    for (auto& t : placers) {
+        t.join();
+    }
+    m_geocoder.StopResolver();
+    m_parked.clear(); // Left behind by a stop, may hold archives open
+    m_metaQueue = nullptr;
+    m_placeQueue = nullptr;
+
+    if (scanFailed) {
+        throw std::runtime_error("Error reading source directory.");
+    }
+    SortStats stats = Stats();
+    WriteProfile(stats);
+    Log(m_totalFiles == 0 ? "No files found." : "Finished.");
+    return stats;
+}
@@ -0,0 +1,262 @@
+// sorter_engine.h
+// Platform-neutral scan -> metadata -> plan -> copy pipeline. Front ends (the
+// Win32 GUI, media-sorter-cli) drive it through SorterEngine and receive
+// progress through a SortProgressListener.
+#pragma once
+
+#include "work_queue.h"
+#include "geocoder.h"
+#include "file_metadata.h"
+#include "source_file.h"
+#include "dedup_index.h"
+#include "target_manifest.h"
+#include "zip_reader.h"
+#include "file_copy.h"
+#include "concurrency_controller.h"
+#include "disk_order.h"
+#include "run_profile.h"
+#include <string>
+#include <filesystem>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+struct SortOptions {
+    std::filesystem::path sourcePath;
+    std::filesystem::path targetPath;
+    int threads = 0;                // Per stage; 0 = adaptive (ConcurrencyController)
+    int scanThreads = 0;            // Directory walker threads, 0 = auto
+    GeocodeMode geocodeMode = GeocodeMode::Online;
+    std::filesystem::path placesFile;   // GeoNames-style cities file for GeocodeMode::Offline
+    std::filesystem::path geocodeCacheFile; // Online results kept across runs, empty = this run only
+    std::string geocodeUrl;             // Online server, empty = public Nominatim
+    bool useManifest = true;            // Skip sources recorded in the target's manifest (TargetManifest)
+    PlacementMode placement = PlacementMode::Copy;  // Archive members are always extracted
+    CopyMethod copyMethod = CopyMethod::Auto;   // Forced only for benchmarking
+    bool ioUring = false;               // Batch header reads and copies through io_uring (Linux)
+    int ioDepth = 64;                   // Reads in flight per worker with ioUring
+    DiskOrder diskOrder = DiskOrder::Off;   // Hand files to the workers in on-disk order (DiskOrderBatcher)
+    int rotationalReaders = 1;          // With diskOrder: readers per spinning disk at once, 0 = no cap
+    std::filesystem::path profileFile;  // JSON run profile written at the end, empty = none
+    std::filesystem::path traceFile;    // Chrome trace of every probe, empty = none
+};
+
+// One pipeline stage (WorkStage) over the run.
+struct StageStats {
+    std::string name;
+    int threads = 0;
+    uint64_t items = 0;
+    double busySeconds = 0.0;       // Summed over the stage's threads
+    double blockedSeconds = 0.0;    // Waiting for room in the next stage's queue
+    size_t peakQueue = 0;           // Most files waiting for the stage at once
+    size_t queueCapacity = 0;
+};
+
+// Files of one format (MediaFormat) that went through the metadata stage.
+struct FormatStats {
+    std::string name;
+    uint64_t files = 0;             // Archive members included
+    uint64_t dated = 0;             // Date taken found in the file
+    uint64_t located = 0;           // GPS position found
+    double seconds = 0.0;           // Detecting and parsing, summed over threads
+    uint64_t bytesRead = 0;         // From disk for it, prefetched headers included
+};
+
+// One archive's share of the run. Members are counted in SortStats as well.
+struct ArchiveStats {
+    std::string name;               // UTF-8 file name, "outer.zip/inner.zip" when nested
+    int members = 0;                // Files inside, directories not counted
+    int copied = 0;
+    int duplicates = 0;
+    int skipped = 0;                // Corrupt, encrypted or unsupported members
+    uint64_t bytes = 0;             // Uncompressed size of the members
+    double seconds = 0.0;           // From opening it to its last member placed
+};
+
+struct SortStats {
+    int totalFiles = 0;
+    int processed = 0;
+    int copied = 0;                 // Placed in the target, by whatever means
+    int moved = 0;                  // Part of copied: placed without a copy (SortOptions::placement)
+    int hardlinked = 0;
+    int symlinked = 0;
+    int skipped = 0;
+    int duplicates = 0;             // Part of skipped: same content already placed
+    int unchanged = 0;              // Sorted by an earlier run, not looked at again
+    uint64_t dedupBytesRead = 0;    // Read for hashing and comparing
+    double elapsedSeconds = 0.0;
+    double scanSeconds = 0.0;       // Until the source walk completed
+    double firstCopySeconds = -1.0; // Time to first copy, -1 if nothing was copied
+    uint64_t geocodeCacheHits = 0;  // Online lookups answered from the cache
+    uint64_t geocodeCacheMisses = 0;
+    uint64_t geocodeRequests = 0;   // Sent to the geocoding server
+    uint64_t geocodeLookupsSaved = 0;   // Locations answered by a nearby one (clustering)
+    int geocodeDeferred = 0;        // Files that waited for the resolver
+    std::vector<ArchiveStats> archives; // In the order they were finished
+    FileCopier::Stats copies;       // Files and bytes per copy method
+    uint64_t bytesPlaced = 0;       // Size of everything placed
+    uint64_t bytesWritten = 0;      // Data actually written to the target for it
+    int workerThreads = 0;          // Per stage
+    std::vector<StageStats> stages;
+    bool adaptiveConcurrency = false;
+    std::vector<ConcurrencyController::Entry> concurrency;  // Stage limits per device as chosen
+    std::vector<ProbeStats> profile;    // Time, bytes and latency per hot-path step (RunProfiler)
+    std::vector<FormatStats> formats;   // In MediaFormat order, all of them
+};
+
+// Callbacks arrive on engine threads (scanner and workers), possibly concurrently.
+class SortProgressListener {
+public:
+    virtual ~SortProgressListener() {}
+    virtual void OnStatus(const std::string& /*message*/) {}     // UTF-8
+    // While the source is still being scanned, totalFiles is an estimate
+    // (final == false) that firms up once the scan completes. Archives add
+    // their members when they are opened, so it can still grow after that.
+    virtual void OnTotal(int /*totalFiles*/, bool /*final*/) {}
+    virtual void OnProgress(int /*processed*/, int /*totalFiles*/) {}
+};
+
+class SorterEngine {
+public:
+    SorterEngine(const SortOptions& options, SortProgressListener* listener = nullptr);
+
+    // Runs the whole sort on the calling thread and returns the final stats.
+    // Throws std::runtime_error if the source folder can't be read.
+    SortStats Run();
+
+    // Safe to call from any thread (or a signal handler).
+    void RequestStop() { m_stopRequested = true; }
+    bool StopRequested() const { return m_stopRequested; }
+
+    SortStats Stats() const;
+
+private:
+    // An open ZIP whose members are being sorted (defined in the .cpp)
+    struct ArchiveJob;
+
+    enum class PlaceResult { Copied, Duplicate, Failed };
+
+    // What a batching worker already knows about a source file
+    struct Prefetched {
+        uint64_t size = 0;
+        int64_t modifiedTime = 0;
+        uint64_t device = 0;
+        std::vector<uint8_t> head;      // Its first exif::HEADER_WINDOW bytes
+    };
+
+    // What the metadata stage made of a file
+    enum class Outcome { Done, Parked, ToPlace };
+
+    // A source file or archive member on its way through the stages
+    struct WorkItem {
+        std::filesystem::path path;
+        FileMetadata meta;
+        std::shared_ptr<ArchiveJob> archive;    // Set for an archive member
+        size_t member = 0;                      // Its index in the archive's entries
+        std::unique_ptr<ZipMemberReader> reader;    // A member's decoder, past its header
+        std::vector<uint8_t> head;                  // and the header it read
+        std::unique_ptr<SourceFile> source;     // A file's descriptor, from its header read to its copy
+    };
+
+    struct StageCounters {
+        std::atomic<uint64_t> items{0};
+        std::atomic<int64_t> busyNanos{0};
+        std::atomic<int64_t> blockedNanos{0};
+        std::atomic<size_t> peakQueue{0};
+
+        void Reset() { items = 0; busyNanos = 0; blockedNanos = 0; peakQueue = 0; }
+        void NoteQueue(size_t depth) {
+            size_t peak = peakQueue;
+            while (depth > peak && !peakQueue.compare_exchange_weak(peak, depth)) {}
+        }
+    };
+
+    struct FormatCounters {
+        std::atomic<uint64_t> files{0};
+        std::atomic<uint64_t> dated{0};
+        std::atomic<uint64_t> located{0};
+        std::atomic<int64_t> nanos{0};
+        std::atomic<uint64_t> bytesRead{0};
+
+        void Reset() { files = 0; dated = 0; located = 0; nanos = 0; bytesRead = 0; }
+    };
+
+    void Log(const std::string& msg);
+    void ScanSource(WorkQueue<WorkItem>& queue);
+    void PublishEstimate(int discovered, uint64_t dirsListed, uint64_t dirsFound);
+    void MetadataThread(WorkQueue<WorkItem>& queue, int index);
+    void RingMetadataThread(WorkQueue<WorkItem>& queue, int index);
+    void PlaceThread(WorkQueue<WorkItem>& queue, int index);
+    void HandOff(WorkItem& item, Outcome outcome);
+    void CountStage(WorkStage stage, std::chrono::steady_clock::time_point start, uint64_t items);
+    void CountFormat(MediaFormat format, std::chrono::steady_clock::time_point start, uint64_t bytesRead,
+                     const FileMetadata& meta);
+    void ItemDone();
+    bool LookupLocation(FileMetadata& meta);
+    void CreateDirectories(const std::filesystem::path& dir);
+    Outcome ProcessFile(WorkItem& item, Prefetched* prefetched);
+    bool Park(WorkItem& item);
+    std::filesystem::path TargetDirFor(const FileMetadata& meta) const;
+    PlaceResult PlaceFile(const std::filesystem::path& filePath, const FileMetadata& meta, bool staged,
+                          SourceFile* source = nullptr);
+    void OnLocationResolved(uint64_t key, const std::string& name);
+    void AddFiles(int count);
+    void CountProcessed();
+    void ProcessZip(const std::filesystem::path& zipPath, const std::shared_ptr<ArchiveJob>& job);
+    Outcome ProcessMember(WorkItem& item);
+    void PlaceArchiveMember(WorkItem& item);
+    PlaceResult PlaceMember(const WorkItem& item, ZipMemberReader& reader, const std::vector<uint8_t>& head);
+    void MemberDone(const std::shared_ptr<ArchiveJob>& job, bool ok);
+    void WriteProfile(const SortStats& stats);
+
+    SortOptions m_options;
+    SortProgressListener* m_listener;
+    Geocoder m_geocoder;
+
+    std::atomic<bool> m_stopRequested{false};
+    std::atomic<int> m_totalFiles{0};      // Discovered so far
+    std::atomic<int> m_estimatedTotal{0};  // Shown as progress range
+    std::atomic<bool> m_scanComplete{false};
+    std::atomic<long long> m_firstCopyNanos{-1};
+    double m_scanSeconds = 0.0;
+    std::atomic<int> m_processedCount{0};
+    std::atomic<int> m_successCount{0};
+    std::atomic<int> m_skippedCount{0};
+    std::atomic<int> m_deferredCount{0};
+    std::atomic<int> m_duplicateCount{0};
+    std::atomic<uint64_t> m_compareBytes{0};
+    std::atomic<int> m_unchangedCount{0};
+    DedupIndex m_dedup;
+    TargetManifest m_manifest;
+    std::unique_ptr<FileCopier> m_copier;
+    bool m_useRing = false;
+    ConcurrencyController m_concurrency;
+    uint64_t m_targetDevice = 0;
+    int m_workerThreads = 0;
+    RunProfiler m_profiler;
+    std::atomic<int> m_placedBy[PLACEMENT_MODE_COUNT] = {};
+    std::atomic<uint64_t> m_placedBytes{0};
+    std::atomic<uint64_t> m_extractedBytes{0};
+    mutable std::mutex m_archiveMutex;
+    std::vector<ArchiveStats> m_archiveStats;
+
+    // Pipeline: the scanner feeds the metadata stage, which hands files on to
+    // the copy stage or parks them while the geocoding stage resolves their
+    // location, by location key. m_inFlight counts files anywhere in there;
+    // the queues are finished once the scan is done and it drops to zero.
+    WorkQueue<WorkItem>* m_metaQueue = nullptr;
+    WorkQueue<WorkItem>* m_placeQueue = nullptr;
+    StageCounters m_stages[WORK_STAGE_COUNT];
+    FormatCounters m_formats[MEDIA_FORMAT_COUNT];
+    std::mutex m_parkMutex;
+    std::unordered_map<uint64_t, std::vector<WorkItem>> m_parked;
+    std::atomic<int64_t> m_inFlight{0};
+    std::mutex m_drainMutex;
+    std::condition_variable m_drainCond;
+    std::chrono::steady_clock::time_point m_startTime;
+};
@@ -0,0 +1,180 @@
+// source_file.cpp
+#include "source_file.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#endif
+
+#ifdef _WIN32
+
+bool SourceFile::Stat(const std::filesystem::path& path) {
+    Close();
+    m_path = path;
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) return false;
+    m_size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    m_modifiedTime = (int64_t)(((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime);
+    m_device = 0;
+    return true;
+}
+
+// Others may still delete or rename the file (a move into the target).
+// Windows has no per-read hint: the copy opens the file again by path.
+bool SourceFile::OpenHandle() {
+    HANDLE hFile = CreateFileW(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+    m_hFile = hFile;
+    return true;
+}
+
+bool SourceFile::Open() {
+    return OpenHandle();
+}
+
+void SourceFile::Close() {
+    if (m_hFile) CloseHandle(m_hFile);
+    m_hFile = nullptr;
+}
+
+bool SourceFile::is_open() const { return m_hFile != nullptr; }
+
+size_t SourceFile::ReadAt(uint64_t offset, void* buffer, size_t size) {
+    size_t done = 0;
+    while (m_hFile && done < size && (done == 0 || offset + done < m_size)) {
+        OVERLAPPED at = {};
+        at.Offset = (DWORD)(offset + done);
+        at.OffsetHigh = (DWORD)((offset + done) >> 32);
+        DWORD want = (DWORD)std::min<size_t>(size - done, 1 << 30), got = 0;
+        if (!ReadFile((HANDLE)m_hFile, (char*)buffer + done, want, &got, &at) || got == 0) break;
+        done += got;
+    }
+    return done;
+}
+
+void SourceFile::AdviseSequential() {}
+void SourceFile::DropCache() {}
+
+#else
+
+// The kernel's default readahead: files up to this size get no hints
+static const uint64_t READAHEAD_WINDOW = 128 * 1024;
+
+bool SourceFile::Stat(const std::filesystem::path& path) {
+    Close();
+    m_path = path;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    m_size = (uint64_t)st.st_size;
+    m_device = (uint64_t)st.st_dev;
+    m_mode = (unsigned)st.st_mode;
+#ifdef __APPLE__
+    m_modifiedTime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    m_modifiedTime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+bool SourceFile::OpenHandle() {
+    m_fd = open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+    return m_fd >= 0;
+}
+
+bool SourceFile::Open() {
+    if (!OpenHandle()) return false;
+#ifdef POSIX_FADV_RANDOM
+    // Header reads get what the parser asks for and no readahead window;
+    // smaller files are read whole either way
+    if (m_size > READAHEAD_WINDOW) posix_fadvise(m_fd, 0, 0, POSIX_FADV_RANDOM);
+#endif
+    return true;
+}
+
+void SourceFile::Close() {
+    if (m_fd >= 0) close(m_fd);
+    m_fd = -1;
+}
+
+bool SourceFile::is_open() const { return m_fd >= 0; }
+
+size_t SourceFile::ReadAt(uint64_t offset, void* buffer, size_t size) {
+    size_t done = 0;
+    while (m_fd >= 0 && done < size && (done == 0 || offset + done < m_size)) {
+        ssize_t n = pread(m_fd, (char*)buffer + done, size - done, (off_t)(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    return done;
+}
+
+void SourceFile::AdviseSequential() {
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (m_fd >= 0 && m_size > READAHEAD_WINDOW) posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+void SourceFile::DropCache() {
+#ifdef POSIX_FADV_DONTNEED
+    if (m_fd >= 0) posix_fadvise(m_fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+}
+
+#endif
+
+bool SourceFile::Open(const std::filesystem::path& path) {
+    Close();
+    m_path = path;
+    m_size = 0;
+    m_modifiedTime = 0;
+    m_device = 0;
+    return OpenHandle();
+}
+
+// --- STREAM ---
+
+SourceFileBuf::int_type SourceFileBuf::underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    size_t got = m_file.ReadAt(m_next, m_buffer, sizeof(m_buffer));
+    if (got == 0) return traits_type::eof();
+    m_next += got;
+    setg(m_buffer, m_buffer, m_buffer + got);
+    return traits_type::to_int_type(*gptr());
+}
+
+// Large reads go straight into the caller's buffer
+std::streamsize SourceFileBuf::xsgetn(char* s, std::streamsize n) {
+    std::streamsize buffered = std::min<std::streamsize>(n, egptr() - gptr());
+    if (buffered > 0) {
+        memcpy(s, gptr(), (size_t)buffered);
+        gbump((int)buffered);
+    }
+    if (buffered == n) return n;
+    size_t got = m_file.ReadAt(m_next, s + buffered, (size_t)(n - buffered));
+    m_next += got;
+    setg(m_buffer, m_buffer, m_buffer);
+    return buffered + (std::streamsize)got;
+}
+
+SourceFileBuf::pos_type SourceFileBuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+    if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+    off_type current = (off_type)m_next - (off_type)(egptr() - gptr());
+    off_type base = dir == std::ios_base::beg ? 0 : dir == std::ios_base::cur ? current : (off_type)m_file.size();
+    if (dir == std::ios_base::cur && off == 0) return pos_type(current);
+    return seekpos(pos_type(base + off), which);
+}
+
+SourceFileBuf::pos_type SourceFileBuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+    if (!(which & std::ios_base::in) || off_type(pos) < 0) return pos_type(off_type(-1));
+    m_next = (uint64_t)off_type(pos);
+    setg(m_buffer, m_buffer, m_buffer);
+    return pos;
+}
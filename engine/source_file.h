@@ -0,0 +1,83 @@
+// source_file.h
+// A source file opened once for everything the sorter does with it: one
+// stat for the manifest check and the file's identity, exact reads of the
+// header window the format parser asks for (no readahead past it), the
+// dedup hash, and the copy, which reuses the descriptor with sequential
+// readahead.
+#pragma once
+
+#include <filesystem>
+#include <streambuf>
+#include <cstdint>
+#include <cstddef>
+
+class SourceFile {
+public:
+    SourceFile() {}
+    ~SourceFile() { Close(); }
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    // Size, modification time (as GetFileIdentity), device and mode
+    bool Stat(const std::filesystem::path& path);
+    // Opens the file Stat found, without another stat, for reading its
+    // header: no readahead until AdviseSequential
+    bool Open();
+    // Opens path without any stat or hint, for callers that know its size
+    bool Open(const std::filesystem::path& path);
+    void Close();
+
+    // Bytes read; short at the end of the file or on an error. One read
+    // unless that fell short of the stat'ed size.
+    size_t ReadAt(uint64_t offset, void* buffer, size_t size);
+
+    // Before reading the rest front to back (copying, hashing)
+    void AdviseSequential();
+    // Once done: sorting reads every source once, so its pages would only
+    // push the rest of the cache out
+    void DropCache();
+
+    const std::filesystem::path& path() const { return m_path; }
+    uint64_t size() const { return m_size; }
+    int64_t modified_time() const { return m_modifiedTime; }
+    uint64_t device() const { return m_device; }
+    bool is_open() const;
+#ifdef _WIN32
+    void* handle() const { return m_hFile; }
+#else
+    int fd() const { return m_fd; }
+    unsigned mode() const { return m_mode; }
+#endif
+
+private:
+    bool OpenHandle();
+
+    std::filesystem::path m_path;
+    uint64_t m_size = 0;
+    int64_t m_modifiedTime = 0;
+    uint64_t m_device = 0;
+#ifdef _WIN32
+    void* m_hFile = nullptr;
+#else
+    int m_fd = -1;
+    unsigned m_mode = 0;
+#endif
+};
+
+// Stream over an open SourceFile for the parsers that take one. Reads are
+// positioned (no seek calls) and the end is the stat'ed size.
+class SourceFileBuf : public std::streambuf {
+public:
+    explicit SourceFileBuf(SourceFile& file) : m_file(file) {}
+
+protected:
+    int_type underflow() override;
+    std::streamsize xsgetn(char* s, std::streamsize n) override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+private:
+    SourceFile& m_file;
+    uint64_t m_next = 0;        // File offset of the end of the get area
+    char m_buffer[4096];
+};
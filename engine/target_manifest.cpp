@@ -0,0 +1,78 @@
+// target_manifest.cpp
+#include "target_manifest.h"
+#include <vector>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+static const char MANIFEST_MAGIC[4] = { 'M', 'S', 'T', 'M' };
+static const uint32_t MANIFEST_VERSION = 1;
+
+const char* TargetManifest::FILE_NAME = ".media-sorter.manifest";
+
+// Record: uint64 size, int64 time, uint64 hash, uint32 source length,
+// source path, target path (the rest)
+bool TargetManifest::Open(const fs::path& targetRoot) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_root = targetRoot;
+    m_entries.clear();
+    return m_log.Open(targetRoot / FILE_NAME, MANIFEST_MAGIC, MANIFEST_VERSION, [this](const uint8_t* data, size_t size) {
+        if (size < 28) return;
+        uint32_t sourceLen = GetLE32(data + 24);
+        if (sourceLen > size - 28) return;
+        Entry& e = m_entries[std::string((const char*)data + 28, sourceLen)];
+        e.size = GetLE64(data);
+        e.modifiedTime = (int64_t)GetLE64(data + 8);
+        e.contentHash = GetLE64(data + 16);
+        e.target.assign((const char*)data + 28 + sourceLen, size - 28 - sourceLen);
+    });
+}
+
+bool TargetManifest::IsUnchanged(const fs::path& source, uint64_t size, int64_t modifiedTime) {
+    std::string target;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(source.u8string());
+        if (it == m_entries.end() || it->second.size != size || it->second.modifiedTime != modifiedTime) return false;
+        target = it->second.target;
+    }
+    if (target.empty()) return true;
+    std::error_code ec;
+    return fs::exists(m_root / fs::u8path(target), ec);
+}
+
+void TargetManifest::Record(const fs::path& source, uint64_t size, int64_t modifiedTime,
+                            uint64_t contentHash, const fs::path& placedAt) {
+    Entry e;
+    e.size = size;
+    e.modifiedTime = modifiedTime;
+    e.contentHash = contentHash;
+    if (!placedAt.empty()) e.target = placedAt.lexically_relative(m_root).generic_u8string();
+    std::string key = source.u8string();
+
+    std::vector<uint8_t> record(28 + key.size() + e.target.size());
+    PutLE64(&record[0], e.size);
+    PutLE64(&record[8], (uint64_t)e.modifiedTime);
+    PutLE64(&record[16], e.contentHash);
+    PutLE32(&record[24], (uint32_t)key.size());
+    memcpy(&record[28], key.data(), key.size());
+    memcpy(&record[28 + key.size()], e.target.data(), e.target.size());
+    m_log.Append(record.data(), record.size());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries[key] = std::move(e);
+}
+
+void TargetManifest::ForEachPlacement(const std::function<void(const Entry& entry, const fs::path& placedAt)>& fn) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& kv : m_entries) {
+        const Entry& e = kv.second;
+        if (e.target.empty() || e.contentHash == 0) continue;
+        fn(e, m_root / fs::u8path(e.target));
+    }
+}
+
+size_t TargetManifest::Size() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
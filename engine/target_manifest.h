@@ -0,0 +1,50 @@
+// target_manifest.h
+// Persistent record of what has been sorted into a target folder, kept in the
+// target root. Maps a source file's identity (path, size, modification time)
+// to where it was placed, plus a content hash, so a re-run can skip unchanged
+// sources with a single stat and seed duplicate detection with the library's
+// contents without reading them. Persisted through a RecordLog.
+#pragma once
+
+#include "record_log.h"
+#include <filesystem>
+#include <unordered_map>
+#include <functional>
+#include <string>
+#include <mutex>
+#include <cstdint>
+
+class TargetManifest {
+public:
+    struct Entry {
+        uint64_t size = 0;
+        int64_t modifiedTime = 0;   // Platform ticks, see GetFileIdentity
+        uint64_t contentHash = 0;   // HashFilePartial of the content, 0 if unknown
+        std::string target;         // UTF-8, relative to the target root; empty for archives
+    };
+
+    static const char* FILE_NAME;
+
+    // Loads <targetRoot>/FILE_NAME (creating it if needed).
+    bool Open(const std::filesystem::path& targetRoot);
+    bool is_open() const { return m_log.is_open(); }
+
+    // True if source was recorded with this size and time and its target
+    // still exists.
+    bool IsUnchanged(const std::filesystem::path& source, uint64_t size, int64_t modifiedTime);
+
+    // placedAt must be inside the target root (or empty for an archive).
+    void Record(const std::filesystem::path& source, uint64_t size, int64_t modifiedTime,
+                uint64_t contentHash, const std::filesystem::path& placedAt);
+
+    // Every recorded placement with a content hash, for seeding DedupIndex
+    void ForEachPlacement(const std::function<void(const Entry& entry, const std::filesystem::path& placedAt)>& fn);
+
+    size_t Size();
+
+private:
+    std::filesystem::path m_root;
+    std::unordered_map<std::string, Entry> m_entries;   // By UTF-8 source path
+    std::mutex m_mutex;
+    RecordLog m_log;
+};
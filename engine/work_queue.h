@@ -0,0 +1,316 @@
+// work_queue.h
+// Bounded multi-producer/multi-consumer queue on a ring of sequenced cells
+// (Vyukov's design): pushing and popping claim a cell with one CAS, no lock.
+// The mutex and condition variables are only touched when a thread has to
+// sleep, on an empty queue (consumers) or a full one (producers), and a
+// wakeup is only sent when someone sleeps. A full queue holds producers
+// back, which keeps a fast scanner from piling up millions of paths.
+// Consumers that also produce (re-queued work) use requeue, which never
+// blocks: what doesn't fit goes to a small locked overflow list.
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+template<typename T>
+class WorkQueue {
+public:
+    explicit WorkQueue(size_t capacity = 4096) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        m_mask = size - 1;
+        m_cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    WorkQueue(const WorkQueue&) = delete;
+    WorkQueue& operator=(const WorkQueue&) = delete;
+
+    // Waits while the queue is full. Returns false (dropping the item) once
+    // the queue is finished or *stop is set.
+    bool push(T item, const std::atomic<bool>* stop = nullptr) {
+        while (!try_push(item)) {
+            if (!WaitForSpace(stop)) return false;
+        }
+        WakeConsumers(false);
+        return true;
+    }
+
+    // Pushes all items, claiming runs of free cells with one CAS and waiting
+    // for space as needed; one wakeup for the lot.
+    bool push_batch(std::vector<T>& items, const std::atomic<bool>* stop = nullptr) {
+        bool ok = true;
+        size_t done = 0;
+        while (done < items.size()) {
+            size_t n = PutMany(items, done);
+            done += n;
+            if (n == 0) {
+                WakeConsumers(true);
+                if (!WaitForSpace(stop)) {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+        items.clear();
+        WakeConsumers(true);
+        return ok;
+    }
+
+    // Never blocks. Meant for consumers putting work back, which would
+    // deadlock waiting on a queue only they drain.
+    void requeue(T item) {
+        if (!try_push(item)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_overflow.push_back(std::move(item));
+            m_overflowCount.fetch_add(1, std::memory_order_seq_cst);
+        }
+        WakeConsumers(false);
+    }
+
+    // Moves item in and returns true if there was room; item is untouched otherwise.
+    bool try_push(T& item) {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(item);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& item) {
+        if (!TakeOne(item)) return false;
+        WakeProducers();
+        return true;
+    }
+
+    // Waits for an item. Returns false once the queue is finished and empty.
+    bool pop(T& item) {
+        while (!try_pop(item)) {
+            if (!WaitForItems()) return false;
+        }
+        return true;
+    }
+
+    // Waits for the first item like pop, then takes whatever else is ready,
+    // up to max items in all, with one CAS.
+    bool pop_batch(std::vector<T>& items, size_t max) {
+        items.clear();
+        while (TakeMany(items, max) == 0) {
+            if (!WaitForItems()) return false;
+        }
+        WakeProducers();
+        return true;
+    }
+
+    // No more items will come: consumers drain what is left and return
+    // false, blocked producers give up.
+    void set_finished() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_finished.store(true);
+        }
+        m_itemsCond.notify_all();
+        m_spaceCond.notify_all();
+    }
+
+    // Approximate while other threads are pushing or popping
+    size_t size() const {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head = m_head.load(std::memory_order_relaxed);
+        return (tail > head ? tail - head : 0) + m_overflowCount.load(std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    // Spinning only helps if the other side runs on another core meanwhile
+    static int SpinCount() {
+        static const int spins = std::thread::hardware_concurrency() > 1 ? 64 : 0;
+        return spins;
+    }
+
+    bool TakeOne(T& item) {
+        if (m_overflowCount.load(std::memory_order_relaxed) > 0 && PopOverflow(item)) return true;
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(cell->data);
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Claims the run of published cells at the head, up to max, with one
+    // CAS and appends them to items. Overflow items come first.
+    size_t TakeMany(std::vector<T>& items, size_t max) {
+        size_t taken = 0;
+        T item;
+        while (taken < max && m_overflowCount.load(std::memory_order_relaxed) > 0 && PopOverflow(item)) {
+            items.push_back(std::move(item));
+            taken++;
+        }
+        if (taken == max) return taken;
+
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        size_t n;
+        while (true) {
+            n = 0;
+            while (taken + n < max && m_cells[(pos + n) & m_mask].sequence.load(std::memory_order_acquire) == pos + n + 1) n++;
+            if (n == 0) {
+                size_t sequence = m_cells[pos & m_mask].sequence.load(std::memory_order_acquire);
+                if ((intptr_t)sequence - (intptr_t)(pos + 1) < 0) return taken;
+                pos = m_head.load(std::memory_order_relaxed);
+            } else if (m_head.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        for (size_t k = 0; k < n; ++k) {
+            Cell& cell = m_cells[(pos + k) & m_mask];
+            items.push_back(std::move(cell.data));
+            cell.sequence.store(pos + k + m_mask + 1, std::memory_order_release);
+        }
+        return taken + n;
+    }
+
+    // Counterpart for producers: claims a run of free cells at the tail for
+    // items[from...], returns how many went in.
+    size_t PutMany(std::vector<T>& items, size_t from) {
+        size_t wanted = items.size() - from;
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        size_t n;
+        while (true) {
+            n = 0;
+            while (n < wanted && m_cells[(pos + n) & m_mask].sequence.load(std::memory_order_acquire) == pos + n) n++;
+            if (n == 0) {
+                size_t sequence = m_cells[pos & m_mask].sequence.load(std::memory_order_acquire);
+                if ((intptr_t)sequence - (intptr_t)pos < 0) return 0;
+                pos = m_tail.load(std::memory_order_relaxed);
+            } else if (m_tail.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        for (size_t k = 0; k < n; ++k) {
+            Cell& cell = m_cells[(pos + k) & m_mask];
+            cell.data = std::move(items[from + k]);
+            cell.sequence.store(pos + k + 1, std::memory_order_release);
+        }
+        return n;
+    }
+
+    bool PopOverflow(T& item) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_overflow.empty()) return false;
+        item = std::move(m_overflow.front());
+        m_overflow.pop_front();
+        m_overflowCount.fetch_sub(1, std::memory_order_seq_cst);
+        return true;
+    }
+
+    bool Empty() const {
+        if (m_overflowCount.load(std::memory_order_seq_cst) > 0) return false;
+        size_t pos = m_head.load(std::memory_order_seq_cst);
+        size_t sequence = m_cells[pos & m_mask].sequence.load(std::memory_order_seq_cst);
+        return sequence != pos + 1;
+    }
+
+    bool Full() const {
+        size_t pos = m_tail.load(std::memory_order_seq_cst);
+        size_t sequence = m_cells[pos & m_mask].sequence.load(std::memory_order_seq_cst);
+        return sequence != pos;
+    }
+
+    // Spins briefly, then sleeps until something may have arrived. False
+    // once finished and drained.
+    bool WaitForItems() {
+        for (int i = 0; i < SpinCount(); ++i) {
+            if (!Empty()) return true;
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sleepingConsumers.fetch_add(1, std::memory_order_seq_cst);
+        m_itemsCond.wait(lock, [this]() { return !Empty() || m_finished.load(); });
+        m_sleepingConsumers.fetch_sub(1, std::memory_order_seq_cst);
+        return !Empty() || !m_finished.load();
+    }
+
+    bool WaitForSpace(const std::atomic<bool>* stop) {
+        if (m_finished.load() || (stop && *stop)) return false;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sleepingProducers.fetch_add(1, std::memory_order_seq_cst);
+        auto ready = [&]() { return !Full() || m_finished.load() || (stop && *stop); };
+        // A stop flag can be set without a notification (signal handler)
+        if (stop) {
+            while (!m_spaceCond.wait_for(lock, std::chrono::milliseconds(50), ready)) {}
+        } else {
+            m_spaceCond.wait(lock, ready);
+        }
+        m_sleepingProducers.fetch_sub(1, std::memory_order_seq_cst);
+        return !m_finished.load() && !(stop && *stop);
+    }
+
+    // Taking the mutex orders the wakeup after a sleeper's last check
+    void WakeConsumers(bool all) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleepingConsumers.load(std::memory_order_seq_cst) == 0) return;
+        { std::lock_guard<std::mutex> lock(m_mutex); }
+        if (all) m_itemsCond.notify_all();
+        else m_itemsCond.notify_one();
+    }
+
+    // Producers are woken together once a quarter of the ring is free, not
+    // one per popped item; consumers always drain that far before sleeping.
+    void WakeProducers() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleepingProducers.load(std::memory_order_seq_cst) == 0) return;
+        if (size() > capacity() - capacity() / 4) return;
+        { std::lock_guard<std::mutex> lock(m_mutex); }
+        m_spaceCond.notify_all();
+    }
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+    alignas(64) std::atomic<int> m_sleepingConsumers{0};
+    std::atomic<int> m_sleepingProducers{0};
+    std::atomic<size_t> m_overflowCount{0};
+    std::atomic<bool> m_finished{false};
+    std::mutex m_mutex;
+    std::condition_variable m_itemsCond;
+    std::condition_variable m_spaceCond;
+    std::deque<T> m_overflow;
+};
@@ -0,0 +1,157 @@
+// zip_reader.cpp
+#include "zip_reader.h"
+#include "record_log.h"
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+static const uint32_t SIG_LOCAL = 0x04034b50;
+static const uint32_t SIG_CENTRAL = 0x02014b50;
+static const uint32_t SIG_EOCD = 0x06054b50;
+static const uint32_t SIG_ZIP64_EOCD = 0x06064b50;
+static const uint32_t SIG_ZIP64_LOCATOR = 0x07064b50;
+
+static inline uint16_t Get16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+bool ZipArchive::Open(const fs::path& file, std::string& error) {
+    m_path = file;
+    m_entries.clear();
+    if (!m_mapped.Open(file)) {
+        error = "Cannot open archive";
+        return false;
+    }
+    const uint8_t* d = m_mapped.data();
+    const size_t n = m_mapped.size();
+
+    // End of central directory: last record, followed by up to 64 KB of comment
+    if (n < 22) {
+        error = "Not a ZIP archive";
+        return false;
+    }
+    size_t eocd = n;
+    size_t stop = n - 22 > 0xFFFF ? n - 22 - 0xFFFF : 0;
+    for (size_t pos = n - 22 + 1; pos-- > stop;) {
+        if (GetLE32(d + pos) == SIG_EOCD && pos + 22 + Get16(d + pos + 20) <= n) {
+            eocd = pos;
+            break;
+        }
+    }
+    if (eocd == n) {
+        error = "Not a ZIP archive";
+        return false;
+    }
+
+    uint64_t count = Get16(d + eocd + 10);
+    uint64_t cdSize = GetLE32(d + eocd + 12);
+    uint64_t cdOffset = GetLE32(d + eocd + 16);
+
+    // Zip64: the real values are in the zip64 record the locator points at
+    if (eocd >= 20 && GetLE32(d + eocd - 20) == SIG_ZIP64_LOCATOR) {
+        uint64_t recordOffset = GetLE64(d + eocd - 20 + 8);
+        if (recordOffset > n - 56 || GetLE32(d + recordOffset) != SIG_ZIP64_EOCD) {
+            error = "Corrupt zip64 directory";
+            return false;
+        }
+        count = GetLE64(d + recordOffset + 32);
+        cdSize = GetLE64(d + recordOffset + 40);
+        cdOffset = GetLE64(d + recordOffset + 48);
+    }
+    if (cdOffset > n || cdSize > n - cdOffset) {
+        error = "Corrupt central directory";
+        return false;
+    }
+
+    m_entries.reserve((size_t)(count < 1000000 ? count : 1000000));
+    size_t pos = (size_t)cdOffset;
+    const size_t end = (size_t)(cdOffset + cdSize);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (end - pos < 46 || GetLE32(d + pos) != SIG_CENTRAL) {
+            error = "Corrupt central directory";
+            return false;
+        }
+        ZipEntry e;
+        e.flags = Get16(d + pos + 8);
+        e.method = Get16(d + pos + 10);
+        e.dosTime = Get16(d + pos + 12);
+        e.dosDate = Get16(d + pos + 14);
+        e.crc32 = GetLE32(d + pos + 16);
+        e.compressedSize = GetLE32(d + pos + 20);
+        e.uncompressedSize = GetLE32(d + pos + 24);
+        uint16_t nameLen = Get16(d + pos + 28);
+        uint16_t extraLen = Get16(d + pos + 30);
+        uint16_t commentLen = Get16(d + pos + 32);
+        e.localHeaderOffset = GetLE32(d + pos + 42);
+        if (end - pos - 46 < (size_t)nameLen + extraLen + commentLen) {
+            error = "Corrupt central directory";
+            return false;
+        }
+        e.name.assign((const char*)d + pos + 46, nameLen);
+
+        // Zip64 extended information: only the fields saturated above, in order
+        const uint8_t* extra = d + pos + 46 + nameLen;
+        for (size_t x = 0; x + 4 <= extraLen;) {
+            uint16_t id = Get16(extra + x);
+            uint16_t len = Get16(extra + x + 2);
+            if (x + 4 + len > extraLen) break;
+            if (id == 0x0001) {
+                const uint8_t* f = extra + x + 4;
+                const uint8_t* fend = f + len;
+                if (e.uncompressedSize == 0xFFFFFFFF && f + 8 <= fend) { e.uncompressedSize = GetLE64(f); f += 8; }
+                if (e.compressedSize == 0xFFFFFFFF && f + 8 <= fend) { e.compressedSize = GetLE64(f); f += 8; }
+                if (e.localHeaderOffset == 0xFFFFFFFF && f + 8 <= fend) { e.localHeaderOffset = GetLE64(f); f += 8; }
+            }
+            x += 4 + (size_t)len;
+        }
+
+        m_entries.push_back(std::move(e));
+        pos += 46 + (size_t)nameLen + extraLen + commentLen;
+    }
+    return true;
+}
+
+// --- MEMBER STREAM ---
+
+bool ZipMemberReader::Open(const ZipArchive& archive, const ZipEntry& entry) {
+    if (!entry.IsSupported()) return false;
+    const uint8_t* d = archive.data();
+    const size_t n = archive.size();
+
+    // The local header repeats name and extra field, possibly with other lengths
+    uint64_t local = entry.localHeaderOffset;
+    if (local > n || n - local < 30 || GetLE32(d + local) != SIG_LOCAL) return false;
+    uint64_t dataOffset = local + 30 + Get16(d + local + 26) + Get16(d + local + 28);
+    if (dataOffset > n || entry.compressedSize > n - dataOffset) return false;
+
+    m_entry = &entry;
+    m_data = d + dataOffset;
+    m_produced = 0;
+    m_crc = 0;
+    m_inflate.reset();
+    if (entry.method == 8) m_inflate.reset(new InflateStream(m_data, (size_t)entry.compressedSize));
+    else if (entry.compressedSize != entry.uncompressedSize) return false;
+    return true;
+}
+
+long ZipMemberReader::Read(uint8_t* out, size_t size) {
+    if (!m_entry) return -1;
+    uint64_t left = m_entry->uncompressedSize - m_produced;
+    if (size > left) size = (size_t)left;
+
+    long n;
+    if (size == 0) {
+        n = 0;
+    } else if (m_inflate) {
+        n = m_inflate->Read(out, size);
+        if (n <= 0) return -1; // Ended before the declared size
+    } else {
+        memcpy(out, m_data + m_produced, size);
+        n = (long)size;
+    }
+
+    m_crc = Crc32(out, (size_t)n, m_crc);
+    m_produced += (uint64_t)n;
+    if (m_produced == m_entry->uncompressedSize && m_crc != m_entry->crc32) return -1;
+    return n;
+}
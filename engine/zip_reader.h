@@ -0,0 +1,64 @@
+// zip_reader.h
+// Read-only ZIP archive access without extracting to disk. The archive is
+// memory-mapped and its central directory parsed once (zip64 included);
+// members are then read as independent streams, so several threads can
+// decompress different members of the same archive at once. Stored and
+// deflated members are supported; encrypted ones are not.
+#pragma once
+
+#include "mapped_file.h"
+#include "inflate.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+struct ZipEntry {
+    std::string name;           // As stored; UTF-8 when the archive says so
+    uint16_t flags = 0;
+    uint16_t method = 0;        // 0 = stored, 8 = deflate
+    uint16_t dosTime = 0;       // Local time of the member's last modification
+    uint16_t dosDate = 0;
+    uint32_t crc32 = 0;
+    uint64_t compressedSize = 0;
+    uint64_t uncompressedSize = 0;
+    uint64_t localHeaderOffset = 0;
+
+    bool IsDirectory() const { return !name.empty() && name.back() == '/'; }
+    bool IsEncrypted() const { return (flags & 1) != 0; }
+    bool IsSupported() const { return !IsEncrypted() && (method == 0 || method == 8); }
+};
+
+class ZipArchive {
+public:
+    // Returns false (with a message in error) if the file isn't a readable ZIP.
+    bool Open(const std::filesystem::path& file, std::string& error);
+
+    const std::filesystem::path& Path() const { return m_path; }
+    const std::vector<ZipEntry>& Entries() const { return m_entries; }
+    const uint8_t* data() const { return m_mapped.data(); }
+    size_t size() const { return m_mapped.size(); }
+
+private:
+    MappedFile m_mapped;
+    std::filesystem::path m_path;
+    std::vector<ZipEntry> m_entries;
+};
+
+// Decompresses one member. The archive must outlive the reader.
+class ZipMemberReader {
+public:
+    bool Open(const ZipArchive& archive, const ZipEntry& entry);
+
+    // Like fread: up to size bytes, 0 at the end, -1 on corrupt data. After
+    // the last byte the CRC is checked; a mismatch also reads as -1.
+    long Read(uint8_t* out, size_t size);
+
+private:
+    const ZipEntry* m_entry = nullptr;
+    const uint8_t* m_data = nullptr;
+    std::unique_ptr<InflateStream> m_inflate;
+    uint64_t m_produced = 0;
+    uint32_t m_crc = 0;
+};
@@ -1,72 +1,22 @@
 #define _WIN32_WINNT 0x0600
 #include <windows.h>
 #include <gdiplus.h>
-#include <winhttp.h>
 #include <shlobj.h>
 #include <shlwapi.h>
 #include <commctrl.h>
 #include "resource.h"
+#include "engine/sorter_engine.h"
 #include <string>
 #include <filesystem>
 #include <thread>
 #include <atomic>
 #include <mutex>
 #include <vector>
-#include <map>
-#include <set>
-#include <sstream>
-#include <iomanip>
-#include <iostream>
-#include <random>
 #include <memory>
-#include <queue>
-#include <condition_variable>
-
-// --- THREAD-SAFE QUEUE ---
-template<typename T>
-class SafeQueue {
-private:
-    std::queue<T> m_queue;
-    std::mutex m_mutex;
-    std::condition_variable m_cond;
-    bool m_finished = false;
-
-public:
-    void push(T item) {
-        {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            m_queue.push(std::move(item));
-        }
-        m_cond.notify_one();
-    }
-
-    bool pop(T& item) {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_cond.wait(lock, [this]() { return !m_queue.empty() || m_finished; });
-        if (m_queue.empty()) return false;
-        item = std::move(m_queue.front());
-        m_queue.pop();
-        return true;
-    }
-
-    void set_finished() {
-        {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            m_finished = true;
-        }
-        m_cond.notify_all();
-    }
-
-    size_t size() {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        return m_queue.size();
-    }
-};
 
 // Link against necessary libraries (MSVC directives)
 #pragma comment(lib, "gdiplus.lib")
 #pragma comment(lib, "gdi32.lib")
-#pragma comment(lib, "winhttp.lib")
 #pragma comment(lib, "shlwapi.lib")
 #pragma comment(lib, "comctl32.lib")
 #pragma comment(lib, "ole32.lib")
@@ -83,8 +33,12 @@ namespace fs = std::filesystem;
 // GLOBAL STATE
 std::wstring g_SourcePath;
 std::wstring g_TargetPath;
+std::wstring g_PlacesFile; // Optional offline geocoding data (.ini only)
+std::wstring g_GeocodeUrl; // Optional Nominatim-compatible server (.ini only)
+std::wstring g_Placement;  // copy (default), move, hardlink or symlink (.ini only)
+std::wstring g_ProfileFile; // JSON run profile written after each run (.ini only)
+std::wstring g_TraceFile;   // Chrome trace of each run (.ini only)
 std::atomic<bool> g_Running(false);
-std::atomic<bool> g_StopRequested(false);
 HWND g_hBtnStart = NULL;
 HWND g_hBtnStop = NULL;
 HWND g_hBtnBrowseSource = NULL;
@@ -96,6 +50,11 @@ HWND g_hProgress = NULL;
 HWND g_hStatus = NULL;
 HWND g_hWnd = NULL;
 
+// Engine of the run in progress (for the Stop button) and the last run's stats
+std::mutex g_EngineMutex;
+SorterEngine* g_pEngine = NULL;
+SortStats g_LastStats;
+
 // --- UI THEME COLORS (RGB) ---
 const COLORREF CLR_BG_DARK      = RGB(5, 5, 8);       // Black
 const COLORREF CLR_BG_LIGHTER   = RGB(15, 15, 20);    // Very Dark Gray
@@ -129,27 +88,9 @@ HFONT g_hFontLabel = NULL;
 HFONT g_hFontButton = NULL;
 HFONT g_hFontStatus = NULL;
 
-// Stats
-std::atomic<int> g_ProcessedCount(0);
-std::atomic<int> g_SuccessCount(0);
-std::atomic<int> g_SkippedCount(0);
-std::atomic<int> g_TotalFiles(0);
-
-// Cache for Geocoding (Lat,Lon -> City Name)
-std::map<std::wstring, std::wstring> g_LocationCache;
-std::mutex g_LocationCacheMutex;
-std::mutex g_NetworkMutex; // Ensure 1 search at a time
-
 // Initializer for GDI+
 ULONG_PTR g_gdiplusToken;
 
-// Helper for RAII GDI+ Image cleanup
-struct GdiPlusImageDeleter {
-    void operator()(Gdiplus::Image* image) {
-        if (image) delete image;
-    }
-};
-
 // --- UI HELPERS ---
 
 void CreateThemeBrushes() {
@@ -253,6 +194,16 @@ void LoadSettings() {
     g_SourcePath = buf;
     GetPrivateProfileStringW(L"Settings", L"Target", L"", buf, MAX_PATH, ini.c_str());
     g_TargetPath = buf;
+    GetPrivateProfileStringW(L"Settings", L"PlacesFile", L"", buf, MAX_PATH, ini.c_str());
+    g_PlacesFile = buf;
+    GetPrivateProfileStringW(L"Settings", L"GeocodeUrl", L"", buf, MAX_PATH, ini.c_str());
+    g_GeocodeUrl = buf;
+    GetPrivateProfileStringW(L"Settings", L"Placement", L"", buf, MAX_PATH, ini.c_str());
+    g_Placement = buf;
+    GetPrivateProfileStringW(L"Settings", L"ProfileFile", L"", buf, MAX_PATH, ini.c_str());
+    g_ProfileFile = buf;
+    GetPrivateProfileStringW(L"Settings", L"TraceFile", L"", buf, MAX_PATH, ini.c_str());
+    g_TraceFile = buf;
 }
 
 void SaveSettings() {
@@ -267,38 +218,38 @@ void Log(const std::wstring& msg) {
     }
 }
 
-// Generate random temp folder name
-std::wstring GenerateTempSubfolderName() {
-    static const char alphanum[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, sizeof(alphanum) - 2);
-    std::wstring s = L"_temp_";
-    for (int i = 0; i < 8; ++i) {
-        s += (wchar_t)alphanum[dis(gen)];
-    }
-    return s;
+std::wstring Utf8ToWide(const std::string& s) {
+    int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, NULL, 0);
+    if (len <= 0) return L"";
+    std::vector<wchar_t> wbuf(len);
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, &wbuf[0], len);
+    return std::wstring(&wbuf[0]);
 }
 
-// Execute command hidden
-bool RunCommand(const std::wstring& cmd, const std::wstring& args) {
-    SHELLEXECUTEINFOW sei = { sizeof(SHELLEXECUTEINFOW) };
-    sei.fMask = SEE_MASK_NOCLOSEPROCESS | SEE_MASK_FLAG_NO_UI;
-    sei.lpVerb = L"open";
-    sei.lpFile = cmd.c_str();
-    sei.lpParameters = args.c_str();
-    sei.nShow = SW_HIDE;
-    
-    if (ShellExecuteExW(&sei)) {
-        WaitForSingleObject(sei.hProcess, INFINITE);
-        DWORD exitCode = 0;
-        GetExitCodeProcess(sei.hProcess, &exitCode);
-        CloseHandle(sei.hProcess);
-        return exitCode == 0;
-    }
-    return false;
+std::string WideToUtf8(const std::wstring& s) {
+    int len = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, NULL, 0, NULL, NULL);
+    if (len <= 0) return "";
+    std::vector<char> buf(len);
+    WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, &buf[0], len, NULL, NULL);
+    return std::string(&buf[0]);
 }
 
+// Forwards engine progress to the status line and progress bar.
+class GuiProgressListener : public SortProgressListener {
+public:
+    void OnStatus(const std::string& message) override {
+        Log(Utf8ToWide(message));
+    }
+
+    void OnTotal(int totalFiles, bool /*final*/) override {
+        SendMessage(g_hProgress, PBM_SETRANGE32, 0, totalFiles);
+    }
+
+    void OnProgress(int processed, int /*totalFiles*/) override {
+        SendMessage(g_hProgress, PBM_SETPOS, processed, 0);
+    }
+};
+
 // --- OPEN FOLDER DIALOG ---
 
 static int CALLBACK BrowseCallbackProc(HWND hwnd, UINT uMsg, LPARAM lParam, LPARAM lpData) {
@@ -331,329 +282,69 @@ bool SelectFolder(HWND hWnd, std::wstring& path, const wchar_t* title) {
     return false;
 }
 
-// --- METADATA & IMAGE PROCESSING ---
-
-// Helper to convert rational to double
-double RationalToDouble(PropertyItem* item, int index = 0) {
-    if (item->type != PropertyTagTypeRational) return 0.0;
-    long* rational = (long*)item->value;
-    long num = rational[index * 2];
-    long den = rational[index * 2 + 1];
-    if (den == 0) return 0.0;
-    return (double)num / (double)den;
-}
-
-// Helper to get GPS coordinate
-double GetGPSCoordinate(PropertyItem* itemInfo, PropertyItem* itemRef) {
-    // Info has 3 rationals: deg, min, sec
-    double deg = RationalToDouble(itemInfo, 0);
-    double min = RationalToDouble(itemInfo, 1);
-    double sec = RationalToDouble(itemInfo, 2);
-    double result = deg + min / 60.0 + sec / 3600.0;
-
-    // Ref is a string "N", "S", "E", "W"
-    if (itemRef && itemRef->value) {
-        char ref = ((char*)itemRef->value)[0];
-        if (ref == 'S' || ref == 'W') {
-            result *= -1.0;
-        }
-    }
-    return result;
-}
-
-std::wstring ReverseGeocode(double lat, double lon) {
-    // Limit precision to avoid hammering API
-    std::wstringstream keyInfo;
-    keyInfo << std::fixed << std::setprecision(3) << lat << L"_" << lon;
-    std::wstring key = keyInfo.str();
-
-    {
-        std::lock_guard<std::mutex> lock(g_LocationCacheMutex);
-        if (g_LocationCache.find(key) != g_LocationCache.end()) {
-            return g_LocationCache[key];
-        }
-    }
-
-    std::wstring result = L""; 
-
-    // WinHTTP Request (Synchronized to 1 request at a time)
-    {
-        std::lock_guard<std::mutex> networkLock(g_NetworkMutex);
-        
-        HINTERNET hSession = WinHttpOpen(L"MediaSorter/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
-        if (hSession) {
-            HINTERNET hConnect = WinHttpConnect(hSession, L"nominatim.openstreetmap.org", INTERNET_DEFAULT_HTTPS_PORT, 0);
-            if (hConnect) {
-                std::wstring path = L"/reverse?format=json&lat=" + std::to_wstring(lat) + L"&lon=" + std::to_wstring(lon) + L"&zoom=10"; 
-                HINTERNET hRequest = WinHttpOpenRequest(hConnect, L"GET", path.c_str(), NULL, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, WINHTTP_FLAG_SECURE);
-                if (hRequest) {
-                    if (WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0, WINHTTP_NO_REQUEST_DATA, 0, 0, 0)) {
-                        if (WinHttpReceiveResponse(hRequest, NULL)) {
-                            DWORD dwSize = 0;
-                            DWORD dwDownloaded = 0;
-                            std::string response;
-                            do {
-                                dwSize = 0;
-                                if (!WinHttpQueryDataAvailable(hRequest, &dwSize)) break;
-                                if (dwSize == 0) break;
-                                char* tempBuffer = new char[dwSize + 1];
-                                if (!tempBuffer) break;
-                                if (WinHttpReadData(hRequest, tempBuffer, dwSize, &dwDownloaded)) {
-                                    tempBuffer[dwDownloaded] = 0;
-                                    response += tempBuffer;
-                                }
-                                delete[] tempBuffer;
-                            } while (dwSize > 0);
-
-                            auto extract = [&](const std::string& key) -> std::wstring {
-                                std::string search = "\"" + key + "\":\"";
-                                size_t pos = response.find(search);
-                                if (pos != std::string::npos) {
-                                    size_t end = response.find("\"", pos + search.length());
-                                    if (end != std::string::npos) {
-                                        std::string val = response.substr(pos + search.length(), end - (pos + search.length()));
-                                        int len = MultiByteToWideChar(CP_UTF8, 0, val.c_str(), -1, NULL, 0);
-                                        if (len > 0) {
-                                            std::vector<wchar_t> wbuf(len);
-                                            MultiByteToWideChar(CP_UTF8, 0, val.c_str(), -1, &wbuf[0], len);
-                                            return std::wstring(&wbuf[0]);
-                                        }
-                                    }
-                                }
-                                return L"";
-                            };
-
-                            result = extract("city");
-                            if (result.empty()) result = extract("town");
-                            if (result.empty()) result = extract("village");
-                            if (result.empty()) result = extract("municipality");
-                        }
-                    }
-                    WinHttpCloseHandle(hRequest);
-                }
-                WinHttpCloseHandle(hConnect);
-            }
-            WinHttpCloseHandle(hSession);
-        }
-        
-        // Respect Nominatim Usage Policy (max 1 req/sec)
-        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
-    }
-
-    {
-        std::lock_guard<std::mutex> lock(g_LocationCacheMutex);
-        g_LocationCache[key] = result;
-    }
-    return result;
-}
+// --- CUSTOM SUMMARY DIALOG ---
 
-struct FileMetadata {
-    SYSTEMTIME date;
-    bool hasDate = false;
-    std::wstring location = L"";
+struct SummaryRow {
+    std::wstring label;
+    std::wstring value;
 };
 
-FileMetadata GetFileMetadata(const std::wstring& path) {
-    FileMetadata meta;
-    memset(&meta.date, 0, sizeof(SYSTEMTIME));
-
-    try {
-        // Default to File Modification Time
-        HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-        if (hFile != INVALID_HANDLE_VALUE) {
-            FILETIME ftWrite;
-            if (GetFileTime(hFile, NULL, NULL, &ftWrite)) {
-                 FileTimeToSystemTime(&ftWrite, &meta.date);
-            }
-            CloseHandle(hFile);
-        }
-
-        // Try GDI+ for Images
-        std::unique_ptr<Gdiplus::Image, GdiPlusImageDeleter> image(new Gdiplus::Image(path.c_str()));
-        if (image && image->GetLastStatus() == Gdiplus::Ok) {
-            // 1. Date (PropertyTagExifDTOrig = 0x9003)
-            UINT size = image->GetPropertyItemSize(0x9003);
-            if (size > 0) {
-                PropertyItem* item = (PropertyItem*)malloc(size);
-                if (item) {
-                    if (image->GetPropertyItem(0x9003, size, item) == Gdiplus::Ok) {
-                       char* dateStr = (char*)item->value;
-                       if (dateStr && strlen(dateStr) >= 19) {
-                           try {
-                               meta.date.wYear = std::stoi(std::string(dateStr, 4));
-                               meta.date.wMonth = std::stoi(std::string(dateStr + 5, 2));
-                               meta.date.wDay = std::stoi(std::string(dateStr + 8, 2));
-                               meta.date.wHour = std::stoi(std::string(dateStr + 11, 2));
-                               meta.date.wMinute = std::stoi(std::string(dateStr + 14, 2));
-                               meta.date.wSecond = std::stoi(std::string(dateStr + 17, 2));
-                               meta.hasDate = true;
-                           } catch (...) {}
-                       }
-                    }
-                    free(item);
-                }
-            }
-
-            // 2. GPS
-            UINT latSize = image->GetPropertyItemSize(0x0002);
-            UINT latRefSize = image->GetPropertyItemSize(0x0001);
-            UINT lonSize = image->GetPropertyItemSize(0x0004);
-            UINT lonRefSize = image->GetPropertyItemSize(0x0003);
-
-            if (latSize > 0 && latRefSize > 0 && lonSize > 0 && lonRefSize > 0) {
-                PropertyItem* latItem = (PropertyItem*)malloc(latSize);
-                PropertyItem* latRefItem = (PropertyItem*)malloc(latRefSize);
-                PropertyItem* lonItem = (PropertyItem*)malloc(lonSize);
-                PropertyItem* lonRefItem = (PropertyItem*)malloc(lonRefSize);
-
-                if (latItem && latRefItem && lonItem && lonRefItem) {
-                    bool ok = (image->GetPropertyItem(0x0002, latSize, latItem) == Ok) &&
-                              (image->GetPropertyItem(0x0001, latRefSize, latRefItem) == Ok) &&
-                              (image->GetPropertyItem(0x0004, lonSize, lonItem) == Ok) &&
-                              (image->GetPropertyItem(0x0003, lonRefSize, lonRefItem) == Ok);
-
-                    if (ok) {
-                        double lat = GetGPSCoordinate(latItem, latRefItem);
-                        double lon = GetGPSCoordinate(lonItem, lonRefItem);
-                        try {
-                            meta.location = ReverseGeocode(lat, lon);
-                        } catch (...) {}
-                    }
-                }
-                if(latItem) free(latItem); 
-                if(latRefItem) free(latRefItem); 
-                if(lonItem) free(lonItem); 
-                if(lonRefItem) free(lonRefItem);
-            }
-        }
-    } catch (...) {
-        // Log(L"Error reading metadata");
-    }
-
-    return meta;
-}
-
-// Forward declaration
-void ProcessDirectory(const fs::path& dir);
-
-void ProcessZip(const fs::path& zipPath) {
-    try {
-        std::wstring tempName = GenerateTempSubfolderName();
-        fs::path tempDir = fs::path(g_TargetPath) / tempName;
-
-        fs::create_directories(tempDir);
-        Log((L"Extracting ZIP: " + zipPath.filename().wstring()).c_str());
-
-        // Extract using tar
-        // tar -xf "zipfile" -C "tempdir"
-        std::wstring args = L"-xf \"" + zipPath.wstring() + L"\" -C \"" + tempDir.wstring() + L"\"";
-        
-        // Note: tar should be in path on Windows 10/11
-        if (RunCommand(L"tar.exe", args)) {
-             ProcessDirectory(tempDir);
-        } else {
-             Log(L"Failed to extract ZIP.");
-        }
-
-        // Cleanup
-        std::error_code ec;
-        fs::remove_all(tempDir, ec);
-
-    } catch (...) {
-        Log(L"ZIP Processing Error");
-    }
-}
-
-void ProcessFile(const fs::path& filePath) {
-    if (g_StopRequested) return;
-
-    try {
-        std::wstring filename = filePath.filename().wstring();
-        std::wstring ext = filePath.extension().wstring();
-        
-        // Check for ZIP
-        if (ext == L".zip" || ext == L".ZIP") {
-            ProcessZip(filePath);
-            return;
-        }
-
-        g_ProcessedCount++;
-        SendMessage(g_hProgress, PBM_SETPOS, g_ProcessedCount, 0);
-        Log((L"Processing: " + filename).c_str());
-
-        FileMetadata meta = GetFileMetadata(filePath.wstring());
-
-        // Build Target Path (V2)
-        // Target/YYYY/YYYY-MM/
-        std::wstringstream ssPath;
-        ssPath << g_TargetPath << L"\\" << meta.date.wYear << L"\\" 
-               << meta.date.wYear << L"-" << std::setw(2) << std::setfill(L'0') << meta.date.wMonth << L"\\";
-
-        // Filename: YYYY-MM-DD HH-mm-ss [Location].ext
-        std::wstringstream ssName;
-        ssName << meta.date.wYear << L"-"
-               << std::setw(2) << std::setfill(L'0') << meta.date.wMonth << L"-"
-               << std::setw(2) << std::setfill(L'0') << meta.date.wDay << L" "
-               << std::setw(2) << std::setfill(L'0') << meta.date.wHour << L"-"
-               << std::setw(2) << std::setfill(L'0') << meta.date.wMinute << L"-"
-               << std::setw(2) << std::setfill(L'0') << meta.date.wSecond;
-
-        if (!meta.location.empty()) {
-            ssName << L" " << meta.location;
-        }
-
-        std::wstring baseName = ssName.str();
-        
-        fs::path targetDir = ssPath.str();
-        
-        fs::create_directories(targetDir);
-
-        fs::path targetFile = targetDir / (baseName + ext);
-        int dup = 0;
-        bool isDuplicate = false;
-
-        while (fs::exists(targetFile)) {
-             std::error_code ec;
-             if (fs::file_size(targetFile, ec) == fs::file_size(filePath, ec)) {
-                  g_SkippedCount++; 
-                  isDuplicate = true;
-                  break;
-             }
-             dup++;
-             targetFile = targetDir / (baseName + L"_" + std::to_wstring(dup) + ext);
-        }
-
-        if (!isDuplicate) {
-            fs::copy_file(filePath, targetFile);
-            g_SuccessCount++;
-        }
-    } catch (const std::exception& e) {
-        g_SkippedCount++;
-        std::wstring err = L"Error: ";
-        std::string what = e.what();
-        err += std::wstring(what.begin(), what.end());
-        Log(err);
-    } catch (...) {
-        g_SkippedCount++;
-        Log(L"Unknown error processing file.");
-    }
+std::wstring FormatSeconds(double seconds) {
+    wchar_t buf[32];
+    swprintf(buf, 32, L"%.2f s", seconds);
+    return buf;
 }
 
-void ProcessDirectory(const fs::path& dir) {
-    try {
-        for (const auto& entry : fs::recursive_directory_iterator(dir)) {
-            if (g_StopRequested) break;
-            if (entry.is_regular_file()) {
-                ProcessFile(entry.path());
-            }
-        }
-    } catch (...) {
-        // Directory access error
-    }
+std::vector<SummaryRow> BuildSummaryRows() {
+    std::vector<SummaryRow> rows;
+    rows.push_back({ L"\u2022 Total Files Found:", std::to_wstring(g_LastStats.totalFiles) });
+    rows.push_back({ L"\u2022 Successfully Copied:", std::to_wstring(g_LastStats.copied) });
+    rows.push_back({ L"\u2022 Skipped (Duplicates):", std::to_wstring(g_LastStats.skipped) });
+    rows.push_back({ L"\u2022 Processed Total:", std::to_wstring(g_LastStats.processed) });
+    if (g_LastStats.bytesPlaced > 0) {
+        wchar_t buf[64];
+        swprintf(buf, 64, L"%.1f MB (%.1f MB written)", g_LastStats.bytesPlaced / (1024.0 * 1024.0),
+                 g_LastStats.bytesWritten / (1024.0 * 1024.0));
+        rows.push_back({ L"\u2022 Bytes Placed:", buf });
+    }
+    if (g_LastStats.unchanged > 0) {
+        rows.push_back({ L"\u2022 Already Sorted:", std::to_wstring(g_LastStats.unchanged) });
+    }
+    if (g_LastStats.duplicates > 0) {
+        rows.push_back({ L"\u2022 Same Content:", std::to_wstring(g_LastStats.duplicates) });
+    }
+    if (!g_LastStats.archives.empty()) {
+        int members = 0;
+        for (const ArchiveStats& archive : g_LastStats.archives) members += archive.members;
+        rows.push_back({ L"\u2022 Archives Read:", std::to_wstring(g_LastStats.archives.size()) + L" (" + std::to_wstring(members) + L" files)" });
+    }
+    std::wstring formats;
+    for (const FormatStats& format : g_LastStats.formats) {
+        if (format.files == 0) continue;
+        if (!formats.empty()) formats += L", ";
+        formats += std::wstring(format.name.begin(), format.name.end()) + L" " + std::to_wstring(format.files);
+    }
+    if (!formats.empty()) rows.push_back({ L"\u2022 Formats:", formats });
+    if (g_LastStats.firstCopySeconds >= 0) {
+        rows.push_back({ L"\u2022 Time to First Copy:", FormatSeconds(g_LastStats.firstCopySeconds) });
+    }
+    rows.push_back({ L"\u2022 Elapsed:", FormatSeconds(g_LastStats.elapsedSeconds) });
+    uint64_t lookups = g_LastStats.geocodeCacheHits + g_LastStats.geocodeCacheMisses;
+    if (lookups > 0) {
+        wchar_t buf[64];
+        swprintf(buf, 64, L"%llu/%llu (%.0f%%)", (unsigned long long)g_LastStats.geocodeCacheHits,
+                 (unsigned long long)lookups, 100.0 * g_LastStats.geocodeCacheHits / lookups);
+        rows.push_back({ L"\u2022 Geocode Cache Hits:", buf });
+    }
+    if (g_LastStats.geocodeRequests > 0) {
+        rows.push_back({ L"\u2022 Geocode Requests:", std::to_wstring(g_LastStats.geocodeRequests) });
+    }
+    if (g_LastStats.geocodeLookupsSaved > 0) {
+        rows.push_back({ L"\u2022 Geocode Lookups Saved:", std::to_wstring(g_LastStats.geocodeLookupsSaved) });
+    }
+    return rows;
 }
 
-// --- CUSTOM SUMMARY DIALOG ---
-
 LRESULT CALLBACK SummaryWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
     switch (message) {
     case WM_CREATE: {
@@ -665,16 +356,16 @@ LRESULT CALLBACK SummaryWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM l
         int valueX = 240;
         int rowH = 24;
 
-        auto addRow = [&](const wchar_t* label, int val, int id) {
-            CreateWindowW(L"STATIC", label, WS_VISIBLE | WS_CHILD | SS_LEFT, labelX, y, 200, rowH, hWnd, (HMENU)(size_t)(400 + id), NULL, NULL);
-            CreateWindowW(L"STATIC", std::to_wstring(val).c_str(), WS_VISIBLE | WS_CHILD | SS_RIGHT, valueX, y, 60, rowH, hWnd, (HMENU)(size_t)(500 + id), NULL, NULL);
+        auto addRow = [&](const std::wstring& label, const std::wstring& val, int id) {
+            CreateWindowW(L"STATIC", label.c_str(), WS_VISIBLE | WS_CHILD | SS_LEFT, labelX, y, 200, rowH, hWnd, (HMENU)(size_t)(400 + id), NULL, NULL);
+            CreateWindowW(L"STATIC", val.c_str(), WS_VISIBLE | WS_CHILD | SS_RIGHT, valueX, y, 60, rowH, hWnd, (HMENU)(size_t)(500 + id), NULL, NULL);
             y += rowH;
         };
 
-        addRow(L"\u2022 Total Files Found:", g_TotalFiles, 1);
-        addRow(L"\u2022 Successfully Copied:", g_SuccessCount, 2);
-        addRow(L"\u2022 Skipped (Duplicates):", g_SkippedCount, 3);
-        addRow(L"\u2022 Processed Total:", g_ProcessedCount, 4);
+        std::vector<SummaryRow> rows = BuildSummaryRows();
+        for (size_t i = 0; i < rows.size(); ++i) {
+            addRow(rows[i].label, rows[i].value, (int)i + 1);
+        }
 
         y += 20;
         CreateWindowW(L"STATIC", L"Your media is now organized and ready.", WS_VISIBLE | WS_CHILD | SS_LEFT, 20, y, 320, 20, hWnd, (HMENU)302, NULL, NULL);
@@ -717,7 +408,7 @@ void ShowSummaryDialog(HWND hParent) {
     wc.hbrBackground = (HBRUSH)(COLOR_BTNFACE + 1);
     RegisterClassW(&wc);
 
-    int w = 360, h = 300;
+    int w = 360, h = 204 + (int)BuildSummaryRows().size() * 24;
     RECT pr; GetWindowRect(hParent, &pr);
     int x = pr.left + (pr.right - pr.left - w) / 2;
     int y = pr.top + (pr.bottom - pr.top - h) / 2;
@@ -738,14 +429,6 @@ void ShowSummaryDialog(HWND hParent) {
     UnregisterClassW(className.c_str(), wc.hInstance);
 }
 
-void WorkerThread(SafeQueue<fs::path>& queue) {
-    fs::path filePath;
-    while (queue.pop(filePath)) {
-        if (g_StopRequested) break;
-        ProcessFile(filePath);
-    }
-}
-
 void ScanningThread() {
     if (g_SourcePath.empty() || g_TargetPath.empty()) {
         MessageBoxW(g_hWnd, L"Please select Source and Target folders.", L"Error", MB_ICONERROR);
@@ -755,68 +438,49 @@ void ScanningThread() {
         return;
     }
 
-    // Reset stats
-    g_ProcessedCount = 0;
-    g_SuccessCount = 0;
-    g_SkippedCount = 0;
-    g_TotalFiles = 0;
-
-    Log(L"Counting files...");
-    
-    std::vector<fs::path> rootFiles;
-    try {
-        for (const auto& entry : fs::recursive_directory_iterator(g_SourcePath)) {
-            if (g_StopRequested) break;
-            if (entry.is_regular_file()) {
-                rootFiles.push_back(entry.path());
-            }
-        }
-    } catch (...) {
-        MessageBoxW(g_hWnd, L"Error reading source directory.", L"Error", MB_ICONERROR);
-        g_Running = false;
-        return;
-    }
-
-    if (rootFiles.empty()) {
-        Log(L"No files found.");
-        g_Running = false;
-        EnableWindow(g_hBtnStart, TRUE);
-        EnableWindow(g_hBtnStop, FALSE);
-        return;
+    SortOptions options;
+    options.sourcePath = g_SourcePath;
+    options.targetPath = g_TargetPath;
+    if (!g_PlacesFile.empty()) {
+        options.geocodeMode = GeocodeMode::Offline;
+        options.placesFile = g_PlacesFile;
+    } else {
+        // Next to the .ini, so lookups are reused by later runs
+        std::wstring ini = GetIniPath();
+        options.geocodeCacheFile = ini.substr(0, ini.find_last_of(L".")) + L".geocache";
+        options.geocodeUrl = WideToUtf8(g_GeocodeUrl);
+    }
+    ParsePlacementMode(WideToUtf8(g_Placement), options.placement);
+    options.profileFile = g_ProfileFile;
+    options.traceFile = g_TraceFile;
+
+    GuiProgressListener listener;
+    SorterEngine engine(options, &listener);
+    {
+        std::lock_guard<std::mutex> lock(g_EngineMutex);
+        g_pEngine = &engine;
     }
 
-    g_TotalFiles = (int)rootFiles.size();
-    SendMessage(g_hProgress, PBM_SETRANGE, 0, MAKELPARAM(0, g_TotalFiles));
-    SendMessage(g_hProgress, PBM_SETPOS, 0, 0);
-
-    SafeQueue<fs::path> queue;
-    int numThreads = std::thread::hardware_concurrency();
-    if (numThreads < 1) numThreads = 2;
-    if (numThreads > 8) numThreads = 8; // Don't overwhelm IO
-
-    std::vector<std::thread> workers;
-    for (int i = 0; i < numThreads; ++i) {
-        workers.emplace_back(WorkerThread, std::ref(queue));
+    bool ok = true;
+    try {
+        g_LastStats = engine.Run();
+    } catch (const std::exception& e) {
+        std::string what = e.what();
+        MessageBoxW(g_hWnd, Utf8ToWide(what).c_str(), L"Error", MB_ICONERROR);
+        ok = false;
     }
 
-    Log(L"Processing in parallel...");
-    for (const auto& filePath : rootFiles) {
-        if (g_StopRequested) break;
-        queue.push(filePath);
+    {
+        std::lock_guard<std::mutex> lock(g_EngineMutex);
+        g_pEngine = NULL;
     }
-    queue.set_finished();
 
-    for (auto& t : workers) {
-        t.join();
+    if (ok && g_LastStats.totalFiles > 0) {
+        ShowWindow(g_hProgress, SW_HIDE);
+        ShowSummaryDialog(g_hWnd);
     }
 
-    Log(L"Finished.");
-    ShowWindow(g_hProgress, SW_HIDE);
-
-    ShowSummaryDialog(g_hWnd);
-
     g_Running = false;
-    g_StopRequested = false;
     EnableWindow(g_hBtnStart, TRUE);
     EnableWindow(g_hBtnStop, FALSE);
 }
@@ -1061,7 +725,6 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 
             if (g_Running) break;
             g_Running = true;
-            g_StopRequested = false;
             ShowWindow(g_hProgress, SW_SHOW);
             EnableWindow(g_hBtnStart, FALSE);
             EnableWindow(g_hBtnStop, TRUE);
@@ -1071,7 +734,8 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
         }
         else if (id == 104) { // Stop
             if (g_Running) {
-                g_StopRequested = true;
+                std::lock_guard<std::mutex> lock(g_EngineMutex);
+                if (g_pEngine) g_pEngine->RequestStop();
                 Log(L"Stopping...");
             }
         } else if (id == 105) { // Help
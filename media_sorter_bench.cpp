@@ -0,0 +1,1971 @@
+// media_sorter_bench.cpp
+// Command line benchmarks and synthetic corpus generation for Media Sorter XXL.
+// Run without arguments for usage.
+#ifdef _WIN32
+#define _WIN32_WINNT 0x0600
+#include <winsock2.h>
+#include <windows.h>
+#include <gdiplus.h>
+#pragma comment(lib, "gdiplus.lib")
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+#include "engine/exif_reader.h"
+#include "engine/bmff_reader.h"
+#include "engine/dir_walker.h"
+#include "engine/disk_order.h"
+#include "engine/file_copy.h"
+#include "engine/io_ring.h"
+#include "engine/safe_queue.h"
+#include "engine/work_queue.h"
+#include "engine/file_metadata.h"
+#include "engine/content_hash.h"
+#include "engine/offline_geocoder.h"
+#include "engine/http_client.h"
+#include "engine/source_file.h"
+#include "engine/record_log.h"
+#include "engine/sorter_engine.h"
+#include <string>
+#include <filesystem>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <set>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <map>
+#include <regex>
+#include <ctime>
+#include <cmath>
+
+namespace fs = std::filesystem;
+
+// --- HELPERS ---
+
+struct ByteWriter {
+    std::vector<uint8_t> data;
+
+    void u8(uint8_t v) { data.push_back(v); }
+    void le16(uint16_t v) { u8((uint8_t)v); u8((uint8_t)(v >> 8)); }
+    void le32(uint32_t v) { le16((uint16_t)v); le16((uint16_t)(v >> 16)); }
+    void be16(uint16_t v) { u8((uint8_t)(v >> 8)); u8((uint8_t)v); }
+    void be32(uint32_t v) { be16((uint16_t)(v >> 16)); be16((uint16_t)v); }
+    void bytes(const void* p, size_t n) { data.insert(data.end(), (const uint8_t*)p, (const uint8_t*)p + n); }
+    void fill(uint8_t v, size_t n) { data.insert(data.end(), n, v); }
+    size_t size() const { return data.size(); }
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<fs::path> ListFiles(const fs::path& dir) {
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::recursive_directory_iterator(dir)) {
+        if (entry.is_regular_file()) files.push_back(entry.path());
+    }
+    return files;
+}
+
+// --- SYNTHETIC JPEG ---
+
+// Little-endian TIFF block with DateTimeOriginal and, optionally, GPS tags.
+// With a gap, IFD0 and the rest follow that many bytes after the header,
+// where a RAW file would have its sensor data.
+std::vector<uint8_t> BuildExifTiff(const char* date, bool withGps, double lat, double lon, size_t gap = 0) {
+    ByteWriter w;
+    uint32_t ifd0 = 8 + (uint32_t)gap;
+    w.bytes("II", 2); w.le16(42); w.le32(ifd0);
+    w.fill(0, gap);
+
+    auto entry = [&](uint16_t tag, uint16_t type, uint32_t count, uint32_t value) {
+        w.le16(tag); w.le16(type); w.le32(count); w.le32(value);
+    };
+
+    uint16_t ifd0Count = withGps ? 2 : 1;
+    uint32_t exifIfd = ifd0 + 2 + ifd0Count * 12 + 4;
+    uint32_t dateOff = exifIfd + 2 + 12 + 4;
+    uint32_t gpsIfd = dateOff + 20;
+    uint32_t latOff = gpsIfd + 2 + 4 * 12 + 4;
+    uint32_t lonOff = latOff + 24;
+
+    w.le16(ifd0Count);
+    entry(exif::TAG_EXIF_IFD, exif::TYPE_LONG, 1, exifIfd);
+    if (withGps) entry(exif::TAG_GPS_IFD, exif::TYPE_LONG, 1, gpsIfd);
+    w.le32(0);
+
+    w.le16(1);
+    entry(exif::TAG_DATE_ORIGINAL, exif::TYPE_ASCII, 20, dateOff);
+    w.le32(0);
+    w.bytes(date, 20);
+
+    if (withGps) {
+        auto ref = [](char c) { return (uint32_t)(uint8_t)c; };
+        w.le16(4);
+        entry(exif::TAG_GPS_LAT_REF, exif::TYPE_ASCII, 2, ref(lat < 0 ? 'S' : 'N'));
+        entry(exif::TAG_GPS_LAT, exif::TYPE_RATIONAL, 3, latOff);
+        entry(exif::TAG_GPS_LON_REF, exif::TYPE_ASCII, 2, ref(lon < 0 ? 'W' : 'E'));
+        entry(exif::TAG_GPS_LON, exif::TYPE_RATIONAL, 3, lonOff);
+        w.le32(0);
+
+        auto dms = [&](double v) {
+            v = v < 0 ? -v : v;
+            uint32_t deg = (uint32_t)v;
+            double m = (v - deg) * 60.0;
+            uint32_t min = (uint32_t)m;
+            uint32_t sec100 = (uint32_t)((m - min) * 60.0 * 100.0 + 0.5);
+            w.le32(deg); w.le32(1);
+            w.le32(min); w.le32(1);
+            w.le32(sec100); w.le32(100);
+        };
+        dms(lat);
+        dms(lon);
+    }
+    return w.data;
+}
+
+// Smallest valid baseline JPEG: grayscale, every 8x8 block flat, so any decoder
+// (including GDI+) accepts it. The scan data is two bits per block.
+std::vector<uint8_t> BuildJpeg(const std::vector<uint8_t>& tiff, int width, int height, size_t padBytes) {
+    ByteWriter w;
+    w.be16(0xFFD8);
+
+    w.be16(0xFFE1);
+    w.be16((uint16_t)(2 + 6 + tiff.size()));
+    w.bytes("Exif\0\0", 6);
+    w.bytes(tiff.data(), tiff.size());
+
+    w.be16(0xFFDB); w.be16(67); w.u8(0); w.fill(1, 64);                      // DQT
+    w.be16(0xFFC0); w.be16(11); w.u8(8); w.be16((uint16_t)height); w.be16((uint16_t)width);
+    w.u8(1); w.u8(1); w.u8(0x11); w.u8(0);                                   // SOF0
+    w.be16(0xFFC4); w.be16(20); w.u8(0x00); w.u8(1); w.fill(0, 15); w.u8(0); // DHT DC: cat 0 = "0"
+    w.be16(0xFFC4); w.be16(20); w.u8(0x10); w.u8(1); w.fill(0, 15); w.u8(0); // DHT AC: EOB = "0"
+    w.be16(0xFFDA); w.be16(8); w.u8(1); w.u8(1); w.u8(0x00); w.u8(0); w.u8(63); w.u8(0);
+
+    size_t blocks = (size_t)((width + 7) / 8) * (size_t)((height + 7) / 8);
+    size_t bits = blocks * 2;
+    w.fill(0, bits / 8);
+    if (bits % 8) w.u8((uint8_t)(0xFF >> (bits % 8))); // pad with 1-bits
+
+    w.be16(0xFFD9);
+    w.fill(0, padBytes); // trailing data, ignored by decoders
+    return w.data;
+}
+
+int CmdGenJpeg(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: gen-jpeg <dir> <count> [--width W] [--height H] [--gps-ratio R] [--gps-clusters N] [--pad-kb K] [--seed S]\n";
+        return 2;
+    }
+    fs::path dir = argv[0];
+    int count = std::atoi(argv[1]);
+    int width = 1024, height = 768, padKb = 0, gpsClusters = 0;
+    double gpsRatio = 0.5;
+    unsigned seed = 1;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--width") width = std::atoi(argv[i + 1]);
+        else if (opt == "--height") height = std::atoi(argv[i + 1]);
+        else if (opt == "--gps-ratio") gpsRatio = std::atof(argv[i + 1]);
+        else if (opt == "--gps-clusters") gpsClusters = std::atoi(argv[i + 1]);
+        else if (opt == "--pad-kb") padKb = std::atoi(argv[i + 1]);
+        else if (opt == "--seed") seed = (unsigned)std::atoi(argv[i + 1]);
+    }
+
+    fs::create_directories(dir);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    // With --gps-clusters, positions scatter within ~1 km of a few spots
+    // (like photos along a hike) instead of all over the globe
+    std::vector<std::pair<double, double>> centers;
+    for (int c = 0; c < gpsClusters; ++c) {
+        centers.emplace_back(unit(rng) * 140.0 - 70.0, unit(rng) * 360.0 - 180.0);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        char date[20];
+        snprintf(date, sizeof(date), "%04d:%02d:%02d %02d:%02d:%02d",
+                 2000 + (int)(rng() % 25), 1 + (int)(rng() % 12), 1 + (int)(rng() % 28),
+                 (int)(rng() % 24), (int)(rng() % 60), (int)(rng() % 60));
+        bool gps = unit(rng) < gpsRatio;
+        double lat = unit(rng) * 140.0 - 70.0;
+        double lon = unit(rng) * 360.0 - 180.0;
+        if (!centers.empty()) {
+            const auto& center = centers[rng() % centers.size()];
+            lat = center.first + (lat / 70.0) * 0.01;
+            lon = center.second + (lon / 180.0) * 0.01;
+        }
+
+        std::vector<uint8_t> jpeg = BuildJpeg(BuildExifTiff(date, gps, lat, lon), width, height, (size_t)padKb * 1024);
+        char name[32];
+        snprintf(name, sizeof(name), "IMG_%06d.jpg", i);
+        std::ofstream out(dir / name, std::ios::binary);
+        out.write((const char*)jpeg.data(), (std::streamsize)jpeg.size());
+    }
+    std::cout << "Generated " << count << " JPEGs in " << dir.string() << "\n";
+    return 0;
+}
+
+// --- MIXED CORPUS ---
+
+struct CorpusDate {
+    int year, month, day, hour, minute, second;
+};
+
+static CorpusDate RandomDate(std::mt19937& rng, int yearFrom, int yearTo) {
+    CorpusDate d;
+    d.year = yearFrom + (int)(rng() % (unsigned)(yearTo - yearFrom + 1));
+    d.month = 1 + (int)(rng() % 12);
+    d.day = 1 + (int)(rng() % 28);
+    d.hour = (int)(rng() % 24);
+    d.minute = (int)(rng() % 60);
+    d.second = (int)(rng() % 60);
+    return d;
+}
+
+// ISO-BMFF boxes: begin() writes a header whose size end() fills in.
+struct BoxWriter : ByteWriter {
+    std::vector<size_t> open;
+
+    void begin(uint32_t type) { open.push_back(size()); be32(0); be32(type); }
+    void begin(const char* type) { open.push_back(size()); be32(0); bytes(type, 4); }
+    void end() {
+        size_t start = open.back();
+        open.pop_back();
+        uint32_t boxSize = (uint32_t)(size() - start);
+        for (int i = 0; i < 4; ++i) data[start + i] = (uint8_t)(boxSize >> (24 - 8 * i));
+    }
+    void patch32(size_t at, uint32_t v) {
+        for (int i = 0; i < 4; ++i) data[at + i] = (uint8_t)(v >> (24 - 8 * i));
+    }
+};
+
+// Seconds since 1904-01-01, the epoch of QuickTime/MP4 timestamps
+static uint32_t Mp4Time(const CorpusDate& d) {
+    int y = d.year - (d.month <= 2 ? 1 : 0);
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (d.month + (d.month > 2 ? -3 : 9)) + 2) / 5 + d.day - 1;
+    int64_t days = (int64_t)era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+    int64_t unixTime = days * 86400 + d.hour * 3600 + d.minute * 60 + d.second;
+    return (uint32_t)(unixTime + 2082844800LL);
+}
+
+// ftyp, moov with mvhd (creation time) and an mdat of padding, moov first
+// (as after "fast start") or last (as most cameras write it). MP4s carry
+// GPS as udta/(c)xyz like Android phones, MOVs the creation date and
+// location as Apple metadata keys like iPhones.
+std::vector<uint8_t> BuildMp4(bool quickTime, bool moovLast, const CorpusDate& date, bool withGps, double lat, double lon,
+                              size_t padBytes) {
+    BoxWriter w;
+    auto begin = [&](const char* type) { w.begin(type); };
+    auto end = [&]() { w.end(); };
+
+    begin("ftyp");
+    w.bytes(quickTime ? "qt  " : "isom", 4); w.be32(0x200);
+    w.bytes(quickTime ? "qt  " : "isommp42", quickTime ? 4 : 8);
+    end();
+
+    if (moovLast) {
+        begin("mdat");
+        w.fill(0, padBytes);
+        end();
+    }
+
+    begin("moov");
+    begin("mvhd");
+    uint32_t time = Mp4Time(date);
+    w.be32(0); w.be32(time); w.be32(time); w.be32(1000); w.be32(10000);   // 10 s
+    w.be32(0x00010000); w.be16(0x0100); w.fill(0, 10);
+    const uint32_t matrix[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+    for (uint32_t m : matrix) w.be32(m);
+    w.fill(0, 24); w.be32(2);
+    end();
+    char iso[32];
+    snprintf(iso, sizeof(iso), "%+08.4f%+09.4f/", lat, lon);
+    if (withGps && !quickTime) {
+        begin("udta");
+        begin("\xA9xyz");
+        w.be16((uint16_t)strlen(iso)); w.be16(0x15C7);
+        w.bytes(iso, strlen(iso));
+        end();
+        end();
+    }
+    if (quickTime) {
+        char local[32];
+        snprintf(local, sizeof(local), "%04d-%02d-%02dT%02d:%02d:%02d+0100", date.year, date.month, date.day,
+                 date.hour, date.minute, date.second);
+        std::vector<std::pair<const char*, std::string>> items = { { "com.apple.quicktime.creationdate", local } };
+        if (withGps) items.emplace_back("com.apple.quicktime.location.ISO6709", iso);
+        begin("meta");
+        begin("hdlr");
+        w.be32(0); w.be32(0); w.bytes("mdta", 4); w.fill(0, 13);
+        end();
+        begin("keys");
+        w.be32(0); w.be32((uint32_t)items.size());
+        for (const auto& item : items) {
+            w.be32((uint32_t)(8 + strlen(item.first))); w.bytes("mdta", 4); w.bytes(item.first, strlen(item.first));
+        }
+        end();
+        begin("ilst");
+        for (size_t i = 0; i < items.size(); ++i) {
+            w.begin((uint32_t)(i + 1));
+            begin("data");
+            w.be32(1); w.be32(0); w.bytes(items[i].second.data(), items[i].second.size());
+            end();
+            end();
+        }
+        end();
+        end();
+    }
+    end();
+
+    if (!moovLast) {
+        begin("mdat");
+        w.fill(0, padBytes);
+        end();
+    }
+    return w.data;
+}
+
+// HEIC as an iPhone writes it, minus the image: meta with the item list
+// (a coded image and the Exif item) and their locations in mdat, where
+// the Exif item comes after the image data.
+std::vector<uint8_t> BuildHeic(const std::vector<uint8_t>& tiff, size_t imageBytes) {
+    BoxWriter w;
+    w.begin("ftyp");
+    w.bytes("heic", 4); w.be32(0); w.bytes("mif1heic", 8);
+    w.end();
+
+    w.begin("meta");
+    w.be32(0);
+    w.begin("hdlr");
+    w.be32(0); w.be32(0); w.bytes("pict", 4); w.fill(0, 13);
+    w.end();
+    w.begin("pitm");
+    w.be32(0); w.be16(1);
+    w.end();
+    w.begin("iinf");
+    w.be32(0); w.be16(2);
+    w.begin("infe");
+    w.be32(0x02000000); w.be16(1); w.be16(0); w.bytes("hvc1", 4); w.u8(0);
+    w.end();
+    w.begin("infe");
+    w.be32(0x02000000); w.be16(2); w.be16(0); w.bytes("Exif", 4); w.u8(0);
+    w.end();
+    w.end();
+    w.begin("iloc");
+    w.be32(0x01000000); w.u8(0x44); w.u8(0x00); w.be16(2);
+    size_t extentAt[2];
+    for (uint16_t id = 1; id <= 2; ++id) {
+        w.be16(id); w.be16(0); w.be16(0); w.be16(1);
+        extentAt[id - 1] = w.size();
+        w.be32(0); w.be32(0);
+    }
+    w.end();
+    w.end();
+
+    w.begin("mdat");
+    w.patch32(extentAt[0], (uint32_t)w.size());
+    w.patch32(extentAt[0] + 4, (uint32_t)imageBytes);
+    w.fill(0, imageBytes);
+    size_t exifStart = w.size();
+    w.be32(6); w.bytes("Exif\0\0", 6); w.bytes(tiff.data(), tiff.size());
+    w.patch32(extentAt[1], (uint32_t)exifStart);
+    w.patch32(extentAt[1] + 4, (uint32_t)(w.size() - exifStart));
+    w.end();
+    return w.data;
+}
+
+// Canon CR3: moov holds the uuid box with CMT1-CMT4, each a TIFF block.
+// CMT2 and CMT4 are the EXIF and GPS IFDs of tiff (see BuildExifTiff)
+// made the first IFD of their block.
+std::vector<uint8_t> BuildCr3(const std::vector<uint8_t>& tiff, bool withGps, size_t imageBytes) {
+    static const uint8_t canon[16] = {
+        0x85, 0xC0, 0xB6, 0x87, 0x82, 0x0F, 0x11, 0xE0, 0x81, 0x11, 0xF4, 0xCE, 0x46, 0x2B, 0x6A, 0x48
+    };
+    auto le32 = [&](size_t at) {
+        return (uint32_t)tiff[at] | ((uint32_t)tiff[at + 1] << 8) | ((uint32_t)tiff[at + 2] << 16) | ((uint32_t)tiff[at + 3] << 24);
+    };
+    auto rooted = [&](size_t entry) {
+        std::vector<uint8_t> block = tiff;
+        uint32_t ifd = le32(entry + 8);
+        for (int i = 0; i < 4; ++i) block[4 + i] = (uint8_t)(ifd >> (8 * i));
+        return block;
+    };
+    uint32_t ifd0 = le32(4);
+
+    BoxWriter w;
+    w.begin("ftyp");
+    w.bytes("crx ", 4); w.be32(1); w.bytes("crx isom", 8);
+    w.end();
+    w.begin("moov");
+    w.begin("uuid");
+    w.bytes(canon, 16);
+    w.begin("CMT1");
+    w.bytes("II", 2); w.le16(42); w.le32(8); w.le16(0); w.le32(0);
+    w.end();
+    std::vector<uint8_t> exifBlock = rooted(ifd0 + 2);
+    w.begin("CMT2");
+    w.bytes(exifBlock.data(), exifBlock.size());
+    w.end();
+    if (withGps) {
+        std::vector<uint8_t> gpsBlock = rooted(ifd0 + 2 + 12);
+        w.begin("CMT4");
+        w.bytes(gpsBlock.data(), gpsBlock.size());
+        w.end();
+    }
+    w.end();
+    w.end();
+    w.begin("mdat");
+    w.fill(0, imageBytes);
+    w.end();
+    return w.data;
+}
+
+// Stored (uncompressed) ZIP of named files, timestamps in DOS format.
+std::vector<uint8_t> BuildZip(const std::vector<std::pair<std::string, std::vector<uint8_t>>>& members, const CorpusDate& date) {
+    uint16_t dosTime = (uint16_t)((date.hour << 11) | (date.minute << 5) | (date.second / 2));
+    uint16_t dosDate = (uint16_t)(((date.year - 1980) << 9) | (date.month << 5) | date.day);
+    ByteWriter w, central;
+    for (const auto& member : members) {
+        uint32_t crc = Crc32(member.second.data(), member.second.size());
+        uint32_t size = (uint32_t)member.second.size();
+        uint32_t offset = (uint32_t)w.size();
+        w.le32(0x04034b50); w.le16(20); w.le16(0); w.le16(0); w.le16(dosTime); w.le16(dosDate);
+        w.le32(crc); w.le32(size); w.le32(size); w.le16((uint16_t)member.first.size()); w.le16(0);
+        w.bytes(member.first.data(), member.first.size());
+        w.bytes(member.second.data(), member.second.size());
+
+        central.le32(0x02014b50); central.le16(20); central.le16(20); central.le16(0); central.le16(0);
+        central.le16(dosTime); central.le16(dosDate); central.le32(crc); central.le32(size); central.le32(size);
+        central.le16((uint16_t)member.first.size()); central.le16(0); central.le16(0); central.le16(0);
+        central.le16(0); central.le32(0); central.le32(offset);
+        central.bytes(member.first.data(), member.first.size());
+    }
+    uint32_t centralOffset = (uint32_t)w.size();
+    w.bytes(central.data.data(), central.size());
+    w.le32(0x06054b50); w.le16(0); w.le16(0); w.le16((uint16_t)members.size()); w.le16((uint16_t)members.size());
+    w.le32((uint32_t)central.size()); w.le32(centralOffset); w.le16(0);
+    return w.data;
+}
+
+static void WriteFile(const fs::path& file, const std::vector<uint8_t>& data) {
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    out.write((const char*)data.data(), (std::streamsize)data.size());
+    if (!out) throw std::runtime_error("can't write " + file.string());
+}
+
+// A library-like corpus: photos, videos and ZIPs of photos spread over a
+// tree of <fanout>^<depth> leaf folders, plus byte-identical copies of some
+// of them under other names. The same seed gives the same corpus.
+int CmdGenCorpus(int argc, char** argv) {
+    if (argc < 1) {
+        std::cerr << "usage: gen-corpus <dir> [--jpegs N] [--videos N] [--heics N] [--raws N] [--zips N] [--zip-members N]\n"
+                     "                  [--years 2005-2024] [--gps-ratio R] [--gps-clusters N] [--dup-ratio R] [--fanout F]\n"
+                     "                  [--depth D] [--jpeg-kb K] [--video-kb K] [--raw-kb K] [--moov-last-ratio R] [--seed S]\n";
+        return 2;
+    }
+    fs::path root = argv[0];
+    int jpegs = 1000, videos = 50, heics = 0, raws = 0, zips = 10, zipMembers = 20, gpsClusters = 0, fanout = 4, depth = 2;
+    int yearFrom = 2005, yearTo = 2024, jpegKb = 64, videoKb = 1024, rawKb = 1024;
+    double gpsRatio = 0.5, dupRatio = 0.05, moovLastRatio = 0.5;
+    unsigned seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--jpegs") jpegs = std::atoi(argv[i + 1]);
+        else if (opt == "--videos") videos = std::atoi(argv[i + 1]);
+        else if (opt == "--heics") heics = std::atoi(argv[i + 1]);
+        else if (opt == "--raws") raws = std::atoi(argv[i + 1]);
+        else if (opt == "--zips") zips = std::atoi(argv[i + 1]);
+        else if (opt == "--zip-members") zipMembers = std::atoi(argv[i + 1]);
+        else if (opt == "--years") {
+            if (sscanf(argv[i + 1], "%d-%d", &yearFrom, &yearTo) != 2 || yearFrom < 1980 || yearTo < yearFrom) {
+                std::cerr << "--years wants a range like 2005-2024\n";
+                return 2;
+            }
+        }
+        else if (opt == "--gps-ratio") gpsRatio = std::atof(argv[i + 1]);
+        else if (opt == "--gps-clusters") gpsClusters = std::atoi(argv[i + 1]);
+        else if (opt == "--dup-ratio") dupRatio = std::atof(argv[i + 1]);
+        else if (opt == "--fanout") fanout = std::max(1, std::atoi(argv[i + 1]));
+        else if (opt == "--depth") depth = std::max(0, std::atoi(argv[i + 1]));
+        else if (opt == "--jpeg-kb") jpegKb = std::atoi(argv[i + 1]);
+        else if (opt == "--video-kb") videoKb = std::atoi(argv[i + 1]);
+        else if (opt == "--raw-kb") rawKb = std::atoi(argv[i + 1]);
+        else if (opt == "--moov-last-ratio") moovLastRatio = std::atof(argv[i + 1]);
+        else if (opt == "--seed") seed = (unsigned)std::atoi(argv[i + 1]);
+    }
+
+    std::vector<fs::path> leaves = { root };
+    for (int d = 0; d < depth; ++d) {
+        std::vector<fs::path> next;
+        for (const auto& dir : leaves) {
+            for (int i = 0; i < fanout; ++i) next.push_back(dir / ("d" + std::to_string(i)));
+        }
+        leaves.swap(next);
+    }
+    for (const auto& dir : leaves) fs::create_directories(dir);
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<std::pair<double, double>> centers;
+    for (int c = 0; c < gpsClusters; ++c) centers.emplace_back(unit(rng) * 140.0 - 70.0, unit(rng) * 360.0 - 180.0);
+    auto position = [&](double& lat, double& lon) {
+        lat = unit(rng) * 140.0 - 70.0;
+        lon = unit(rng) * 360.0 - 180.0;
+        if (!centers.empty()) {
+            const auto& center = centers[rng() % centers.size()];
+            lat = center.first + (lat / 70.0) * 0.01;
+            lon = center.second + (lon / 180.0) * 0.01;
+        }
+    };
+    // Varying padding keeps sizes apart, so only the real copies share content
+    auto padding = [&](int kb) { return (size_t)kb * 1024 / 2 + rng() % ((size_t)kb * 1024 / 2 + 1); };
+    auto exifTiff = [&](bool& gps, size_t gap) {
+        CorpusDate d = RandomDate(rng, yearFrom, yearTo);
+        char date[20];
+        snprintf(date, sizeof(date), "%04d:%02d:%02d %02d:%02d:%02d", d.year, d.month, d.day, d.hour, d.minute, d.second);
+        gps = unit(rng) < gpsRatio;
+        double lat, lon;
+        position(lat, lon);
+        return BuildExifTiff(date, gps, lat, lon, gap);
+    };
+    auto photo = [&]() {
+        bool gps;
+        std::vector<uint8_t> tiff = exifTiff(gps, 0);
+        return BuildJpeg(tiff, 640, 480, padding(jpegKb));
+    };
+    auto leaf = [&]() { return leaves[rng() % leaves.size()]; };
+
+    std::vector<fs::path> written;
+    uint64_t bytes = 0;
+    char name[48];
+    for (int i = 0; i < jpegs; ++i) {
+        std::vector<uint8_t> jpeg = photo();
+        snprintf(name, sizeof(name), "IMG_%06d.jpg", i);
+        written.push_back(leaf() / name);
+        WriteFile(written.back(), jpeg);
+        bytes += jpeg.size();
+    }
+    for (int i = 0; i < videos; ++i) {
+        CorpusDate d = RandomDate(rng, yearFrom, yearTo);
+        bool gps = unit(rng) < gpsRatio;
+        double lat, lon;
+        position(lat, lon);
+        bool quickTime = i % 2 == 1;
+        size_t pad = padding(videoKb);
+        bool moovLast = unit(rng) < moovLastRatio;
+        std::vector<uint8_t> video = BuildMp4(quickTime, moovLast, d, gps, lat, lon, pad);
+        snprintf(name, sizeof(name), quickTime ? "MOV_%06d.mov" : "VID_%06d.mp4", i);
+        written.push_back(leaf() / name);
+        WriteFile(written.back(), video);
+        bytes += video.size();
+    }
+    for (int i = 0; i < heics; ++i) {
+        bool gps;
+        std::vector<uint8_t> tiff = exifTiff(gps, 0);
+        std::vector<uint8_t> heic = BuildHeic(tiff, padding(jpegKb));
+        snprintf(name, sizeof(name), "IMG_%06d.heic", i);
+        written.push_back(leaf() / name);
+        WriteFile(written.back(), heic);
+        bytes += heic.size();
+    }
+    // TIFF-based RAWs with their IFDs after the sensor data, and CR3s
+    static const char* const rawTypes[] = { "CR2", "NEF", "ARW", "DNG", "CR3" };
+    for (int i = 0; i < raws; ++i) {
+        const char* type = rawTypes[i % 5];
+        bool cr3 = strcmp(type, "CR3") == 0;
+        size_t pad = padding(rawKb);
+        bool gps;
+        std::vector<uint8_t> tiff = exifTiff(gps, cr3 ? 0 : pad);
+        std::vector<uint8_t> raw = cr3 ? BuildCr3(tiff, gps, pad) : tiff;
+        snprintf(name, sizeof(name), "RAW_%06d.%s", i, type);
+        written.push_back(leaf() / name);
+        WriteFile(written.back(), raw);
+        bytes += raw.size();
+    }
+    for (int i = 0; i < zips; ++i) {
+        std::vector<std::pair<std::string, std::vector<uint8_t>>> members;
+        for (int m = 0; m < zipMembers; ++m) {
+            snprintf(name, sizeof(name), "DCIM/IMG_%04d.jpg", m);
+            members.emplace_back(name, photo());
+        }
+        std::vector<uint8_t> zip = BuildZip(members, RandomDate(rng, yearFrom, yearTo));
+        snprintf(name, sizeof(name), "ARCHIVE_%04d.zip", i);
+        WriteFile(leaf() / name, zip);
+        bytes += zip.size();
+    }
+
+    int duplicates = written.empty() ? 0 : (int)(written.size() * dupRatio + 0.5);
+    for (int i = 0; i < duplicates; ++i) {
+        const fs::path& original = written[rng() % written.size()];
+        snprintf(name, sizeof(name), "COPY_%06d", i);
+        fs::path copy = leaf() / (name + original.extension().string());
+        fs::copy_file(original, copy, fs::copy_options::overwrite_existing);
+        bytes += fs::file_size(copy);
+    }
+
+    printf("Generated %d JPEGs, %d videos, %d HEICs, %d RAWs, %d ZIPs (%d files each) and %d duplicates in %zu folders, "
+           "%.1f MB, under %s\n", jpegs, videos, heics, raws, zips, zipMembers, duplicates, leaves.size(),
+           bytes / (1024.0 * 1024.0), root.string().c_str());
+    return 0;
+}
+
+// --- EXIF BENCHMARK ---
+
+struct ExifResult {
+    size_t files = 0;
+    size_t dates = 0;
+    size_t gps = 0;
+    double seconds = 0.0;
+};
+
+ExifResult RunNativeExif(const std::vector<fs::path>& files) {
+    ExifResult r;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& f : files) {
+        ExifInfo info;
+        exif::ReadExif(f, info);
+        r.files++;
+        if (info.hasDate) r.dates++;
+        if (info.hasGps) r.gps++;
+    }
+    r.seconds = SecondsSince(start);
+    return r;
+}
+
+#ifdef _WIN32
+// The property lookups GetFileMetadata used to do through GDI+.
+ExifResult RunGdiplusExif(const std::vector<fs::path>& files) {
+    ExifResult r;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& f : files) {
+        r.files++;
+        Gdiplus::Image image(f.wstring().c_str());
+        if (image.GetLastStatus() != Gdiplus::Ok) continue;
+
+        UINT size = image.GetPropertyItemSize(0x9003);
+        if (size > 0) {
+            std::vector<char> buf(size);
+            Gdiplus::PropertyItem* item = (Gdiplus::PropertyItem*)buf.data();
+            if (image.GetPropertyItem(0x9003, size, item) == Gdiplus::Ok) r.dates++;
+        }
+
+        bool gps = true;
+        for (PROPID id : { 0x0001, 0x0002, 0x0003, 0x0004 }) {
+            UINT s = image.GetPropertyItemSize(id);
+            if (s == 0) { gps = false; break; }
+            std::vector<char> buf(s);
+            if (image.GetPropertyItem(id, s, (Gdiplus::PropertyItem*)buf.data()) != Gdiplus::Ok) { gps = false; break; }
+        }
+        if (gps) r.gps++;
+    }
+    r.seconds = SecondsSince(start);
+    return r;
+}
+#endif
+
+void PrintExifResult(const char* label, const ExifResult& r) {
+    double rate = r.seconds > 0 ? r.files / r.seconds : 0.0;
+    printf("%-8s: %zu files in %.3f s, %.0f files/s (dates %zu, gps %zu)\n", label, r.files, r.seconds, rate, r.dates, r.gps);
+}
+
+int CmdExif(int argc, char** argv) {
+    if (argc < 1) {
+        std::cerr << "usage: exif <dir> [--passes N]\n";
+        return 2;
+    }
+    int passes = 3;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::string(argv[i]) == "--passes") passes = std::atoi(argv[i + 1]);
+    }
+
+    std::vector<fs::path> files = ListFiles(argv[0]);
+    if (files.empty()) {
+        std::cerr << "No files found.\n";
+        return 1;
+    }
+
+    // First pass warms the page cache so both readers see the same conditions.
+    RunNativeExif(files);
+    for (int p = 0; p < passes; ++p) PrintExifResult("native", RunNativeExif(files));
+
+    // As the sorter reads them: format detection, then that format's parser
+    for (int p = 0; p < passes; ++p) {
+        ExifResult r;
+        uint64_t bytesRead = 0;
+        size_t formats[MEDIA_FORMAT_COUNT] = {};
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& file : files) {
+            MediaFormat format;
+            uint64_t read = 0;
+            FileMetadata meta = GetFileMetadata(file, &format, &read);
+            r.files++;
+            if (meta.hasDate) r.dates++;
+            if (meta.hasGps) r.gps++;
+            formats[(int)format]++;
+            bytesRead += read;
+        }
+        r.seconds = SecondsSince(start);
+        PrintExifResult("metadata", r);
+        printf("          %.1f KB read per file;", bytesRead / 1024.0 / files.size());
+        for (int f = 0; f < MEDIA_FORMAT_COUNT; ++f) {
+            if (formats[f]) printf(" %s %zu", MediaFormatName((MediaFormat)f), formats[f]);
+        }
+        printf("\n");
+    }
+
+#ifdef _WIN32
+    Gdiplus::GdiplusStartupInput input;
+    ULONG_PTR token;
+    Gdiplus::GdiplusStartup(&token, &input, NULL);
+    for (int p = 0; p < passes; ++p) PrintExifResult("gdiplus", RunGdiplusExif(files));
+    Gdiplus::GdiplusShutdown(token);
+#else
+    printf("gdiplus : not available on this platform\n");
+#endif
+    return 0;
+}
+
+// --- CONTAINER METADATA ---
+
+// Metadata of every file under <dir> with one of the extensions: once
+// through the container parsers with a small first read (--head-kb), once
+// through GetFileMetadata as the sorter calls it. Reports how much of each
+// file was read, which should not depend on the file size.
+static int BenchContainers(int argc, char** argv, const char* usage, const std::vector<std::string>& extensions) {
+    if (argc < 1) {
+        std::cerr << usage;
+        return 2;
+    }
+    int passes = 3;
+    size_t headSize = 4096;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--passes") passes = std::atoi(argv[i + 1]);
+        else if (opt == "--head-kb") headSize = (size_t)std::max(1, std::atoi(argv[i + 1])) * 1024;
+    }
+
+    std::vector<fs::path> files;
+    for (const auto& file : ListFiles(argv[0])) {
+        std::string ext = file.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+        if (std::find(extensions.begin(), extensions.end(), ext) != extensions.end()) files.push_back(file);
+    }
+    if (files.empty()) {
+        std::cerr << "No matching files found.\n";
+        return 1;
+    }
+
+    uint64_t totalSize = 0;
+    for (const auto& file : files) totalSize += fs::file_size(file);
+    RunNativeExif(files); // Warm the page cache
+
+    std::vector<uint8_t> head(headSize);
+    for (int p = 0; p < passes; ++p) {
+        ExifResult r;
+        uint64_t bytesRead = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& file : files) {
+            std::ifstream in(file, std::ios::binary);
+            in.read((char*)head.data(), (std::streamsize)head.size());
+            size_t got = (size_t)in.gcount();
+            uint64_t extra = 0;
+            bool littleEndian;
+            ExifInfo info;
+            r.files++;
+            bytesRead += got;
+            if (exif::IsTiffHeader(head.data(), got, littleEndian)) {
+                exif::ParseTiffStream(head.data(), got, in, fs::file_size(file), info, &extra);
+            } else if (bmff::LooksLikeBmff(head.data(), got)) {
+                bmff::ParseStream(head.data(), got, in, fs::file_size(file), info, &extra);
+            }
+            bytesRead += extra;
+            if (info.hasDate) r.dates++;
+            if (info.hasGps) r.gps++;
+        }
+        r.seconds = SecondsSince(start);
+        PrintExifResult("headers", r);
+        printf("          %.1f KB read per file of %.1f MB on average\n", bytesRead / 1024.0 / files.size(),
+               totalSize / (1024.0 * 1024.0) / files.size());
+
+        ExifResult m;
+        start = std::chrono::steady_clock::now();
+        for (const auto& file : files) {
+            FileMetadata meta = GetFileMetadata(file);
+            m.files++;
+            if (meta.hasDate) m.dates++;
+            if (meta.hasGps) m.gps++;
+        }
+        m.seconds = SecondsSince(start);
+        PrintExifResult("metadata", m);
+    }
+    return 0;
+}
+
+int CmdVideo(int argc, char** argv) {
+    return BenchContainers(argc, argv, "usage: video <dir> [--passes N] [--head-kb K]\n",
+                           { ".mp4", ".mov", ".3gp", ".m4v" });
+}
+
+// HEIC/HEIF and camera RAW files; the generated TIFF RAWs (gen-corpus
+// --raws) keep their IFDs after the sensor data, beyond the header window.
+int CmdRaw(int argc, char** argv) {
+    return BenchContainers(argc, argv, "usage: raw <dir> [--passes N] [--head-kb K]\n",
+                           { ".heic", ".heif", ".cr2", ".cr3", ".nef", ".arw", ".dng", ".orf", ".rw2" });
+}
+
+// --- OFFLINE GEOCODING ---
+
+struct FixturePlace {
+    std::string name;
+    double lat, lon;
+};
+
+// The populated places of a GeoNames-style file, read the way OfflineGeocoder
+// reads them
+static std::vector<FixturePlace> ReadPlaces(const fs::path& file) {
+    std::vector<FixturePlace> places;
+    std::ifstream in(file, std::ios::binary);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        std::vector<std::string> cols;
+        std::stringstream row(line);
+        std::string col;
+        while (cols.size() < 7 && std::getline(row, col, '\t')) cols.push_back(col);
+        if (cols.size() < 6 || cols[1].empty()) continue;
+        if (cols.size() >= 7 && !cols[6].empty() && cols[6] != "P") continue;
+        places.push_back({ cols[1], std::atof(cols[4].c_str()), std::atof(cols[5].c_str()) });
+    }
+    return places;
+}
+
+static double GreatCircleKm(double lat1, double lon1, double lat2, double lon2) {
+    const double rad = 3.14159265358979323846 / 180.0;
+    double dLat = (lat2 - lat1) * rad, dLon = (lon2 - lon1) * rad;
+    double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
+               std::cos(lat1 * rad) * std::cos(lat2 * rad) * std::sin(dLon / 2) * std::sin(dLon / 2);
+    return 2.0 * 6371.0 * std::asin(std::min(1.0, std::sqrt(a)));
+}
+
+// Nearest place by brute force, "" beyond maxKm; distance is to the nearest
+// place of that name (names repeat: Springfield, Portland)
+static std::string BruteForceNearest(const std::vector<FixturePlace>& places, double lat, double lon, double maxKm,
+                                     double& distance) {
+    const FixturePlace* best = nullptr;
+    distance = 1e9;
+    for (const auto& place : places) {
+        double d = GreatCircleKm(lat, lon, place.lat, place.lon);
+        if (d < distance) {
+            distance = d;
+            best = &place;
+        }
+    }
+    return best && distance <= maxKm ? best->name : std::string();
+}
+
+static double DistanceToName(const std::vector<FixturePlace>& places, const std::string& name, double lat, double lon) {
+    double distance = 1e9;
+    for (const auto& place : places) {
+        if (place.name == name) distance = std::min(distance, GreatCircleKm(lat, lon, place.lat, place.lon));
+    }
+    return distance;
+}
+
+// Builds the k-d index from a places file (fixtures/places.txt, or a full
+// cities1000.txt) and checks every answer against a brute-force great-circle
+// search: at each place, near places (within the 30 km range and just past
+// it, across the antimeridian) and anywhere on the globe. --extra adds random
+// synthetic places, for the latency of a full-size index.
+int CmdGeocode(int argc, char** argv) {
+    if (argc < 1) {
+        std::cerr << "usage: geocode <places.txt> [--queries N] [--extra N] [--seed N]\n";
+        return 2;
+    }
+    int queries = 20000, extra = 0;
+    unsigned seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--queries") queries = std::max(1, std::atoi(argv[i + 1]));
+        else if (opt == "--extra") extra = std::max(0, std::atoi(argv[i + 1]));
+        else if (opt == "--seed") seed = (unsigned)std::atoi(argv[i + 1]);
+    }
+    const double MAX_KM = 30.0;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    auto randomPoint = [&](double& lat, double& lon) {
+        lat = std::asin(2.0 * unit(rng) - 1.0) * 180.0 / 3.14159265358979323846;
+        lon = unit(rng) * 360.0 - 180.0;
+    };
+
+    // A scratch copy: the index is written next to the places file
+    fs::path scratch = fs::temp_directory_path() / ("media_sorter_geocode_" + std::to_string(seed));
+    fs::remove_all(scratch);
+    fs::create_directories(scratch);
+    fs::path placesFile = scratch / "places.txt";
+    fs::copy_file(argv[0], placesFile);
+    size_t listed = ReadPlaces(placesFile).size();
+    if (extra > 0) {
+        std::ofstream out(placesFile, std::ios::app | std::ios::binary);
+        for (int i = 0; i < extra; ++i) {
+            double lat, lon;
+            randomPoint(lat, lon);
+            out << (100000000 + i) << "\tSynthetic " << i << "\t\t\t" << lat << "\t" << lon << "\tP\n";
+        }
+    }
+    std::vector<FixturePlace> places = ReadPlaces(placesFile);
+    if (places.empty()) {
+        std::cerr << "No places found.\n";
+        return 1;
+    }
+
+    std::string error;
+    OfflineGeocoder built(MAX_KM);
+    auto start = std::chrono::steady_clock::now();
+    if (!built.Load(placesFile, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    double buildSeconds = SecondsSince(start);
+    OfflineGeocoder geocoder(MAX_KM);
+    start = std::chrono::steady_clock::now();
+    geocoder.Load(placesFile, error);
+    double mapSeconds = SecondsSince(start);
+    printf("%zu places (index has %zu): built in %.3f s, mapped in %.3f ms\n", places.size(), geocoder.PlaceCount(),
+           buildSeconds, mapSeconds * 1000.0);
+
+    struct Query {
+        double lat, lon;
+    };
+    std::vector<Query> points;
+    for (size_t i = 0; i < listed; ++i) points.push_back({ places[i].lat, places[i].lon });
+    for (int i = 0; i < queries; ++i) {
+        double lat, lon;
+        if (i % 2 == 0) {
+            // Within about 45 km of a place, so inside and just outside the range
+            const FixturePlace& near = places[rng() % places.size()];
+            lat = std::max(-90.0, std::min(90.0, near.lat + (unit(rng) - 0.5) * 0.8));
+            lon = near.lon + (unit(rng) - 0.5) * 0.8 / std::max(0.05, std::cos(near.lat * 3.14159265358979323846 / 180.0));
+            if (lon > 180.0) lon -= 360.0;
+            if (lon < -180.0) lon += 360.0;
+        } else {
+            randomPoint(lat, lon);
+        }
+        points.push_back({ lat, lon });
+    }
+
+    std::vector<std::string> answers(points.size());
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < points.size(); ++i) answers[i] = geocoder.Nearest(points[i].lat, points[i].lon);
+    double indexSeconds = SecondsSince(start);
+
+    // Equal distances (within float precision of the index) may name either place
+    const double TIE_KM = 0.01;
+    size_t named = 0, mismatches = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < points.size(); ++i) {
+        double distance;
+        std::string expected = BruteForceNearest(places, points[i].lat, points[i].lon, MAX_KM, distance);
+        if (!answers[i].empty()) named++;
+        if (answers[i] == expected) continue;
+        double answered = answers[i].empty() ? MAX_KM : DistanceToName(places, answers[i], points[i].lat, points[i].lon);
+        if (std::fabs(answered - std::min(distance, MAX_KM)) <= TIE_KM && answered <= MAX_KM + TIE_KM) continue;
+        if (++mismatches <= 10) {
+            printf("  mismatch at %.5f,%.5f: index \"%s\", brute force \"%s\" (%.3f km)\n", points[i].lat, points[i].lon,
+                   answers[i].c_str(), expected.c_str(), distance);
+        }
+    }
+    double bruteSeconds = SecondsSince(start);
+
+    printf("%zu queries, %zu named: %zu mismatches\n", points.size(), named, mismatches);
+    printf("k-d index  : %.3f us per lookup\n", indexSeconds * 1e6 / points.size());
+    printf("brute force: %.3f us per lookup\n", bruteSeconds * 1e6 / points.size());
+    fs::remove_all(scratch);
+    return mismatches == 0 ? 0 : 1;
+}
+
+// --- ONLINE GEOCODING ---
+
+#ifdef _WIN32
+typedef SOCKET SocketHandle;
+static const SocketHandle NO_SOCKET = INVALID_SOCKET;
+static void CloseSocket(SocketHandle s) { closesocket(s); }
+#else
+typedef int SocketHandle;
+static const SocketHandle NO_SOCKET = -1;
+static void CloseSocket(SocketHandle s) { close(s); }
+#endif
+
+// Stands in for Nominatim on a loopback port: answers /reverse with a made-up
+// city per request and records the coordinates asked for. beforeFirstAnswer
+// runs before the first response goes out (to hold it back).
+class NominatimStub {
+public:
+    std::function<void()> beforeFirstAnswer;
+
+    ~NominatimStub() { Stop(); }
+
+    bool Start() {
+#ifdef _WIN32
+        WSADATA wsa;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return false;
+#endif
+        m_listen = socket(AF_INET, SOCK_STREAM, 0);
+        if (m_listen == NO_SOCKET) return false;
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        if (bind(m_listen, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(m_listen, 16) != 0 ||
+            getsockname(m_listen, (sockaddr*)&addr, &len) != 0) {
+            CloseSocket(m_listen);
+            m_listen = NO_SOCKET;
+            return false;
+        }
+        m_port = ntohs(addr.sin_port);
+        m_thread = std::thread(&NominatimStub::Serve, this);
+        return true;
+    }
+
+    void Stop() {
+        if (!m_thread.joinable()) return;
+        m_stop = true;
+        m_thread.join();
+        CloseSocket(m_listen);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    int port() const { return m_port; }
+
+    std::vector<std::pair<double, double>> Requests() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_requests;
+    }
+
+private:
+    void Serve() {
+        while (!m_stop) {
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(m_listen, &readable);
+            timeval timeout = { 0, 100 * 1000 };
+            if (select((int)m_listen + 1, &readable, nullptr, nullptr, &timeout) <= 0) continue;
+            SocketHandle client = accept(m_listen, nullptr, nullptr);
+            if (client == NO_SOCKET) continue;
+            Answer(client);
+            CloseSocket(client);
+        }
+    }
+
+    static double QueryValue(const std::string& request, const char* key) {
+        size_t pos = request.find(key);
+        return pos == std::string::npos ? 0.0 : std::atof(request.c_str() + pos + strlen(key));
+    }
+
+    void Answer(SocketHandle client) {
+        std::string request;
+        char buffer[4096];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 64 * 1024) {
+            int n = (int)recv(client, buffer, sizeof(buffer), 0);
+            if (n <= 0) return;
+            request.append(buffer, (size_t)n);
+        }
+        std::string line = request.substr(0, request.find("\r\n"));
+        std::string body = "{}";
+        size_t index;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            index = m_requests.size();
+            if (line.find("/reverse?") != std::string::npos) {
+                m_requests.emplace_back(QueryValue(line, "lat="), QueryValue(line, "lon="));
+                body = "{\"address\":{\"city\":\"Stubville " + std::to_string(index + 1) + "\"}}";
+            }
+        }
+        if (index == 0 && beforeFirstAnswer) beforeFirstAnswer();
+
+        std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                               std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        for (size_t sent = 0; sent < response.size();) {
+            int n = (int)send(client, response.data() + sent, (int)(response.size() - sent), 0);
+            if (n <= 0) break;
+            sent += (size_t)n;
+        }
+    }
+
+    SocketHandle m_listen = NO_SOCKET;
+    int m_port = 0;
+    std::thread m_thread;
+    std::atomic<bool> m_stop{false};
+    std::mutex m_mutex;
+    std::vector<std::pair<double, double>> m_requests;
+};
+
+// Sorts a corpus twice against NominatimStub, sharing one geocode cache:
+// photos in a few tight clusters of GPS locations, plus photos without GPS.
+// Checks that the first run sends one request per ~5 km cell, that the
+// photos without GPS are copied while the first answer is still held back,
+// and that the second run is answered from the cache alone.
+int CmdGeocodeOnline(int argc, char** argv) {
+    if (argc < 1) {
+        std::cerr << "usage: geocode-online <scratch> [--cells N] [--per-cell N] [--plain N]\n";
+        return 2;
+    }
+    fs::path scratch = argv[0];
+    int cells = 3, perCell = 20, plain = 200;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--cells") cells = std::max(1, std::atoi(argv[i + 1]));
+        else if (opt == "--per-cell") perCell = std::max(1, std::atoi(argv[i + 1]));
+        else if (opt == "--plain") plain = std::max(1, std::atoi(argv[i + 1]));
+    }
+    if (!HttpAvailable()) {
+        std::cerr << "This build has no HTTP client (libcurl), online geocoding is off.\n";
+        return 2;
+    }
+
+    fs::path source = scratch / "geocode-online-src";
+    fs::path cache = scratch / "geocode-online.cache";
+    fs::remove_all(source);
+    fs::remove(cache);
+    fs::create_directories(source);
+
+    // Distinct dates keep every photo distinct in content
+    std::set<uint64_t> expectedCells;
+    int photo = 0;
+    auto writePhoto = [&](bool gps, double lat, double lon) {
+        char date[32], name[32];
+        snprintf(date, sizeof(date), "2021:%02d:%02d %02d:%02d:%02d", 1 + photo / 40320 % 12, 1 + photo / 1440 % 28,
+                 photo / 60 % 24, photo % 60, photo * 7 % 60);
+        snprintf(name, sizeof(name), "IMG_%05d.jpg", photo++);
+        WriteFile(source / name, BuildJpeg(BuildExifTiff(date, gps, lat, lon), 64, 48, 0));
+        if (gps) expectedCells.insert(Geocoder::CellFor(lat, lon));
+    };
+    for (int c = 0; c < cells; ++c) {
+        double lat = 12.3 + c * 7.1, lon = 21.7 + c * 13.3;
+        // Every fourth photo from the same spot, the rest within ~400 m (distinct cache keys)
+        for (int i = 0; i < perCell; ++i) {
+            double offset = i % 4 == 0 ? 0.0 : (i % 9 - 4) * 0.001;
+            writePhoto(true, lat + offset, lon - offset);
+        }
+    }
+    for (int i = 0; i < plain; ++i) writePhoto(false, 0.0, 0.0);
+
+    // Holds the first answer until the photos without GPS are all copied
+    // (or 15 s have passed): none of the others can be placed before it
+    NominatimStub stub;
+    std::atomic<SorterEngine*> running(nullptr);
+    std::atomic<int> copiedBeforeAnswer(-1);
+    stub.beforeFirstAnswer = [&]() {
+        auto start = std::chrono::steady_clock::now();
+        int copied = 0;
+        while (SecondsSince(start) < 15.0) {
+            SorterEngine* engine = running;
+            if (engine && (copied = engine->Stats().copied) >= plain) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        copiedBeforeAnswer = copied;
+    };
+    if (!stub.Start()) {
+        std::cerr << "Cannot listen on a loopback port.\n";
+        return 1;
+    }
+    printf("%d photos in %zu cell(s), %d without GPS; stub at 127.0.0.1:%d\n", photo, expectedCells.size(), plain,
+           stub.port());
+
+    auto sort = [&](const char* target) {
+        SortOptions options;
+        options.sourcePath = source;
+        options.targetPath = scratch / target;
+        options.geocodeUrl = "http://127.0.0.1:" + std::to_string(stub.port());
+        options.geocodeCacheFile = cache;
+        options.useManifest = false;
+        fs::remove_all(options.targetPath);
+        fs::create_directories(options.targetPath);
+        SorterEngine engine(options);
+        running = &engine;
+        auto start = std::chrono::steady_clock::now();
+        SortStats stats = engine.Run();
+        running = nullptr;
+        size_t named = 0;
+        for (const auto& entry : fs::recursive_directory_iterator(options.targetPath)) {
+            if (entry.path().filename().u8string().find("Stubville") != std::string::npos) named++;
+        }
+        printf("%s: %d copied, %zu named after the stub, %llu request(s), %d parked, %.2f s\n", target, stats.copied,
+               named, (unsigned long long)stats.geocodeRequests, stats.geocodeDeferred, SecondsSince(start));
+        return named;
+    };
+
+    int failures = 0;
+    auto check = [&](bool ok, const std::string& what) {
+        printf("  %s: %s\n", ok ? "ok  " : "FAIL", what.c_str());
+        if (!ok) failures++;
+    };
+
+    size_t firstNamed = sort("geocode-online-run1");
+    std::vector<std::pair<double, double>> requests = stub.Requests();
+    std::set<uint64_t> requestedCells;
+    for (const auto& request : requests) requestedCells.insert(Geocoder::CellFor(request.first, request.second));
+    check(requests.size() == expectedCells.size() && requestedCells.size() == requests.size(),
+          std::to_string(requests.size()) + " request(s) for " + std::to_string(expectedCells.size()) + " cell(s)");
+    check(copiedBeforeAnswer == plain, std::to_string(copiedBeforeAnswer.load()) + " of " + std::to_string(plain) +
+          " photos without GPS copied before the first answer");
+    check(firstNamed == (size_t)(cells * perCell), std::to_string(firstNamed) + " of " +
+          std::to_string(cells * perCell) + " GPS photos named");
+
+    size_t secondNamed = sort("geocode-online-run2");
+    size_t repeated = stub.Requests().size() - requests.size();
+    check(repeated == 0, std::to_string(repeated) + " request(s) on the second run, same cache");
+    check(secondNamed == firstNamed, std::to_string(secondNamed) + " GPS photos named from the cache");
+
+    stub.Stop();
+    fs::remove_all(source);
+    fs::remove_all(scratch / "geocode-online-run1");
+    fs::remove_all(scratch / "geocode-online-run2");
+    fs::remove(cache);
+    return failures == 0 ? 0 : 1;
+}
+
+// --- DIRECTORY WALK ---
+
+// Balanced tree: <fanout> subdirectories per level down to <depth>, files spread
+// evenly over the leaves. Files are empty; only the directory structure matters.
+int CmdGenTree(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: gen-tree <dir> <files> [--fanout F] [--depth D]\n";
+        return 2;
+    }
+    fs::path root = argv[0];
+    long files = std::atol(argv[1]);
+    int fanout = 10, depth = 3;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--fanout") fanout = std::atoi(argv[i + 1]);
+        else if (opt == "--depth") depth = std::atoi(argv[i + 1]);
+    }
+
+    std::vector<fs::path> leaves = { root };
+    for (int d = 0; d < depth; ++d) {
+        std::vector<fs::path> next;
+        for (const auto& dir : leaves) {
+            for (int i = 0; i < fanout; ++i) next.push_back(dir / ("d" + std::to_string(i)));
+        }
+        leaves.swap(next);
+    }
+    for (const auto& dir : leaves) fs::create_directories(dir);
+
+    for (long i = 0; i < files; ++i) {
+        std::ofstream(leaves[i % leaves.size()] / ("f" + std::to_string(i) + ".jpg"));
+    }
+    std::cout << "Generated " << files << " files in " << leaves.size() << " leaf directories under " << root.string() << "\n";
+    return 0;
+}
+
+int CmdWalk(int argc, char** argv) {
+    if (argc < 1) {
+        std::cerr << "usage: walk <dir> [--threads N] [--passes N]\n";
+        return 2;
+    }
+    fs::path root = argv[0];
+    int threads = 4, passes = 3;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--threads") threads = std::atoi(argv[i + 1]);
+        else if (opt == "--passes") passes = std::atoi(argv[i + 1]);
+    }
+
+    for (int p = 0; p < passes; ++p) {
+        auto start = std::chrono::steady_clock::now();
+        size_t count = 0;
+        for (const auto& entry : fs::recursive_directory_iterator(root)) {
+            if (entry.is_regular_file()) count++;
+        }
+        double t = SecondsSince(start);
+        printf("iterator       : %zu files in %.3f s, %.0f files/s\n", count, t, count / t);
+
+        DirWalker walker(threads);
+        std::atomic<size_t> walked(0);
+        start = std::chrono::steady_clock::now();
+        walker.Walk({ root }, [&](fs::path&&, uint64_t) { walked++; });
+        t = SecondsSince(start);
+        DirWalker::Stats stats = walker.GetStats();
+        printf("walker (%2d thr): %zu files in %.3f s, %.0f files/s (%llu dirs, %llu stat calls)\n",
+               threads, walked.load(), t, walked / t,
+               (unsigned long long)stats.directories, (unsigned long long)stats.statCalls);
+    }
+    return 0;
+}
+
+// --- FILE COPY ---
+
+// Copies <files> random files of <size-mb> from <source> to <target> with each
+// copy method in turn. Put source and target on the filesystems to compare
+// (tmpfs, a loop-mounted btrfs/XFS image, ...); --sync includes writeback.
+int CmdCopy(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: copy <source-dir> <target-dir> [--files N] [--size-mb M] [--passes N] [--sync]\n";
+        return 2;
+    }
+    fs::path source = fs::path(argv[0]) / "copy-bench-src";
+    fs::path target = argv[1];
+    int files = 64, sizeMb = 16, passes = 2;
+    bool sync = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--sync") sync = true;
+        else if (i + 1 >= argc) break;
+        else if (opt == "--files") files = std::atoi(argv[++i]);
+        else if (opt == "--size-mb") sizeMb = std::atoi(argv[++i]);
+        else if (opt == "--passes") passes = std::atoi(argv[++i]);
+    }
+
+    // Incompressible content, generated once and reused by later runs
+    fs::create_directories(source);
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> block(1 << 17);
+    std::vector<fs::path> inputs;
+    for (int f = 0; f < files; ++f) {
+        fs::path file = source / ("f" + std::to_string(f) + ".bin");
+        inputs.push_back(file);
+        std::error_code ec;
+        if (fs::file_size(file, ec) == (uintmax_t)sizeMb << 20) continue;
+        std::ofstream out(file, std::ios::binary | std::ios::trunc);
+        for (int mb = 0; mb < sizeMb; ++mb) {
+            for (auto& v : block) v = rng();
+            out.write((const char*)block.data(), 1 << 20);
+        }
+    }
+    double totalMb = (double)files * sizeMb;
+
+    struct Candidate { const char* label; CopyMethod method; bool std; };
+    const Candidate candidates[] = {
+        { "auto", CopyMethod::Auto, false },
+        { "reflink", CopyMethod::Reflink, false },
+        { "copy_file_range", CopyMethod::CopyFileRange, false },
+        { "sendfile", CopyMethod::Sendfile, false },
+        { "io_uring", CopyMethod::IoUring, false },
+        { "buffered", CopyMethod::Buffered, false },
+        { "std::filesystem", CopyMethod::Auto, true },
+    };
+
+    for (int p = 0; p < passes; ++p) {
+        for (const Candidate& c : candidates) {
+            fs::path dir = target / (std::string("copy-bench-") + c.label);
+            fs::remove_all(dir);
+            fs::create_directories(dir);
+            FileCopier copier(c.method);
+
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& in : inputs) {
+                std::error_code ec;
+                fs::path out = dir / in.filename();
+                bool ok = c.std ? fs::copy_file(in, out, ec) : copier.Copy(in, out, ec);
+                if (!ok) throw fs::filesystem_error("copy", in, out, ec);
+            }
+#ifndef _WIN32
+            if (sync) ::sync();
+#endif
+            double t = SecondsSince(start);
+
+            // Which method actually did the work (forced ones can fall back)
+            std::string used = c.std ? "" : " ->";
+            FileCopier::Stats stats = copier.GetStats();
+            for (int m = 0; !c.std && m < COPY_METHOD_COUNT; ++m) {
+                if (stats.files[m]) used += std::string(" ") + CopyMethodName((CopyMethod)m) + " " + std::to_string(stats.files[m]);
+            }
+            printf("%-16s: %.0f MB in %.3f s, %.0f MB/s%s\n", c.label, totalMb, t, totalMb / t, used.c_str());
+            fs::remove_all(dir);
+        }
+    }
+    return 0;
+}
+
+// --- SINGLE OPEN ---
+
+// Read syscalls and bytes read by this process so far (Linux /proc/self/io)
+static bool ReadIoCounters(uint64_t& syscalls, uint64_t& bytes) {
+    std::ifstream in("/proc/self/io");
+    std::string key;
+    uint64_t value;
+    bool haveCalls = false, haveBytes = false;
+    while (in >> key >> value) {
+        if (key == "syscr:") { syscalls = value; haveCalls = true; }
+        else if (key == "rchar:") { bytes = value; haveBytes = true; }
+    }
+    return haveCalls && haveBytes;
+}
+
+// What the sorter does with every file under <dir> on its way into
+// <scratch>: stat, metadata, partial hash (dedup and manifest) and copy.
+// Once by path, where each step opens the file again, and once through a
+// SourceFile opened after the stat and handed from step to step.
+int CmdOpen(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: open <dir> <scratch-dir> [--passes N]\n";
+        return 2;
+    }
+    int passes = 3;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (std::string(argv[i]) == "--passes") passes = std::atoi(argv[i + 1]);
+    }
+    std::vector<fs::path> files = ListFiles(argv[0]);
+    if (files.empty()) {
+        std::cerr << "No files found.\n";
+        return 1;
+    }
+    fs::path scratch = fs::path(argv[1]) / "open-bench";
+    RunNativeExif(files); // Warm the page cache
+
+    for (int p = 0; p < passes; ++p) {
+        for (int single = 0; single < 2; ++single) {
+            fs::remove_all(scratch);
+            fs::create_directories(scratch);
+            FileCopier copier;
+            uint64_t callsBefore = 0, bytesBefore = 0, callsAfter = 0, bytesAfter = 0, hashed = 0;
+            bool haveCounters = ReadIoCounters(callsBefore, bytesBefore);
+            size_t dated = 0, n = 0;
+
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& file : files) {
+                fs::path out = scratch / (std::to_string(n++) + file.extension().string());
+                std::error_code ec;
+                uint64_t hash = 0;
+                FileMetadata meta;
+                if (single) {
+                    SourceFile source;
+                    if (!source.Stat(file) || !source.Open()) continue;
+                    meta = GetFileMetadata(source);
+                    HashFilePartial(source, source.size(), hash, hashed);
+                    copier.Copy(source, out, ec);
+                    source.DropCache();
+                } else {
+                    uint64_t size;
+                    int64_t modifiedTime;
+                    if (!GetFileIdentity(file, size, modifiedTime)) continue;
+                    meta = GetFileMetadata(file);
+                    HashFilePartial(file, size, hash, hashed);
+                    copier.Copy(file, out, ec);
+                }
+                if (ec) throw fs::filesystem_error("copy", file, out, ec);
+                if (meta.hasDate) dated++;
+            }
+            double t = SecondsSince(start);
+            haveCounters = haveCounters && ReadIoCounters(callsAfter, bytesAfter);
+
+            printf("%-8s: %zu files in %.3f s, %.0f files/s (dates %zu)", single ? "single" : "by path", files.size(), t,
+                   files.size() / t, dated);
+            if (haveCounters) {
+                printf(", %.2f read calls and %.1f KB read per file", (double)(callsAfter - callsBefore) / files.size(),
+                       (bytesAfter - bytesBefore) / 1024.0 / files.size());
+            }
+            printf("\n");
+        }
+    }
+    fs::remove_all(scratch);
+    return 0;
+}
+
+// --- QUEUE DEPTH ---
+
+// Drops the files from the page cache so every run reads from the device.
+static void EvictFiles(const std::vector<fs::path>& files) {
+#ifdef __linux__
+    for (const auto& file : files) {
+        int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#else
+    (void)files;
+#endif
+}
+
+// Reads the metadata header window of every file, split over <threads>
+// threads. depth 0 reads blocking, one file at a time per thread; otherwise
+// each thread keeps up to depth reads in flight through its own ring.
+static double RunHeadReads(const std::vector<fs::path>& files, int threads, unsigned depth, uint64_t& bytes) {
+    std::atomic<uint64_t> total(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            IoRing ring;
+            if (depth > 0 && !ring.Init(depth)) return;
+            size_t batch = depth > 0 ? depth : 1;
+            std::vector<HeadRead> reads;
+            for (size_t i = (size_t)t; i < files.size();) {
+                reads.clear();
+                for (; i < files.size() && reads.size() < batch; i += (size_t)threads) {
+                    HeadRead read;
+                    read.path = files[i];
+                    std::error_code ec;
+                    uintmax_t size = fs::file_size(files[i], ec);
+                    read.size = ec ? 0 : (size_t)std::min<uintmax_t>(size, exif::HEADER_WINDOW);
+                    reads.push_back(std::move(read));
+                }
+                ReadHeads(depth > 0 ? &ring : nullptr, reads);
+                for (const auto& read : reads) total += read.data.size();
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    bytes = total;
+    return SecondsSince(start);
+}
+
+int CmdIoQueue(int argc, char** argv) {
+    if (argc < 1) {
+        std::cerr << "usage: ioq <dir> [--depths 1,4,16,64,256] [--threads N] [--passes N] [--warm]\n";
+        return 2;
+    }
+    std::vector<unsigned> depths = { 1, 4, 16, 64, 256 };
+    int threads = 1, passes = 2;
+    bool cold = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--warm") cold = false;
+        else if (i + 1 >= argc) break;
+        else if (opt == "--threads") threads = std::max(1, std::atoi(argv[++i]));
+        else if (opt == "--passes") passes = std::atoi(argv[++i]);
+        else if (opt == "--depths") {
+            depths.clear();
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                if (std::atoi(item.c_str()) > 0) depths.push_back((unsigned)std::atoi(item.c_str()));
+            }
+        }
+    }
+
+    std::vector<fs::path> files = ListFiles(argv[0]);
+    if (files.empty()) {
+        std::cerr << "No files found.\n";
+        return 1;
+    }
+    if (!IoRing::Available()) printf("io_uring not available, only the blocking reads run\n");
+
+    auto report = [&](const std::string& label, unsigned depth) {
+        if (cold) EvictFiles(files);
+        uint64_t bytes = 0;
+        double t = RunHeadReads(files, threads, depth, bytes);
+        printf("%-16s: %zu files in %.3f s, %.0f files/s, %.1f MB/s\n", label.c_str(), files.size(), t,
+               files.size() / t, bytes / (1024.0 * 1024.0) / t);
+    };
+    printf("%zu files, %d thread(s), %s cache\n", files.size(), threads, cold ? "cold" : "warm");
+    if (!cold) {
+        uint64_t bytes = 0;
+        RunHeadReads(files, threads, 0, bytes);
+    }
+    for (int p = 0; p < passes; ++p) {
+        report("blocking", 0);
+        if (!IoRing::Available()) continue;
+        for (unsigned depth : depths) report("io_uring qd " + std::to_string(depth), depth);
+    }
+    return 0;
+}
+
+// --- DISK ORDER ---
+
+// Reads every file whole, 1 MB at a time, split over <threads> threads that
+// take the files in list order.
+static double RunWholeReads(const std::vector<fs::path>& files, int threads, uint64_t& bytes) {
+    std::atomic<size_t> next(0);
+    std::atomic<uint64_t> total(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            std::vector<char> buffer(1024 * 1024);
+            for (size_t i = next++; i < files.size(); i = next++) {
+                SourceFile file;
+                if (!file.Stat(files[i]) || !file.Open()) continue;
+                file.AdviseSequential();
+                for (uint64_t offset = 0; offset < file.size();) {
+                    size_t n = file.ReadAt(offset, buffer.data(), buffer.size());
+                    if (n == 0) break;
+                    offset += n;
+                    total += n;
+                }
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    bytes = total;
+    return SecondsSince(start);
+}
+
+// The files as one walker thread finds them, then as the scheduler hands
+// them on by inode and by extent, read cold each time.
+int CmdDiskOrder(int argc, char** argv) {
+    if (argc < 1) {
+        std::cerr << "usage: disk-order <dir> [--threads N] [--batch N] [--passes N]\n";
+        return 2;
+    }
+    int threads = 1, passes = 2;
+    size_t batch = 1024;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--threads") threads = std::max(1, std::atoi(argv[i + 1]));
+        else if (opt == "--batch") batch = (size_t)std::max(1, std::atoi(argv[i + 1]));
+        else if (opt == "--passes") passes = std::atoi(argv[i + 1]);
+    }
+
+    std::vector<fs::path> walked;
+    std::vector<uint64_t> inodes;
+    DirWalker walker(1);
+    walker.Walk({ fs::path(argv[0]) }, [&](fs::path&& file, uint64_t inode) {
+        walked.push_back(std::move(file));
+        inodes.push_back(inode);
+    });
+    if (walked.empty()) {
+        std::cerr << "No files found.\n";
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, std::vector<fs::path>>> orders;
+    orders.emplace_back("directory", walked);
+    for (DiskOrder order : { DiskOrder::Inode, DiskOrder::Extent }) {
+        std::vector<fs::path> sorted;
+        auto start = std::chrono::steady_clock::now();
+        DiskOrderBatcher batcher(order, batch, [&](fs::path&& file) { sorted.push_back(std::move(file)); });
+        for (size_t i = 0; i < walked.size(); ++i) batcher.Add(fs::path(walked[i]), inodes[i]);
+        batcher.Flush();
+        printf("%-10s: sorted in %.3f s, %llu by extent, %llu by inode\n", DiskOrderName(order), SecondsSince(start),
+               (unsigned long long)batcher.ExtentKeys(), (unsigned long long)batcher.InodeKeys());
+        orders.emplace_back(DiskOrderName(order), std::move(sorted));
+    }
+
+    printf("%zu files, %d thread(s), batches of %zu, cold cache\n", walked.size(), threads, batch);
+    for (int p = 0; p < passes; ++p) {
+        for (const auto& order : orders) {
+            EvictFiles(order.second);
+            uint64_t bytes = 0;
+            double t = RunWholeReads(order.second, threads, bytes);
+            printf("%-10s: %.1f MB in %.3f s, %.1f MB/s, %.0f files/s\n", order.first.c_str(), bytes / (1024.0 * 1024.0), t,
+                   bytes / (1024.0 * 1024.0) / t, order.second.size() / t);
+        }
+    }
+    return 0;
+}
+
+// --- WORK QUEUE ---
+
+static void PushAll(SafeQueue<uint64_t>& queue, std::vector<uint64_t>& items) {
+    for (uint64_t v : items) queue.push(v);
+    items.clear();
+}
+
+static void PushAll(WorkQueue<uint64_t>& queue, std::vector<uint64_t>& items) {
+    if (items.size() == 1) queue.push(items[0]);
+    else queue.push_batch(items);
+    items.clear();
+}
+
+// Moves <items> integers from <threads> producers to as many consumers and
+// checks that every one arrived exactly once (by sum). batch > 1 pushes and
+// pops that many at a time.
+template<typename Queue>
+static double RunQueue(Queue& queue, int threads, size_t items, size_t batch) {
+    std::atomic<uint64_t> sum(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> consumers, producers;
+    for (int t = 0; t < threads; ++t) {
+        consumers.emplace_back([&]() {
+            uint64_t local = 0;
+            std::vector<uint64_t> got;
+            while (queue.pop_batch(got, batch)) {
+                for (uint64_t v : got) local += v;
+            }
+            sum += local;
+        });
+    }
+    for (int t = 0; t < threads; ++t) {
+        producers.emplace_back([&, t]() {
+            std::vector<uint64_t> pending;
+            for (size_t i = (size_t)t; i < items; i += (size_t)threads) {
+                pending.push_back(i + 1);
+                if (pending.size() >= batch) PushAll(queue, pending);
+            }
+            PushAll(queue, pending);
+        });
+    }
+    for (auto& p : producers) p.join();
+    queue.set_finished();
+    for (auto& c : consumers) c.join();
+    double t = SecondsSince(start);
+    if (sum != (uint64_t)items * (items + 1) / 2) throw std::runtime_error("queue lost or duplicated items");
+    return t;
+}
+
+int CmdQueue(int argc, char** argv) {
+    size_t items = 1000000, capacity = 4096;
+    int maxThreads = 64;
+    for (int i = 0; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--items") items = (size_t)std::atoll(argv[i + 1]);
+        else if (opt == "--capacity") capacity = (size_t)std::atoll(argv[i + 1]);
+        else if (opt == "--max-threads") maxThreads = std::atoi(argv[i + 1]);
+    }
+
+    printf("%zu items, WorkQueue capacity %zu; N producers and N consumers\n", items, capacity);
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        for (size_t batch : { (size_t)1, (size_t)64 }) {
+            SafeQueue<uint64_t> safe;
+            double tSafe = RunQueue(safe, threads, items, batch);
+            WorkQueue<uint64_t> ring(capacity);
+            double tRing = RunQueue(ring, threads, items, batch);
+            printf("N=%-2d batch %-2zu: SafeQueue %6.2f M/s, WorkQueue %6.2f M/s (%.2fx)\n", threads, batch,
+                   items / tSafe / 1e6, items / tRing / 1e6, tSafe / tRing);
+        }
+    }
+    return 0;
+}
+
+// --- SUITE ---
+
+struct SuiteMetric {
+    std::string name;           // Higher is better for all of them
+    std::string unit;
+    double best = 0.0;
+};
+
+// The "metrics" object of an earlier suite result.
+static std::map<std::string, double> ReadMetrics(const fs::path& file) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) throw std::runtime_error("can't read baseline " + file.string());
+    std::stringstream text;
+    text << in.rdbuf();
+    std::string json = text.str();
+
+    std::map<std::string, double> metrics;
+    std::smatch object;
+    if (!std::regex_search(json, object, std::regex("\"metrics\"\\s*:\\s*\\{([^}]*)\\}"))) return metrics;
+    std::string body = object[1];
+    std::regex pair("\"([A-Za-z0-9_]+)\"\\s*:\\s*([-+0-9.eE]+)");
+    for (auto it = std::sregex_iterator(body.begin(), body.end(), pair); it != std::sregex_iterator(); ++it) {
+        metrics[(*it)[1]] = std::atof((*it)[2].str().c_str());
+    }
+    return metrics;
+}
+
+// End-to-end throughput on a corpus (see gen-corpus): directory scan,
+// metadata extraction, raw copies and a whole sort into <scratch>, best of
+// --runs each. Results go to --out as JSON; against a --baseline result, any
+// metric more than --threshold percent below it fails the run (exit 1).
+int CmdSuite(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: suite <corpus> <scratch-dir> [--runs N] [--threads N] [--cold] [--out FILE]\n"
+                     "             [--baseline FILE] [--threshold PCT]\n";
+        return 2;
+    }
+    fs::path corpus = argv[0];
+    fs::path scratch = argv[1];
+    fs::path outFile, baselineFile;
+    int runs = 3, threads = 0;
+    double threshold = 10.0;
+    bool cold = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--cold") cold = true;
+        else if (i + 1 >= argc) break;
+        else if (opt == "--runs") runs = std::max(1, std::atoi(argv[++i]));
+        else if (opt == "--threads") threads = std::atoi(argv[++i]);
+        else if (opt == "--out") outFile = argv[++i];
+        else if (opt == "--baseline") baselineFile = argv[++i];
+        else if (opt == "--threshold") threshold = std::atof(argv[++i]);
+    }
+
+    std::vector<fs::path> files = ListFiles(corpus);
+    if (files.empty()) {
+        std::cerr << "No files found.\n";
+        return 1;
+    }
+    std::vector<fs::path> media;
+    uint64_t bytes = 0;
+    for (const auto& file : files) {
+        bytes += fs::file_size(file);
+        std::string ext = file.extension().string();
+        if (ext != ".zip" && ext != ".ZIP") media.push_back(file);
+    }
+    double mb = bytes / (1024.0 * 1024.0);
+    std::map<std::string, double> baseline;
+    if (!baselineFile.empty()) baseline = ReadMetrics(baselineFile);
+    fs::create_directories(scratch);
+
+    std::vector<SuiteMetric> metrics = {
+        { "scan_files_per_s", "files/s" },
+        { "metadata_files_per_s", "files/s" },
+        { "copy_mb_per_s", "MB/s" },
+        { "sort_files_per_s", "files/s" },
+    };
+    auto note = [&](size_t metric, double value) { metrics[metric].best = std::max(metrics[metric].best, value); };
+    // Writeback left over from the previous step would land on the next one
+    auto prepare = [&]() {
+#ifndef _WIN32
+        ::sync();
+#endif
+        if (cold) EvictFiles(files);
+    };
+
+    if (!cold) {
+        // Same conditions for the first run as for the others
+        std::vector<char> buffer(1 << 20);
+        for (const auto& file : files) {
+            std::ifstream in(file, std::ios::binary);
+            while (in.read(buffer.data(), (std::streamsize)buffer.size())) {}
+        }
+    }
+
+    printf("%zu files (%zu media), %.1f MB, %s cache, best of %d\n", files.size(), media.size(), mb, cold ? "cold" : "warm", runs);
+    for (int run = 0; run < runs; ++run) {
+        prepare();
+        DirWalker walker(threads > 0 ? threads : 4);
+        std::atomic<size_t> walked(0);
+        auto start = std::chrono::steady_clock::now();
+        walker.Walk({ corpus }, [&](fs::path&&, uint64_t) { walked++; });
+        note(0, walked / SecondsSince(start));
+
+        prepare();
+        start = std::chrono::steady_clock::now();
+        for (const auto& file : media) GetFileMetadata(file);
+        note(1, media.size() / SecondsSince(start));
+
+        prepare();
+        fs::path copyDir = scratch / "suite-copy";
+        fs::remove_all(copyDir);
+        fs::create_directories(copyDir);
+        FileCopier copier;
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < files.size(); ++i) {
+            std::error_code ec;
+            fs::path out = copyDir / (std::to_string(i) + files[i].extension().string());
+            if (!copier.Copy(files[i], out, ec)) throw fs::filesystem_error("copy", files[i], out, ec);
+        }
+        note(2, mb / SecondsSince(start));
+        fs::remove_all(copyDir);
+
+        prepare();
+        SortOptions options;
+        options.sourcePath = corpus;
+        options.targetPath = scratch / "suite-sort";
+        options.threads = threads;
+        options.geocodeMode = GeocodeMode::Disabled;
+        options.useManifest = false;
+        fs::remove_all(options.targetPath);
+        fs::create_directories(options.targetPath);
+        SorterEngine engine(options);
+        SortStats stats = engine.Run();
+        if (stats.copied == 0) throw std::runtime_error("the sort placed nothing");
+        note(3, stats.processed / stats.elapsedSeconds);
+        fs::remove_all(options.targetPath);
+    }
+
+    int regressions = 0;
+    for (const SuiteMetric& metric : metrics) {
+        printf("%-22s: %10.1f %-8s", metric.name.c_str(), metric.best, metric.unit.c_str());
+        auto known = baseline.find(metric.name);
+        if (known != baseline.end() && known->second > 0) {
+            double change = (metric.best / known->second - 1.0) * 100.0;
+            bool regressed = change < -threshold;
+            if (regressed) regressions++;
+            printf(" baseline %10.1f, %+6.1f%%%s", known->second, change, regressed ? "  REGRESSION" : "");
+        }
+        printf("\n");
+    }
+
+    if (!outFile.empty()) {
+        char date[32];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+        std::ofstream out(outFile, std::ios::binary | std::ios::trunc);
+        out << "{\n\"date\":\"" << date << "\",\"files\":" << files.size() << ",\"mediaFiles\":" << media.size()
+            << ",\"bytes\":" << bytes << ",\"runs\":" << runs << ",\"cache\":\"" << (cold ? "cold" : "warm")
+            << "\",\"threads\":" << threads << ",\"cpus\":" << std::thread::hardware_concurrency() << ",\n\"metrics\":{";
+        for (size_t i = 0; i < metrics.size(); ++i) {
+            out << (i ? "," : "") << "\n\"" << metrics[i].name << "\":" << metrics[i].best;
+        }
+        out << "\n}\n}\n";
+        if (!out) throw std::runtime_error("can't write " + outFile.string());
+    }
+
+    if (regressions > 0) {
+        printf("%d metric(s) more than %.0f%% below the baseline\n", regressions, threshold);
+        return 1;
+    }
+    return 0;
+}
+
+// --- MAIN ---
+
+void PrintUsage() {
+    std::cerr << "Media Sorter XXL benchmarks\n\n"
+                 "  gen-jpeg <dir> <count> [options]   Generate JPEGs with EXIF date/GPS tags\n"
+                 "  gen-corpus <dir> [options]         Generate photos, videos, ZIPs and duplicates in a tree\n"
+                 "  exif <dir> [--passes N]            Metadata extraction throughput, per detected format\n"
+                 "  video <dir> [--passes N]           MP4/MOV creation time and GPS throughput, bytes read per file\n"
+                 "  raw <dir> [--passes N]             Same for HEIC and camera RAW files\n"
+                 "  geocode <places> [options]         Offline k-d index vs. brute-force nearest place, lookup latency\n"
+                 "  geocode-online <scratch> [options] Geocoding against a local Nominatim stub: requests per cell, parking, cache\n"
+                 "  gen-tree <dir> <files> [options]   Generate a deep/wide tree of empty files\n"
+                 "  walk <dir> [--threads N]           Directory iterator vs. parallel walker\n"
+                 "  copy <src> <dst> [options]         Copy throughput per copy method\n"
+                 "  open <dir> <scratch> [--passes N]  Metadata, hash and copy: opened per step vs. once\n"
+                 "  ioq <dir> [options]                Header reads: blocking vs. io_uring queue depths\n"
+                 "  disk-order <dir> [options]         Whole-file reads in directory vs. inode vs. extent order, MB/s\n"
+                 "  queue [options]                    SafeQueue vs. WorkQueue, 1-64 producer/consumer pairs\n"
+                 "  suite <corpus> <scratch> [options] Scan, metadata, copy and sort throughput, checked against a baseline\n";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        PrintUsage();
+        return 2;
+    }
+    std::string cmd = argv[1];
+    try {
+        if (cmd == "gen-jpeg") return CmdGenJpeg(argc - 2, argv + 2);
+        if (cmd == "gen-corpus") return CmdGenCorpus(argc - 2, argv + 2);
+        if (cmd == "exif") return CmdExif(argc - 2, argv + 2);
+        if (cmd == "video") return CmdVideo(argc - 2, argv + 2);
+        if (cmd == "raw") return CmdRaw(argc - 2, argv + 2);
+        if (cmd == "geocode") return CmdGeocode(argc - 2, argv + 2);
+        if (cmd == "geocode-online") return CmdGeocodeOnline(argc - 2, argv + 2);
+        if (cmd == "gen-tree") return CmdGenTree(argc - 2, argv + 2);
+        if (cmd == "walk") return CmdWalk(argc - 2, argv + 2);
+        if (cmd == "copy") return CmdCopy(argc - 2, argv + 2);
+        if (cmd == "open") return CmdOpen(argc - 2, argv + 2);
+        if (cmd == "ioq") return CmdIoQueue(argc - 2, argv + 2);
+        if (cmd == "disk-order") return CmdDiskOrder(argc - 2, argv + 2);
+        if (cmd == "queue") return CmdQueue(argc - 2, argv + 2);
+        if (cmd == "suite") return CmdSuite(argc - 2, argv + 2);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    PrintUsage();
+    return 2;
+}
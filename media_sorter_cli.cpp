@@ -0,0 +1,283 @@
+// media_sorter_cli.cpp
+// Headless front end for the sorting engine.
+#include "engine/sorter_engine.h"
+#include <string>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+
+namespace fs = std::filesystem;
+
+static SorterEngine* g_pEngine = nullptr;
+
+static void HandleSignal(int) {
+    if (g_pEngine) g_pEngine->RequestStop();
+}
+
+// Prints every status line when verbose, otherwise a throttled progress line.
+class ConsoleProgressListener : public SortProgressListener {
+public:
+    explicit ConsoleProgressListener(bool verbose, bool quiet) : m_verbose(verbose), m_quiet(quiet) {}
+
+    void OnStatus(const std::string& message) override {
+        if (m_quiet) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_verbose || message.compare(0, 12, "Processing: ") != 0) {
+            fprintf(stderr, "%s\n", message.c_str());
+        }
+    }
+
+    void OnTotal(int /*totalFiles*/, bool final) override {
+        m_totalFinal = final;
+    }
+
+    void OnProgress(int processed, int totalFiles) override {
+        if (m_quiet || m_verbose) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto now = std::chrono::steady_clock::now();
+        if (now - m_lastPrint < std::chrono::seconds(1) && processed != totalFiles) return;
+        m_lastPrint = now;
+        int percent = totalFiles > 0 ? (int)(100LL * processed / totalFiles) : 0;
+        if (percent > 100) percent = 100;
+        fprintf(stderr, "[%d/%s%d] %d%%\n", processed, m_totalFinal ? "" : "~", totalFiles, percent);
+    }
+
+private:
+    bool m_verbose;
+    bool m_quiet;
+    std::atomic<bool> m_totalFinal{false};
+    std::mutex m_mutex;
+    std::chrono::steady_clock::time_point m_lastPrint;
+};
+
+// $XDG_CACHE_HOME/media-sorter/geocode.cache, falling back to ~/.cache
+static fs::path DefaultGeocodeCachePath() {
+    fs::path base;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        if (*xdg) base = fs::u8path(xdg);
+    }
+    if (base.empty()) {
+        const char* home = std::getenv("HOME");
+        if (!home || !*home) return fs::path();
+        base = fs::u8path(home) / ".cache";
+    }
+    return base / "media-sorter" / "geocode.cache";
+}
+
+static void PrintUsage() {
+    fprintf(stderr,
+        "Usage: media-sorter-cli [options] <source> <target>\n\n"
+        "Sorts images and videos from <source> into <target>/YYYY/YYYY-MM/.\n\n"
+        "Options:\n"
+        "  --threads N        Fixed number of threads per stage (default: adapt per device)\n"
+        "  --scan-threads N   Directory walker threads (default: CPU count, 2-8)\n"
+        "  --places FILE      Offline geocoding against a GeoNames-style cities file\n"
+        "  --no-geocode       Don't resolve GPS coordinates to place names\n"
+        "  --geocache FILE    Online geocode cache (default: ~/.cache/media-sorter/geocode.cache)\n"
+        "  --geocode-url URL  Nominatim-compatible server (default: public Nominatim)\n"
+        "  --no-manifest      Ignore <target>/.media-sorter.manifest and re-examine every file\n"
+        "  --move             Move files into the target instead of copying them\n"
+        "  --link             Hard-link files into the target (copies across volumes)\n"
+        "  --symlink          Place symbolic links to the source files\n"
+        "  --copy-method M    auto (default), reflink, copy_file_range, sendfile, io_uring or buffered\n"
+        "  --io-uring         Read headers and copy through io_uring (Linux), falls back to threads\n"
+        "  --io-depth N       Header reads in flight per worker with --io-uring (default: 64)\n"
+        "  --disk-order M     Process files in on-disk order: inode, or extent (FIEMAP, Linux)\n"
+        "  --rotational-readers N  With --disk-order: files read at once per spinning disk (default: 1, 0 = no cap)\n"
+        "  --profile FILE     Write a JSON run profile (stages, per-step latencies, threads)\n"
+        "  --trace FILE       Write a Chrome trace of every step (chrome://tracing, Perfetto)\n"
+        "  --verbose          Print every file as it is processed\n"
+        "  --quiet            Only print the summary\n");
+}
+
+int main(int argc, char** argv) {
+    SortOptions options;
+    bool verbose = false;
+    bool quiet = false;
+    bool geocacheSet = false;
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) options.threads = std::atoi(argv[++i]);
+        else if (arg == "--scan-threads" && i + 1 < argc) options.scanThreads = std::atoi(argv[++i]);
+        else if (arg == "--places" && i + 1 < argc) { options.geocodeMode = GeocodeMode::Offline; options.placesFile = fs::u8path(argv[++i]); }
+        else if (arg == "--no-geocode") options.geocodeMode = GeocodeMode::Disabled;
+        else if (arg == "--geocode-url" && i + 1 < argc) options.geocodeUrl = argv[++i];
+        else if (arg == "--geocache" && i + 1 < argc) { options.geocodeCacheFile = fs::u8path(argv[++i]); geocacheSet = true; }
+        else if (arg == "--no-manifest") options.useManifest = false;
+        else if (arg == "--move") options.placement = PlacementMode::Move;
+        else if (arg == "--link") options.placement = PlacementMode::Hardlink;
+        else if (arg == "--symlink") options.placement = PlacementMode::Symlink;
+        else if (arg == "--copy-method" && i + 1 < argc) {
+            if (!ParseCopyMethod(argv[++i], options.copyMethod)) { fprintf(stderr, "Unknown copy method: %s\n", argv[i]); return 2; }
+        }
+        else if (arg == "--io-uring") options.ioUring = true;
+        else if (arg == "--io-depth" && i + 1 < argc) options.ioDepth = std::atoi(argv[++i]);
+        else if (arg == "--disk-order" && i + 1 < argc) {
+            if (!ParseDiskOrder(argv[++i], options.diskOrder)) { fprintf(stderr, "Unknown disk order: %s\n", argv[i]); return 2; }
+        }
+        else if (arg == "--rotational-readers" && i + 1 < argc) options.rotationalReaders = std::atoi(argv[++i]);
+        else if (arg == "--profile" && i + 1 < argc) options.profileFile = fs::u8path(argv[++i]);
+        else if (arg == "--trace" && i + 1 < argc) options.traceFile = fs::u8path(argv[++i]);
+        else if (arg == "--verbose") verbose = true;
+        else if (arg == "--quiet") quiet = true;
+        else if (arg == "-h" || arg == "--help") { PrintUsage(); return 0; }
+        else if (arg.compare(0, 2, "--") == 0) { fprintf(stderr, "Unknown option: %s\n", arg.c_str()); PrintUsage(); return 2; }
+        else positional.push_back(arg);
+    }
+    if (positional.size() != 2) {
+        PrintUsage();
+        return 2;
+    }
+    options.sourcePath = fs::u8path(positional[0]);
+    options.targetPath = fs::u8path(positional[1]);
+
+    // Check if paths exist and are directories
+    try {
+        if (!fs::is_directory(options.sourcePath)) {
+            fprintf(stderr, "Source folder is invalid or does not exist.\n");
+            return 1;
+        }
+        if (!fs::is_directory(options.targetPath)) {
+            fprintf(stderr, "Target folder is invalid or does not exist.\n");
+            return 1;
+        }
+        if (fs::equivalent(options.sourcePath, options.targetPath)) {
+            fprintf(stderr, "Source and Target folders must not be identical.\n");
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Error while verifying folders: %s\n", e.what());
+        return 1;
+    }
+
+    if (!geocacheSet && options.geocodeMode == GeocodeMode::Online) {
+        options.geocodeCacheFile = DefaultGeocodeCachePath();
+    }
+    if (!options.geocodeCacheFile.empty()) {
+        std::error_code ec;
+        fs::create_directories(options.geocodeCacheFile.parent_path(), ec);
+    }
+
+    ConsoleProgressListener listener(verbose, quiet);
+    SorterEngine engine(options, &listener);
+    g_pEngine = &engine;
+    std::signal(SIGINT, HandleSignal);
+    std::signal(SIGTERM, HandleSignal);
+
+    SortStats stats;
+    try {
+        stats = engine.Run();
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    g_pEngine = nullptr;
+
+    double rate = stats.elapsedSeconds > 0 ? stats.processed / stats.elapsedSeconds : 0.0;
+    printf("Total Files Found:     %d\n", stats.totalFiles);
+    printf("Successfully Copied:   %d\n", stats.copied);
+    if (stats.moved > 0) printf("  Moved:               %d\n", stats.moved);
+    if (stats.hardlinked > 0) printf("  Hard-Linked:         %d\n", stats.hardlinked);
+    if (stats.symlinked > 0) printf("  Symlinked:           %d\n", stats.symlinked);
+    printf("Skipped (Duplicates):  %d\n", stats.skipped);
+    printf("Processed Total:       %d\n", stats.processed);
+    if (stats.unchanged > 0) printf("Already Sorted:        %d\n", stats.unchanged);
+    if (stats.duplicates > 0) {
+        printf("Same Content:          %d (%.1f MB read to compare)\n", stats.duplicates, stats.dedupBytesRead / (1024.0 * 1024.0));
+    }
+    if (!stats.archives.empty()) {
+        int members = 0;
+        uint64_t bytes = 0;
+        for (const ArchiveStats& archive : stats.archives) {
+            members += archive.members;
+            bytes += archive.bytes;
+        }
+        printf("Archives Read:         %d (%d files, %.1f MB unpacked)\n", (int)stats.archives.size(), members,
+               bytes / (1024.0 * 1024.0));
+    }
+    std::string copyMethods;
+    uint64_t copiedBytes = 0;
+    for (int m = 0; m < COPY_METHOD_COUNT; ++m) {
+        if (stats.copies.files[m] == 0) continue;
+        if (!copyMethods.empty()) copyMethods += ", ";
+        copyMethods += std::string(CopyMethodName((CopyMethod)m)) + " " + std::to_string(stats.copies.files[m]);
+        copiedBytes += stats.copies.bytes[m];
+    }
+    if (!copyMethods.empty()) {
+        printf("Copied With:           %s (%.1f MB)\n", copyMethods.c_str(), copiedBytes / (1024.0 * 1024.0));
+    }
+    if (stats.bytesPlaced > 0) {
+        printf("Bytes Placed:          %.1f MB (%.1f MB written)\n", stats.bytesPlaced / (1024.0 * 1024.0),
+               stats.bytesWritten / (1024.0 * 1024.0));
+    }
+    bool anyFormat = false;
+    for (const FormatStats& format : stats.formats) {
+        if (format.files == 0) continue;
+        if (!anyFormat) printf("Formats:\n");
+        anyFormat = true;
+        std::string label = format.name + ":";
+        printf("  %-20s %llu files, %llu dated, %llu located, %.2f s, %.1f KB read per file\n", label.c_str(),
+               (unsigned long long)format.files, (unsigned long long)format.dated, (unsigned long long)format.located,
+               format.seconds, format.bytesRead / 1024.0 / format.files);
+    }
+    printf("Worker Threads:        %d per stage%s\n", stats.workerThreads, stats.adaptiveConcurrency ? " (adaptive)" : "");
+    for (const StageStats& stage : stats.stages) {
+        if (stage.items == 0) continue;
+        std::string label = stage.name + " stage:";
+        printf("  %-20s %llu files, %.2f ms each, queue peak %zu/%zu, %.2f s blocked\n", label.c_str(),
+               (unsigned long long)stage.items, stage.busySeconds * 1000.0 / stage.items, stage.peakQueue,
+               stage.queueCapacity, stage.blockedSeconds);
+    }
+    for (const auto& entry : stats.concurrency) {
+        if (entry.stats.operations == 0) continue;
+        std::string label = std::string(WorkStageName(entry.stage)) + " on " + entry.device +
+                            (entry.rotational ? " (hdd):" : ":");
+        double latency = entry.stats.busySeconds * 1000.0 / entry.stats.operations;
+        if (stats.adaptiveConcurrency) {
+            printf("  %-20s %d (range %d-%d), %llu ops, %.2f ms each\n", label.c_str(), entry.stats.limit, entry.stats.low,
+                   entry.stats.high, (unsigned long long)entry.stats.operations, latency);
+        } else {
+            printf("  %-20s %llu ops, %.2f ms each\n", label.c_str(), (unsigned long long)entry.stats.operations, latency);
+        }
+    }
+    // Where the time went, summed over threads
+    std::vector<ProbeStats> hotPath;
+    for (const ProbeStats& probe : stats.profile) {
+        if (probe.calls > 0) hotPath.push_back(probe);
+    }
+    std::sort(hotPath.begin(), hotPath.end(), [](const ProbeStats& a, const ProbeStats& b) { return a.seconds > b.seconds; });
+    if (hotPath.size() > 5) hotPath.resize(5);
+    if (!hotPath.empty()) printf("Hot Path:\n");
+    for (const ProbeStats& probe : hotPath) {
+        std::string label = probe.name + ":";
+        printf("  %-20s %.2f s, %llu calls, p50 %.3f ms, p99 %.3f ms", label.c_str(), probe.seconds,
+               (unsigned long long)probe.calls, probe.p50 * 1000.0, probe.p99 * 1000.0);
+        if (probe.bytes > 0) printf(", %.1f MB", probe.bytes / (1024.0 * 1024.0));
+        printf("\n");
+    }
+    printf("Elapsed:               %.2f s (%.1f files/s)\n", stats.elapsedSeconds, rate);
+    printf("Scan Completed After:  %.2f s\n", stats.scanSeconds);
+    if (stats.firstCopySeconds >= 0) printf("Time to First Copy:    %.3f s\n", stats.firstCopySeconds);
+    uint64_t lookups = stats.geocodeCacheHits + stats.geocodeCacheMisses;
+    if (lookups > 0) {
+        printf("Geocode Cache Hits:    %llu/%llu (%.1f%%)\n", (unsigned long long)stats.geocodeCacheHits,
+               (unsigned long long)lookups, 100.0 * stats.geocodeCacheHits / lookups);
+    }
+    if (stats.geocodeRequests > 0 || stats.geocodeDeferred > 0) {
+        printf("Geocode Requests:      %llu (%d files waited for a location)\n",
+               (unsigned long long)stats.geocodeRequests, stats.geocodeDeferred);
+    }
+    if (stats.geocodeLookupsSaved > 0) {
+        printf("Geocode Lookups Saved: %llu (answered by a nearby location)\n", (unsigned long long)stats.geocodeLookupsSaved);
+    }
+    return engine.StopRequested() ? 130 : 0;
+}